@@ -13,13 +13,13 @@ class Texture2D {
  public:
   // Load Texture
   GLuint loadTexture(const GLchar* filename, const std::string directory);
+
+  // decodePNG
+  int decodeFile(std::vector<unsigned char>& out_image, int& image_width, int& image_height, const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true);
  
  private:
   std::vector<unsigned char> buffer;
 
    // Load file
   int load(std::vector<unsigned char>& outImage, int& imageWidth, int& imageHeight, const char* filename);
-
-  // decodePNG
-  int decodeFile(std::vector<unsigned char>& out_image, int& image_width, int& image_height, const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true);
 };
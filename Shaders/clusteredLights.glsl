@@ -0,0 +1,51 @@
+// Point lights and spotlights binned by LightGrid (src/LightGrid.h). The
+// fragment finds its cluster from its screen position and view depth,
+// then shades only the lights listed there.
+
+#include "lighting.glsl"
+#include "../shaders/frameData.glsl"
+
+// Four texels per light:
+//   0 position, range
+//   1 color, type (0 point, 1 spot)
+//   2 direction, cutOff
+//   3 constant, linear, quadratic, outerCutOff
+uniform samplerBuffer lightRecords;
+// Offset and count into lightIndices of each cluster
+uniform usamplerBuffer lightCells;
+uniform usamplerBuffer lightIndices;
+
+layout (std140) uniform ClusterData {
+  uvec4 clusterGrid;  // Clusters along x, y and z, and the light count
+  vec4 clusterScale;  // Clusters per pixel in x and y, then the depth slice
+		      // scale and bias: slice = log(depth) * z + w
+};
+
+vec3 calcClusteredLights(Surface surface, vec3 viewDirection) {
+  float depth = -(view * vec4(surface.position, 1.0f)).z;
+  uvec3 cluster = uvec3(clamp(ivec3(gl_FragCoord.xy * clusterScale.xy,
+				    floor(log(max(depth, 1e-4f)) * clusterScale.z + clusterScale.w)),
+			      ivec3(0), ivec3(clusterGrid.xyz) - 1));
+  uvec2 cell = texelFetch(lightCells, int((cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x)).xy;
+
+  vec3 result = vec3(0.0f);
+  for (uint i = cell.x; i < cell.x + cell.y; i++) {
+    int record = int(texelFetch(lightIndices, int(i)).x) * 4;
+    vec4 positionRange = texelFetch(lightRecords, record);
+    vec4 colorType = texelFetch(lightRecords, record + 1);
+    vec4 direction = texelFetch(lightRecords, record + 2);
+    vec4 falloff = texelFetch(lightRecords, record + 3);
+
+    vec3 lightDirection = normalize(positionRange.xyz - surface.position);
+    float attenuation = calcAttenuation(falloff.x, falloff.y, falloff.z, positionRange.xyz, surface.position);
+    if (colorType.w > 0.5f) {
+      // Spotlight (soft edges)
+      float theta = dot(lightDirection, normalize(-direction.xyz));
+      attenuation *= clamp((theta - falloff.w) / (direction.w - falloff.w), 0.0f, 1.0f);
+    }
+
+    // The grid's lights carry no ambient term
+    result += calcPhong(vec3(0.0f), colorType.rgb, colorType.rgb, lightDirection, surface, viewDirection) * attenuation;
+  }
+  return result;
+}
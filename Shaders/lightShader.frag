@@ -1,48 +1,38 @@
 #version 330 core
 
+// Built as a variant per scene (see ShaderPermutations), which defines:
+//   DIRECTION_LIGHT      one directional light
+//   NUMBER_POINT_LIGHTS  point lights, may be 0
+//   SPOT_LIGHT           one spotlight
+//   SPECULAR_MAP         material.specular is a texture, a color otherwise
+//   NORMAL_MAP           material.normal perturbs the normal
+//   CLUSTERED_LIGHTS     any number of lights, binned by LightGrid
+#ifndef NUMBER_POINT_LIGHTS
 #define NUMBER_POINT_LIGHTS 4
+#define DIRECTION_LIGHT
+#define SPOT_LIGHT
+#define SPECULAR_MAP
+#endif
+
+#include "lighting.glsl"
+#include "../shaders/frameData.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "clusteredLights.glsl"
+#endif
 
 struct Material {
   sampler2D diffuse;
+#ifdef SPECULAR_MAP
   sampler2D specular;
+#else
+  vec3 specularColor;
+#endif
+#ifdef NORMAL_MAP
+  sampler2D normal;
+#endif
   float shininess;
 };
 
-struct DirectionLight {
-  vec3 direction;
-
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-};
-
-struct PointLight {
-  vec3 position;
-
-  float constant;
-  float linear;
-  float quadratic;
-
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-};
-
-struct SpotLight {
-  vec3 position;
-  vec3 direction; // Spotlight direction
-  float cutOff;
-  float outerCutOff;
-
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-
-  float constant;
-  float linear;
-  float quadratic;
-};
-
 // uniform vec4 xColor; // Variable from OpenGL code
 in vec2 fTexCoords;
 in vec3 fNormal;
@@ -50,103 +40,76 @@ in vec3 fragPos;
 
 out vec4 color;
 
-uniform vec3 viewPos;
 uniform Material material;
+#ifdef DIRECTION_LIGHT
 uniform DirectionLight directionLight;
+#endif
+#if NUMBER_POINT_LIGHTS > 0
 uniform PointLight pointLights[NUMBER_POINT_LIGHTS];
+#endif
+#ifdef SPOT_LIGHT
 uniform SpotLight spotLight;
-
-vec3 calcDirectionLight(DirectionLight light, vec3 normal, vec3 viewDirection);
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDirection);
-vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDirection);
+#endif
+
+#ifdef NORMAL_MAP
+// Tangent frame from screen space derivatives, so the vertices need no tangents
+vec3 perturbNormal(vec3 normal, vec3 position, vec2 texCoords) {
+  vec3 dp1 = dFdx(position);
+  vec3 dp2 = dFdy(position);
+  vec2 duv1 = dFdx(texCoords);
+  vec2 duv2 = dFdy(texCoords);
+
+  vec3 dp2perp = cross(dp2, normal);
+  vec3 dp1perp = cross(normal, dp1);
+  vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+  vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+  float invmax = inversesqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+
+  // z is rebuilt from x and y, BC5 normal maps only store those two
+  vec2 xy = texture(material.normal, texCoords).xy * 2.0f - 1.0f;
+  vec3 mapped = vec3(xy, sqrt(max(1.0f - dot(xy, xy), 0.0f)));
+  return normalize(mat3(tangent * invmax, bitangent * invmax, normal) * mapped);
+}
+#endif
 
 void main() {
   // Properties
-  vec3 norm = normalize(fNormal);
-  vec3 viewDirection = normalize(viewPos - fragPos);
+  Surface surface;
+  surface.position = fragPos;
+  surface.normal = normalize(fNormal);
+#ifdef NORMAL_MAP
+  surface.normal = perturbNormal(surface.normal, fragPos, fTexCoords);
+#endif
+  surface.diffuse = vec3(texture(material.diffuse, fTexCoords));
+#ifdef SPECULAR_MAP
+  surface.specular = vec3(texture(material.specular, fTexCoords));
+#else
+  surface.specular = material.specularColor;
+#endif
+  surface.shininess = material.shininess;
+
+  vec3 viewDirection = normalize(cameraPosition.xyz - fragPos);
+  vec3 result = vec3(0.0f);
 
   // Phase 1: Directional lighting
-  vec3 result = calcDirectionLight(directionLight, norm, viewDirection);
+#ifdef DIRECTION_LIGHT
+  result += calcDirectionLight(directionLight, surface, viewDirection);
+#endif
   // Phase 2: Point lights
+#if NUMBER_POINT_LIGHTS > 0
   for(int i = 0; i < NUMBER_POINT_LIGHTS; i++) {
-    result += calcPointLight(pointLights[i], norm, viewDirection);
+    result += calcPointLight(pointLights[i], surface, viewDirection);
   }
+#endif
   // Phase 3: Spot light
-  result += calcSpotLight(spotLight, norm, viewDirection);
+#ifdef SPOT_LIGHT
+  result += calcSpotLight(spotLight, surface, viewDirection);
+#endif
+  // Phase 4: The lights of the fragment's cluster
+#ifdef CLUSTERED_LIGHTS
+  result += calcClusteredLights(surface, viewDirection);
+#endif
 
   // Result color
   color = vec4(result, 1.0f);
-
 }
-
-vec3 calcDirectionLight(DirectionLight light, vec3 normal, vec3 viewDirection) {
-  vec3 lightDirection = normalize(-light.direction);
-  // Diffuse shading
-  float diff = max(dot(normal, lightDirection), 0.0f);
-  // Specular shading
-  vec3 reflectDirection = reflect(-lightDirection, normal);
-  float spec = pow(max(dot(viewDirection, reflectDirection), 0.0f), material.shininess);
-  // Combine results
-  vec3 ambient = light.ambient * vec3(texture(material.diffuse, fTexCoords));
-  vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fTexCoords));
-  vec3 specular = light.specular * spec * vec3(texture(material.specular, fTexCoords));
-
-  return (ambient + diffuse + specular);
-}
-
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDirection) {
-  vec3 lightDirection = normalize(light.position - fragPos);
-  // Diffuse shading
-  float diff = max(dot(normal, lightDirection), 0.0f);
-  // Specular shading
-  vec3 reflectDirection = reflect(-lightDirection, normal);
-  float spec = pow(max(dot(viewDirection, reflectDirection), 0.0f), material.shininess);
-  // Attenuation
-  float lDistance = length(light.position - fragPos);
-  float attenuation = 1.0f / (light.constant + light.linear * lDistance +
-			      light.quadratic * (lDistance * lDistance));
-  
-  // Combine results
-  vec3 ambient = light.ambient * vec3(texture(material.diffuse, fTexCoords));
-  vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fTexCoords));
-  vec3 specular = light.specular * spec * vec3(texture(material.specular, fTexCoords));
-
-  ambient *= attenuation;
-  diffuse *= attenuation;
-  specular *= attenuation;
-
-  return (ambient + diffuse + specular);
-}
-
-vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDirection) {
-  vec3 lightDirection = normalize(light.position - fragPos);
-
-  // Diffuse shading
-  float diff = max(dot(normal, lightDirection), 0.0);
-  
-  // Specular shading
-  vec3 reflectDirection = reflect(-lightDirection, normal);
-  float spec = pow(max(dot(viewDirection, reflectDirection), 0.0f), material.shininess);
-
-  // Spotlight (soft edges)
-  float theta = dot(lightDirection, normalize(-light.direction));
-  float epsilon = light.cutOff - light.outerCutOff;
-  float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0f, 1.0f);
-
-  // Attenuation
-  float lDistance = length(light.position - fragPos);
-  float attenuation = 1.0f / (light.constant + light.linear * lDistance +
-			      light.quadratic * (lDistance * lDistance));
-
-  // Combine results
-  vec3 ambient = light.ambient * vec3(texture(material.diffuse, fTexCoords));
-  vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fTexCoords));
-  vec3 specular = light.specular * spec * vec3(texture(material.specular, fTexCoords));
-
-  ambient *= attenuation * intensity;
-  diffuse *= attenuation * intensity;
-  specular *= attenuation * intensity;
-
-  return (ambient + diffuse + specular);
-}
-
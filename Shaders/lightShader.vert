@@ -14,11 +14,10 @@ out vec3 fragPos;
 // uniform vec3 lightPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../shaders/frameData.glsl"
 
 void main() {
-  gl_Position = projection * view * model * vec4(position, 1.0f); // Directly give a vec3 to vec4's constructor
+  gl_Position = viewProjection * model * vec4(position, 1.0f); // Directly give a vec3 to vec4's constructor
   fragPos = vec3(model * vec4(position, 1.0f));
   
   fNormal = mat3(transpose(inverse( model))) * normal;
@@ -0,0 +1,90 @@
+// Light types and the Phong terms of each, shared by the lighting shaders.
+// The surface is sampled once per fragment and passed in, rather than
+// once per light.
+
+struct DirectionLight {
+  vec3 direction;
+
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+};
+
+struct PointLight {
+  vec3 position;
+
+  float constant;
+  float linear;
+  float quadratic;
+
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+};
+
+struct SpotLight {
+  vec3 position;
+  vec3 direction; // Spotlight direction
+  float cutOff;
+  float outerCutOff;
+
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+// What the material looks like at the fragment
+struct Surface {
+  vec3 position;
+  vec3 normal;
+  vec3 diffuse;
+  vec3 specular;
+  float shininess;
+};
+
+vec3 calcPhong(vec3 ambientColor, vec3 diffuseColor, vec3 specularColor, vec3 lightDirection,
+	       Surface surface, vec3 viewDirection) {
+  // Diffuse shading
+  float diff = max(dot(surface.normal, lightDirection), 0.0f);
+  // Specular shading
+  vec3 reflectDirection = reflect(-lightDirection, surface.normal);
+  float spec = pow(max(dot(viewDirection, reflectDirection), 0.0f), surface.shininess);
+  // Combine results
+  vec3 ambient = ambientColor * surface.diffuse;
+  vec3 diffuse = diffuseColor * diff * surface.diffuse;
+  vec3 specular = specularColor * spec * surface.specular;
+
+  return (ambient + diffuse + specular);
+}
+
+float calcAttenuation(float constant, float linear, float quadratic, vec3 lightPosition, vec3 fragmentPosition) {
+  float lDistance = length(lightPosition - fragmentPosition);
+  return 1.0f / (constant + linear * lDistance + quadratic * (lDistance * lDistance));
+}
+
+vec3 calcDirectionLight(DirectionLight light, Surface surface, vec3 viewDirection) {
+  vec3 lightDirection = normalize(-light.direction);
+  return calcPhong(light.ambient, light.diffuse, light.specular, lightDirection, surface, viewDirection);
+}
+
+vec3 calcPointLight(PointLight light, Surface surface, vec3 viewDirection) {
+  vec3 lightDirection = normalize(light.position - surface.position);
+  float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, light.position, surface.position);
+  return calcPhong(light.ambient, light.diffuse, light.specular, lightDirection, surface, viewDirection) * attenuation;
+}
+
+vec3 calcSpotLight(SpotLight light, Surface surface, vec3 viewDirection) {
+  vec3 lightDirection = normalize(light.position - surface.position);
+
+  // Spotlight (soft edges)
+  float theta = dot(lightDirection, normalize(-light.direction));
+  float epsilon = light.cutOff - light.outerCutOff;
+  float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0f, 1.0f);
+
+  float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, light.position, surface.position);
+  return calcPhong(light.ambient, light.diffuse, light.specular, lightDirection, surface, viewDirection) * attenuation * intensity;
+}
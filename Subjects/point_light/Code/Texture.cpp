@@ -1,5 +1,336 @@
 #include "Texture.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PNG_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit SSE2/AVX2 instructions inside functions marked for
+// them, which lets the kernels below live next to the scalar code.
+#if defined(__GNUC__)
+#define PNG_TARGET_SSE2 __attribute__((target("sse2")))
+#define PNG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PNG_TARGET_SSE2
+#define PNG_TARGET_AVX2
+#endif
+
+// Scanline kernels used by decodeFile. Sub, Up, Average and Paeth unfiltering
+// and the RGB to RGBA expansion have SSE2/AVX2 versions that are picked once at
+// runtime from what the CPU supports; the scalar versions work everywhere.
+namespace {
+  enum class SimdLevel { SCALAR, SSE2, AVX2 };
+
+  SimdLevel detectSimdLevel() {
+#if defined(PNG_SIMD_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = ((info[3] >> 26) & 1) != 0;
+    bool osxsave = ((info[2] >> 27) & 1) != 0;
+    bool avx = ((info[2] >> 28) & 1) != 0;
+    bool avx2 = false;
+
+    // AVX2 also needs the OS to save the YMM registers
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+      __cpuidex(info, 7, 0);
+      avx2 = ((info[1] >> 5) & 1) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2") != 0;
+    bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    if (avx2) {
+      return SimdLevel::AVX2;
+    }
+    if (sse2) {
+      return SimdLevel::SSE2;
+    }
+#endif
+    return SimdLevel::SCALAR;
+  }
+
+  SimdLevel simdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+  }
+
+  unsigned char paethPredictor(short a, short b, short c) {
+    short p = a + b - c;
+    short pa = p > a ? (p - a) : (a - p);
+    short pb = p > b ? (p - b) : (b - p);
+    short pc = p > c ? (p - c) : (c - p);
+    return (unsigned char)((pa <= pb && pa <= pc) ? a : pb <= pc ? b : c);
+  }
+
+  // Scalar kernels
+  // ==============
+  void unfilterSubScalar(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length) {
+    for (size_t i = 0; i < bytewidth; i++) recon[i] = scanline[i];
+    for (size_t i = bytewidth; i < length; i++) recon[i] = scanline[i] + recon[i - bytewidth];
+  }
+
+  void unfilterUpScalar(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length) {
+    for (size_t i = 0; i < length; i++) recon[i] = scanline[i] + precon[i];
+  }
+
+  void unfilterAverageScalar(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, size_t length) {
+    if (precon) {
+      for (size_t i = 0; i < bytewidth; i++) recon[i] = scanline[i] + precon[i] / 2;
+      for (size_t i = bytewidth; i < length; i++) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) / 2);
+    } else {
+      for (size_t i = 0; i < bytewidth; i++) recon[i] = scanline[i];
+      for (size_t i = bytewidth; i < length; i++) recon[i] = scanline[i] + recon[i - bytewidth] / 2;
+    }
+  }
+
+  void unfilterPaethScalar(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, size_t length) {
+    if (precon) {
+      for (size_t i = 0; i < bytewidth; i++) recon[i] = scanline[i] + paethPredictor(0, precon[i], 0);
+      for (size_t i = bytewidth; i < length; i++) recon[i] = scanline[i] + paethPredictor(recon[i - bytewidth], precon[i], precon[i - bytewidth]);
+    } else {
+      for (size_t i = 0; i < bytewidth; i++) recon[i] = scanline[i];
+      for (size_t i = bytewidth; i < length; i++) recon[i] = scanline[i] + paethPredictor(recon[i - bytewidth], 0, 0);
+    }
+  }
+
+  void expandRgbToRgbaScalar(unsigned char* out, const unsigned char* in, size_t numpixels) {
+    for (size_t i = 0; i < numpixels; i++) {
+      out[4 * i + 0] = in[3 * i + 0];
+      out[4 * i + 1] = in[3 * i + 1];
+      out[4 * i + 2] = in[3 * i + 2];
+      out[4 * i + 3] = 255;
+    }
+  }
+
+#if defined(PNG_SIMD_X86)
+  // SSE2 kernels
+  // ============
+  // Sub, Average and Paeth depend on the pixel to the left, so these work one
+  // 3 or 4 byte pixel per register instead of 16 bytes at a time.
+  PNG_TARGET_SSE2 inline __m128i loadPixel(const unsigned char* p, size_t bytewidth) {
+    int value = 0;
+    std::memcpy(&value, p, bytewidth);
+    return _mm_cvtsi32_si128(value);
+  }
+
+  PNG_TARGET_SSE2 inline void storePixel(unsigned char* p, __m128i v, size_t bytewidth) {
+    int value = _mm_cvtsi128_si32(v);
+    std::memcpy(p, &value, bytewidth);
+  }
+
+  PNG_TARGET_SSE2 void unfilterSubSse2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length) {
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + bytewidth <= length; i += bytewidth) {
+      a = _mm_add_epi8(a, loadPixel(scanline + i, bytewidth));
+      storePixel(recon + i, a, bytewidth);
+    }
+  }
+
+  PNG_TARGET_SSE2 void unfilterUpSse2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+      _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+    }
+    unfilterUpScalar(recon + i, scanline + i, precon + i, length - i);
+  }
+
+  PNG_TARGET_SSE2 void unfilterAverageSse2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, size_t length) {
+    // _mm_avg_epu8 rounds up, the filter rounds down
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + bytewidth <= length; i += bytewidth) {
+      __m128i b = loadPixel(precon + i, bytewidth);
+      __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(loadPixel(scanline + i, bytewidth), average);
+      storePixel(recon + i, a, bytewidth);
+    }
+  }
+
+  PNG_TARGET_SSE2 inline __m128i abs16(__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+  }
+
+  PNG_TARGET_SSE2 inline __m128i select16(__m128i mask, __m128i ifTrue, __m128i ifFalse) {
+    return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+  }
+
+  PNG_TARGET_SSE2 void unfilterPaethSse2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    for (size_t i = 0; i + bytewidth <= length; i += bytewidth) {
+      __m128i b = _mm_unpacklo_epi8(loadPixel(precon + i, bytewidth), zero);
+
+      // pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = abs16(_mm_add_epi16(pa, pb));
+      pa = abs16(pa);
+      pb = abs16(pb);
+
+      // Ties go to a, then b, like the scalar predictor
+      __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      __m128i nearest = select16(_mm_cmpeq_epi16(pa, smallest), a,
+				 select16(_mm_cmpeq_epi16(pb, smallest), b, c));
+
+      __m128i x = loadPixel(scanline + i, bytewidth);
+      __m128i d = _mm_add_epi8(x, _mm_packus_epi16(nearest, nearest));
+      storePixel(recon + i, d, bytewidth);
+
+      a = _mm_unpacklo_epi8(d, zero);
+      c = b;
+    }
+  }
+
+  // AVX2 kernels
+  // ============
+  PNG_TARGET_AVX2 void unfilterUpAvx2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i*)(scanline + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(precon + i));
+      _mm256_storeu_si256((__m256i*)(recon + i), _mm256_add_epi8(x, b));
+    }
+    unfilterUpScalar(recon + i, scanline + i, precon + i, length - i);
+  }
+
+  PNG_TARGET_AVX2 void expandRgbToRgbaAvx2(unsigned char* out, const unsigned char* in, size_t numpixels) {
+    // Each 128 bit lane takes 4 RGB pixels (12 bytes) and spreads them to 4 RGBA pixels
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+					     0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    size_t i = 0;
+
+    // The second lane reads 16 bytes from pixel i + 4, stop while that is still inside the input
+    for (; i + 10 <= numpixels; i += 8) {
+      __m128i low = _mm_loadu_si128((const __m128i*)(in + 3 * i));
+      __m128i high = _mm_loadu_si128((const __m128i*)(in + 3 * i + 12));
+      __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+      pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+      _mm256_storeu_si256((__m256i*)(out + 4 * i), pixels);
+    }
+    expandRgbToRgbaScalar(out + 4 * i, in + 3 * i, numpixels - i);
+  }
+#endif
+
+  // Reconstructs one scanline. Returns 0, or the picoPNG error 36 for an unknown filter type.
+  int unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+		       size_t bytewidth, unsigned long filterType, size_t length) {
+#if defined(PNG_SIMD_X86)
+    SimdLevel level = simdLevel();
+    bool pixelKernel = level != SimdLevel::SCALAR && (bytewidth == 3 || bytewidth == 4);
+#endif
+
+    switch (filterType) {
+    case 0:
+      std::memcpy(recon, scanline, length);
+      break;
+    case 1:
+#if defined(PNG_SIMD_X86)
+      if (pixelKernel) {
+	unfilterSubSse2(recon, scanline, bytewidth, length);
+	break;
+      }
+#endif
+      unfilterSubScalar(recon, scanline, bytewidth, length);
+      break;
+    case 2:
+      if (!precon) {
+	std::memcpy(recon, scanline, length);
+	break;
+      }
+#if defined(PNG_SIMD_X86)
+      if (level == SimdLevel::AVX2) {
+	unfilterUpAvx2(recon, scanline, precon, length);
+	break;
+      }
+      if (level == SimdLevel::SSE2) {
+	unfilterUpSse2(recon, scanline, precon, length);
+	break;
+      }
+#endif
+      unfilterUpScalar(recon, scanline, precon, length);
+      break;
+    case 3:
+#if defined(PNG_SIMD_X86)
+      if (pixelKernel && precon) {
+	unfilterAverageSse2(recon, scanline, precon, bytewidth, length);
+	break;
+      }
+#endif
+      unfilterAverageScalar(recon, scanline, precon, bytewidth, length);
+      break;
+    case 4:
+#if defined(PNG_SIMD_X86)
+      if (pixelKernel && precon) {
+	unfilterPaethSse2(recon, scanline, precon, bytewidth, length);
+	break;
+      }
+#endif
+      unfilterPaethScalar(recon, scanline, precon, bytewidth, length);
+      break;
+    default:
+      return 36;
+    }
+
+    return 0;
+  }
+
+  void expandRgbToRgba(unsigned char* out, const unsigned char* in, size_t numpixels) {
+#if defined(PNG_SIMD_X86)
+    if (simdLevel() == SimdLevel::AVX2) {
+      expandRgbToRgbaAvx2(out, in, numpixels);
+      return;
+    }
+#endif
+    expandRgbToRgbaScalar(out, in, numpixels);
+  }
+
+  // Hands inflated bytes from the thread running inflate to the thread
+  // unfiltering them, so both run at the same time on large images.
+  struct InflateProgress {
+    std::mutex bufferMutex; // Held while the inflate output may move and while rows are read from it
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t produced = 0; // Bytes at the start of the output that inflate won't touch again
+    bool done = false;
+
+    void publish(size_t bytes, bool finished) {
+      {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->produced = bytes;
+	this->done = finished;
+      }
+      this->condition.notify_one();
+    }
+
+    // Blocks until at least 'bytes' are produced; returns how many there are,
+    // which is less than asked only when inflate stopped early.
+    size_t waitFor(size_t bytes) {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->condition.wait(lock, [this, bytes]() { return this->done || this->produced >= bytes; });
+      return this->produced;
+    }
+  };
+
+  // Only images with at least this many bytes of pixels pay for the extra thread
+  const size_t PIPELINE_MIN_BYTES = 256 * 1024;
+}
+
 int Texture::load(std::vector<unsigned char>& outImage, int& imageWidth, int& imageHeight, const char* filename) {
   std::ifstream file(filename, std::ios::binary);
   std::vector<unsigned char> buffer;
@@ -60,67 +391,108 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
   static const unsigned long CLCL[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15}; //code length code lengths
   struct Zlib //nested functions for zlib decompression
   {
-    static unsigned long readBitFromStream(size_t& bitp, const unsigned char* bits) { unsigned long result = (bits[bitp >> 3] >> (bitp & 0x7)) & 1; bitp++; return result;}
-    static unsigned long readBitsFromStream(size_t& bitp, const unsigned char* bits, size_t nbits)
+    enum { FIRSTBITS = 9, INVALIDSYMBOL = 65535 }; //codes up to FIRSTBITS long resolve with one table lookup, longer ones need a second level
+    enum { PUBLISHSTEP = 16384 }; //bytes inflated between two progress updates to the unfiltering thread
+    struct BitReader //LSB first reader keeping up to 64 bits of the stream in a register
     {
-      unsigned long result = 0;
-      for(size_t i = 0; i < nbits; i++) result += (readBitFromStream(bitp, bits)) << i;
-      return result;
-    }
+      const unsigned char* in; size_t size, pos; unsigned long long buf; unsigned long nbits;
+      void init(const unsigned char* data, size_t length) { in = data; size = length; pos = 0; buf = 0; nbits = 0; }
+      void refill() //tops the buffer up to at least 56 bits, past the end of the input zeros are read
+      {
+        if(pos + 8 <= size) //whole word at once, the bytes above nbits that were already loaded are simply loaded again
+        {
+          unsigned long long word = 0;
+          for(size_t i = 0; i < 8; i++) word |= (unsigned long long)(in[pos + i]) << (8 * i);
+          buf |= word << nbits; pos += (63 - nbits) >> 3; nbits |= 56;
+        }
+        else while(nbits <= 56) { buf |= (unsigned long long)(pos < size ? in[pos] : 0) << nbits; pos++; nbits += 8; }
+      }
+      unsigned long peek(unsigned long n) const { return (unsigned long)(buf & ((1ULL << n) - 1)); }
+      void skip(unsigned long n) { buf >>= n; nbits -= n; }
+      unsigned long read(unsigned long n) { unsigned long result = peek(n); skip(n); return result; } //the buffer must hold n bits
+      size_t bitPos() const { return pos * 8 - nbits; } //bits consumed so far
+      bool overrun() const { return bitPos() > size * 8; } //true once the zeros after the end of the input were used
+      void seek(size_t bytepos) { pos = bytepos; buf = 0; nbits = 0; } //drop the buffer and continue at a byte boundary
+    };
     struct HuffmanTree
     {
       int makeFromLengths(const std::vector<unsigned long>& bitlen, unsigned long maxbitlen)
-      { //make tree given the lengths
-        unsigned long numcodes = (unsigned long)(bitlen.size()), treepos = 0, nodefilled = 0;
-        std::vector<unsigned long> tree1d(numcodes), blcount(maxbitlen + 1, 0), nextcode(maxbitlen + 1, 0);
-        for(unsigned long bits = 0; bits < numcodes; bits++) blcount[bitlen[bits]]++; //count number of instances of each code length
+      { //make the canonical codes given the lengths, then the two level lookup table that decodes them
+        unsigned long numcodes = (unsigned long)(bitlen.size());
+        std::vector<unsigned long> codes(numcodes, 0), blcount(maxbitlen + 1, 0), nextcode(maxbitlen + 1, 0), subbits(1 << FIRSTBITS, 0);
+        for(unsigned long n = 0; n < numcodes; n++) blcount[bitlen[n]]++; //count number of instances of each code length
+        blcount[0] = 0;
+        long left = 1;
+        for(unsigned long bits = 1; bits <= maxbitlen; bits++) { left = 2 * left - (long)(blcount[bits]); if(left < 0) return 55; } //more codes than fit in the tree
         for(unsigned long bits = 1; bits <= maxbitlen; bits++) nextcode[bits] = (nextcode[bits - 1] + blcount[bits - 1]) << 1;
-        for(unsigned long n = 0; n < numcodes; n++) if(bitlen[n] != 0) tree1d[n] = nextcode[bitlen[n]]++; //generate all the codes
-        tree2d.clear(); tree2d.resize(numcodes * 2, 32767); //32767 here means the tree2d isn't filled there yet
-        for(unsigned long n = 0; n < numcodes; n++) //the codes
-        for(unsigned long i = 0; i < bitlen[n]; i++) //the bits for this code
+        for(unsigned long n = 0; n < numcodes; n++) if(bitlen[n] != 0) //generate all the codes, bit reversed because the stream is read LSB first
+        {
+          unsigned long code = nextcode[bitlen[n]]++;
+          for(unsigned long i = 0; i < bitlen[n]; i++) codes[n] |= ((code >> i) & 1) << (bitlen[n] - i - 1);
+        }
+        for(unsigned long n = 0; n < numcodes; n++) //the second level table of a prefix is as wide as its longest code needs
+          if(bitlen[n] > FIRSTBITS) subbits[codes[n] & ((1 << FIRSTBITS) - 1)] = std::max(subbits[codes[n] & ((1 << FIRSTBITS) - 1)], bitlen[n] - FIRSTBITS);
+        size_t tablesize = 1 << FIRSTBITS;
+        for(size_t i = 0; i < subbits.size(); i++) if(subbits[i]) tablesize += (size_t)1 << subbits[i];
+        table.clear(); table.resize(tablesize, 0); //an entry is symbol << 5 | length, 0 means there is no code there
+        for(size_t i = 0, next = 1 << FIRSTBITS; i < subbits.size(); i++) if(subbits[i]) //first level entries pointing at a second level table
+        {
+          table[i] = (unsigned long)(next << 5) | (FIRSTBITS + subbits[i]);
+          next += (size_t)1 << subbits[i];
+        }
+        for(unsigned long n = 0; n < numcodes; n++) if(bitlen[n] != 0)
         {
-          unsigned long bit = (tree1d[n] >> (bitlen[n] - i - 1)) & 1;
-          if(treepos > numcodes - 2) return 55;
-          if(tree2d[2 * treepos + bit] == 32767) //not yet filled in
+          if(bitlen[n] <= FIRSTBITS) for(size_t i = codes[n]; i < (1 << FIRSTBITS); i += (size_t)1 << bitlen[n]) table[i] = (n << 5) | bitlen[n];
+          else
           {
-            if(i + 1 == bitlen[n]) { tree2d[2 * treepos + bit] = n; treepos = 0; } //last bit
-            else { tree2d[2 * treepos + bit] = ++nodefilled + numcodes; treepos = nodefilled; } //addresses are encoded as values > numcodes
+            unsigned long sub = table[codes[n] & ((1 << FIRSTBITS) - 1)], subsize = 1UL << ((sub & 31) - FIRSTBITS);
+            for(size_t i = codes[n] >> FIRSTBITS; i < subsize; i += (size_t)1 << (bitlen[n] - FIRSTBITS)) table[(sub >> 5) + i] = (n << 5) | (bitlen[n] - FIRSTBITS);
           }
-          else treepos = tree2d[2 * treepos + bit] - numcodes; //subtract numcodes from address to get address value
         }
         return 0;
       }
-      int decode(bool& decoded, unsigned long& result, size_t& treepos, unsigned long bit) const
-      { //Decodes a symbol from the tree
-        unsigned long numcodes = (unsigned long)tree2d.size() / 2;
-        if(treepos >= numcodes) return 11; //error: you appeared outside the codetree
-        result = tree2d[2 * treepos + bit];
-        decoded = (result < numcodes);
-        treepos = decoded ? 0 : result - numcodes;
-        return 0;
+      unsigned long decode(BitReader& br) const
+      { //decodes a symbol with at most two lookups, the reader must hold at least 15 bits. Returns INVALIDSYMBOL for bits that are no code
+        unsigned long entry = table[br.peek(FIRSTBITS)], length = entry & 31;
+        if(length > FIRSTBITS) { br.skip(FIRSTBITS); entry = table[(entry >> 5) + br.peek(length - FIRSTBITS)]; length = entry & 31; }
+        if(length == 0) return INVALIDSYMBOL;
+        br.skip(length);
+        return entry >> 5;
       }
-      std::vector<unsigned long> tree2d; //2D representation of a huffman tree: The one dimension is "0" or "1", the other contains all nodes and leaves of the tree.
+      std::vector<unsigned long> table; //FIRSTBITS wide first level indexed by the next stream bits, followed by the second level tables
     };
     struct Inflator
     {
       int error;
-      void inflate(std::vector<unsigned char>& out, const std::vector<unsigned char>& in, size_t inpos = 0)
+      bool fixedtrees;
+      InflateProgress* progress; //set when another thread reads the output while it is inflated
+      size_t publishat; //output position at which progress is published next
+      void inflate(std::vector<unsigned char>& out, const std::vector<unsigned char>& in, size_t inpos = 0, InflateProgress* inflateprogress = 0)
       {
-        size_t bp = 0, pos = 0; //bit pointer and byte pointer
-        error = 0;
+        size_t pos = 0; //byte pointer in the output
+        BitReader br; br.init(&in[inpos], in.size() - inpos);
+        error = 0; fixedtrees = false;
+        progress = inflateprogress; publishat = progress ? (size_t)(PUBLISHSTEP) : (size_t)(-1);
         unsigned long BFINAL = 0;
         while(!BFINAL && !error)
         {
-          if(bp >> 3 >= in.size()) { error = 52; return; } //error, bit pointer will jump past memory
-          BFINAL = readBitFromStream(bp, &in[inpos]);
-          unsigned long BTYPE = readBitFromStream(bp, &in[inpos]); BTYPE += 2 * readBitFromStream(bp, &in[inpos]);
+          if(pos >= publishat) publish(pos);
+          if(br.bitPos() >> 3 >= br.size) { error = 52; return; } //error, bit pointer will jump past memory
+          br.refill();
+          BFINAL = br.read(1);
+          unsigned long BTYPE = br.read(2);
           if(BTYPE == 3) { error = 20; return; } //error: invalid BTYPE
-          else if(BTYPE == 0) inflateNoCompression(out, &in[inpos], bp, pos, in.size());
-          else inflateHuffmanBlock(out, &in[inpos], bp, pos, in.size(), BTYPE);
+          else if(BTYPE == 0) inflateNoCompression(out, br, pos);
+          else inflateHuffmanBlock(out, br, pos, BTYPE);
         }
-        if(!error) out.resize(pos); //Only now we know the true size of out, resize it to that
+        if(!error) resizeOutput(out, pos); //Only now we know the true size of out, resize it to that
+      }
+      void resizeOutput(std::vector<unsigned char>& out, size_t size) //the other thread may be reading the published part of out, don't move it under its feet
+      {
+        if(progress) { std::lock_guard<std::mutex> lock(progress->bufferMutex); out.resize(size); }
+        else out.resize(size);
       }
+      void publish(size_t pos) { progress->publish(pos, false); publishat = pos + PUBLISHSTEP; } //everything before pos is final
       void generateFixedTrees(HuffmanTree& tree, HuffmanTree& treeD) //get the tree of a deflated block with fixed tree
       {
         std::vector<unsigned long> bitlen(288, 8), bitlenD(32, 5);;
@@ -129,36 +501,35 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
         tree.makeFromLengths(bitlen, 15);
         treeD.makeFromLengths(bitlenD, 15);
       }
-      HuffmanTree codetree, codetreeD, codelengthcodetree; //the code tree for Huffman codes, dist codes, and code length codes
-      unsigned long huffmanDecodeSymbol(const unsigned char* in, size_t& bp, const HuffmanTree& codetree, size_t inlength)
+      HuffmanTree codetree, codetreeD, codelengthcodetree, fixedtree, fixedtreeD; //the code tree for Huffman codes, dist codes, code length codes and the fixed trees
+      unsigned long huffmanDecodeSymbol(BitReader& br, const HuffmanTree& codetree)
       { //decode a single symbol from given list of bits with given code tree. return value is the symbol
-        bool decoded; unsigned long ct;
-        for(size_t treepos = 0;;)
-        {
-          if((bp & 0x07) == 0 && (bp >> 3) > inlength) { error = 10; return 0; } //error: end reached without endcode
-          error = codetree.decode(decoded, ct, treepos, readBitFromStream(bp, in)); if(error) return 0; //stop, an error happened
-          if(decoded) return ct;
-        }
+        br.refill();
+        unsigned long ct = codetree.decode(br);
+        if(ct == INVALIDSYMBOL) { error = 11; return 0; } //error: you appeared outside the codetree
+        if(br.overrun()) { error = 10; return 0; } //error: end reached without endcode
+        return ct;
       }
-      void getTreeInflateDynamic(HuffmanTree& tree, HuffmanTree& treeD, const unsigned char* in, size_t& bp, size_t inlength)
+      unsigned long readBits(BitReader& br, unsigned long nbits) { br.refill(); return br.read(nbits); }
+      void getTreeInflateDynamic(HuffmanTree& tree, HuffmanTree& treeD, BitReader& br)
       { //get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree
         std::vector<unsigned long> bitlen(288, 0), bitlenD(32, 0);
-        if(bp >> 3 >= inlength - 2) { error = 49; return; } //the bit pointer is or will go past the memory
-        size_t HLIT =  readBitsFromStream(bp, in, 5) + 257; //number of literal/length codes + 257
-        size_t HDIST = readBitsFromStream(bp, in, 5) + 1; //number of dist codes + 1
-        size_t HCLEN = readBitsFromStream(bp, in, 4) + 4; //number of code length codes + 4
+        if(br.bitPos() >> 3 >= br.size - 2) { error = 49; return; } //the bit pointer is or will go past the memory
+        size_t HLIT =  readBits(br, 5) + 257; //number of literal/length codes + 257
+        size_t HDIST = readBits(br, 5) + 1; //number of dist codes + 1
+        size_t HCLEN = readBits(br, 4) + 4; //number of code length codes + 4
         std::vector<unsigned long> codelengthcode(19); //lengths of tree to decode the lengths of the dynamic tree
-        for(size_t i = 0; i < 19; i++) codelengthcode[CLCL[i]] = (i < HCLEN) ? readBitsFromStream(bp, in, 3) : 0;
+        for(size_t i = 0; i < 19; i++) codelengthcode[CLCL[i]] = (i < HCLEN) ? readBits(br, 3) : 0;
         error = codelengthcodetree.makeFromLengths(codelengthcode, 7); if(error) return;
         size_t i = 0, replength;
         while(i < HLIT + HDIST)
         {
-          unsigned long code = huffmanDecodeSymbol(in, bp, codelengthcodetree, inlength); if(error) return;
+          unsigned long code = huffmanDecodeSymbol(br, codelengthcodetree); if(error) return;
           if(code <= 15)  { if(i < HLIT) bitlen[i++] = code; else bitlenD[i++ - HLIT] = code; } //a length code
           else if(code == 16) //repeat previous
           {
-            if(bp >> 3 >= inlength) { error = 50; return; } //error, bit pointer jumps past memory
-            replength = 3 + readBitsFromStream(bp, in, 2);
+            if(i == 0) { error = 54; return; } //error: there is no previous length to repeat
+            replength = 3 + readBits(br, 2);
             unsigned long value; //set value to the previous code
             if((i - 1) < HLIT) value = bitlen[i - 1];
             else value = bitlenD[i - HLIT - 1];
@@ -170,8 +541,7 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
           }
           else if(code == 17) //repeat "0" 3-10 times
           {
-            if(bp >> 3 >= inlength) { error = 50; return; } //error, bit pointer jumps past memory
-            replength = 3 + readBitsFromStream(bp, in, 3);
+            replength = 3 + readBits(br, 3);
             for(size_t n = 0; n < replength; n++) //repeat this value in the next lengths
             {
               if(i >= HLIT + HDIST) { error = 14; return; } //error: i is larger than the amount of codes
@@ -180,8 +550,7 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
           }
           else if(code == 18) //repeat "0" 11-138 times
           {
-            if(bp >> 3 >= inlength) { error = 50; return; } //error, bit pointer jumps past memory
-            replength = 11 + readBitsFromStream(bp, in, 7);
+            replength = 11 + readBits(br, 7);
             for(size_t n = 0; n < replength; n++) //repeat this value in the next lengths
             {
               if(i >= HLIT + HDIST) { error = 15; return; } //error: i is larger than the amount of codes
@@ -189,54 +558,70 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
             }
           }
           else { error = 16; return; } //error: somehow an unexisting code appeared. This can never happen.
+          if(br.overrun()) { error = 50; return; } //error, bit pointer jumps past memory
         }
         if(bitlen[256] == 0) { error = 64; return; } //the length of the end code 256 must be larger than 0
         error = tree.makeFromLengths(bitlen, 15); if(error) return; //now we've finally got HLIT and HDIST, so generate the code trees, and the function is done
         error = treeD.makeFromLengths(bitlenD, 15); if(error) return;
       }
-      void inflateHuffmanBlock(std::vector<unsigned char>& out, const unsigned char* in, size_t& bp, size_t& pos, size_t inlength, unsigned long btype)
+      void inflateHuffmanBlock(std::vector<unsigned char>& out, BitReader& br, size_t& pos, unsigned long btype)
       {
-        if(btype == 1) { generateFixedTrees(codetree, codetreeD); }
-        else if(btype == 2) { getTreeInflateDynamic(codetree, codetreeD, in, bp, inlength); if(error) return; }
+        const HuffmanTree* tree = &codetree, * treeD = &codetreeD;
+        if(btype == 1) //the fixed trees never change, build them once per stream
+        {
+          if(!fixedtrees) { generateFixedTrees(fixedtree, fixedtreeD); fixedtrees = true; }
+          tree = &fixedtree; treeD = &fixedtreeD;
+        }
+        else if(btype == 2) { getTreeInflateDynamic(codetree, codetreeD, br); if(error) return; }
         for(;;)
         {
-          unsigned long code = huffmanDecodeSymbol(in, bp, codetree, inlength); if(error) return;
-          if(code == 256) return; //end code
-          else if(code <= 255) //literal symbol
+          if(pos + 258 + 8 > out.size()) resizeOutput(out, (pos + 258 + 8) * 2); //reserve room for the longest match and the overshoot of the 8 byte copies
+          if(pos >= publishat) publish(pos);
+          unsigned char* out_ = &out[0]; //regular pointer, out does not move again before the next symbol
+          br.refill();
+          unsigned long code = tree->decode(br);
+          if(code <= 255) //literal symbol, keep decoding literals while the buffer still holds a full code
           {
-            if(pos >= out.size()) out.resize((pos + 1) * 2); //reserve more room
-            out[pos++] = (unsigned char)(code);
+            out_[pos++] = (unsigned char)(code);
+            while(br.nbits >= 15 && (code = tree->decode(br)) <= 255) out_[pos++] = (unsigned char)(code);
+            if(code <= 255) { if(br.overrun()) { error = 10; return; } continue; } //error: end reached without endcode
           }
+          if(code == 256) { if(br.overrun()) error = 10; return; } //end code
           else if(code >= 257 && code <= 285) //length code
           {
-            size_t length = LENBASE[code - 257], numextrabits = LENEXTRA[code - 257];
-            if((bp >> 3) >= inlength) { error = 51; return; } //error, bit pointer will jump past memory
-            length += readBitsFromStream(bp, in, numextrabits);
-            unsigned long codeD = huffmanDecodeSymbol(in, bp, codetreeD, inlength); if(error) return;
+            br.refill(); //enough bits for the length extra bits, the distance code and its extra bits
+            size_t length = LENBASE[code - 257] + br.read(LENEXTRA[code - 257]);
+            unsigned long codeD = treeD->decode(br);
+            if(codeD == INVALIDSYMBOL) { error = 11; return; } //error: you appeared outside the codetree
             if(codeD > 29) { error = 18; return; } //error: invalid dist code (30-31 are never used)
-            unsigned long dist = DISTBASE[codeD], numextrabitsD = DISTEXTRA[codeD];
-            if((bp >> 3) >= inlength) { error = 51; return; } //error, bit pointer will jump past memory
-            dist += readBitsFromStream(bp, in, numextrabitsD);
-            size_t start = pos, back = start - dist; //backwards
-            if(pos + length >= out.size()) out.resize((pos + length) * 2); //reserve more room
-            for(size_t i = 0; i < length; i++) { out[pos++] = out[back++]; if(back >= start) back = start - dist; }
+            size_t dist = DISTBASE[codeD] + br.read(DISTEXTRA[codeD]);
+            if(br.overrun()) { error = 51; return; } //error, bit pointer jumped past memory
+            if(dist > pos) { error = 52; return; } //error: the distance points before the start of the output
+            unsigned char* dest = &out_[pos]; const unsigned char* src = dest - dist; pos += length;
+            if(dist >= 8) for(size_t i = 0; i < length; i += 8) std::memcpy(dest + i, src + i, 8); //each 8 byte step only reads bytes already written
+            else if(dist == 1) std::memset(dest, *src, length); //run of a single byte
+            else for(size_t i = 0; i < length; i++) dest[i] = src[i]; //short overlapping distance, the pattern repeats byte per byte
           }
+          else if(code == INVALIDSYMBOL) { error = 11; return; } //error: you appeared outside the codetree
+          else { error = 16; return; } //error: length codes 286 and 287 are never used
         }
       }
-      void inflateNoCompression(std::vector<unsigned char>& out, const unsigned char* in, size_t& bp, size_t& pos, size_t inlength)
+      void inflateNoCompression(std::vector<unsigned char>& out, BitReader& br, size_t& pos)
       {
-        while((bp & 0x7) != 0) bp++; //go to first boundary of byte
-        size_t p = bp / 8;
-        if(p >= inlength - 4) { error = 52; return; } //error, bit pointer will jump past memory
+        br.skip(br.nbits & 0x7); //go to first boundary of byte
+        size_t p = br.bitPos() / 8, inlength = br.size;
+        const unsigned char* in = br.in;
+        if(p + 4 > inlength) { error = 52; return; } //error, bit pointer will jump past memory
         unsigned long LEN = in[p] + 256 * in[p + 1], NLEN = in[p + 2] + 256 * in[p + 3]; p += 4;
         if(LEN + NLEN != 65535) { error = 21; return; } //error: NLEN is not one's complement of LEN
-        if(pos + LEN >= out.size()) out.resize(pos + LEN);
+        if(pos + LEN >= out.size()) resizeOutput(out, pos + LEN);
         if(p + LEN > inlength) { error = 23; return; } //error: reading outside of in buffer
-        for(unsigned long n = 0; n < LEN; n++) out[pos++] = in[p++]; //read LEN bytes of literal data
-        bp = p * 8;
+        if(LEN) std::memcpy(&out[pos], &in[p], LEN); //read LEN bytes of literal data
+        pos += LEN; p += LEN;
+        br.seek(p);
       }
     };
-    int decompress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in) //returns error value
+    int decompress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in, InflateProgress* progress = 0) //returns error value
     {
       Inflator inflator;
       if(in.size() < 2) { return 53; } //error, size of zlib data too small
@@ -244,7 +629,7 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
       unsigned long CM = in[0] & 15, CINFO = (in[0] >> 4) & 15, FDICT = (in[1] >> 5) & 1;
       if(CM != 8 || CINFO > 7) { return 25; } //error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec
       if(FDICT != 0) { return 26; } //error: the specification of PNG says about the zlib stream: "The additional flags shall not specify a preset dictionary."
-      inflator.inflate(out, in, 2);
+      inflator.inflate(out, in, 2, progress);
       return inflator.error; //note: adler32 checksum was skipped and ignored
     }
   };
@@ -321,10 +706,23 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
         pos += 4; //step over CRC (which is ignored)
       }
       unsigned long bpp = getBpp(info);
-      std::vector<unsigned char> scanlines(((info.width * (info.height * bpp + 7)) / 8) + info.height); //now the out buffer will be filled
+      std::vector<unsigned char> scanlines(((info.width * (info.height * bpp + 7)) / 8) + info.height + 258 + 8); //now the out buffer will be filled, with the room inflate overshoots by so it doesn't have to grow it
       Zlib zlib; //decompress with the Zlib decompressor
-      error = zlib.decompress(scanlines, idat); if(error) return; //stop if the zlib decompressor returned an error
       size_t bytewidth = (bpp + 7) / 8, outlength = (info.height * info.width * bpp + 7) / 8;
+      if(info.interlaceMethod == 0 && bpp >= 8 && outlength >= PIPELINE_MIN_BYTES && std::thread::hardware_concurrency() > 1)
+      { //big image: unfilter on a second thread while inflate is still producing the rows
+        out.resize(outlength); //time to fill the out buffer
+        InflateProgress progress; int unfiltererror = 0;
+        std::thread unfilterthread([&]() { unfiltererror = unFilterRows(&out[0], scanlines, progress, bytewidth, (info.width * bpp + 7) / 8, info.height); });
+        error = zlib.decompress(scanlines, idat, &progress);
+        progress.publish(error ? 0 : scanlines.size(), true); //wakes the unfiltering thread for the last rows, or stops it
+        unfilterthread.join();
+        if(!error) error = unfiltererror;
+        if(error) return;
+      }
+      else
+      {
+      error = zlib.decompress(scanlines, idat); if(error) return; //stop if the zlib decompressor returned an error
       out.resize(outlength); //time to fill the out buffer
       unsigned char* out_ = outlength ? &out[0] : 0; //use a regular pointer to the std::vector for faster code if compiled without optimization
       if(info.interlaceMethod == 0) //no interlace, just filter
@@ -362,9 +760,10 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
         for(int i = 0; i < 7; i++)
           adam7Pass(&out_[0], &scanlinen[0], &scanlineo[0], &scanlines[passstart[i]], info.width, pattern[i], pattern[i + 7], pattern[i + 14], pattern[i + 21], passw[i], passh[i], bpp);
       }
+      }
       if(convert_to_rgba32 && (info.colorType != 6 || info.bitDepth != 8)) //conversion needed
       {
-        std::vector<unsigned char> data = out;
+        std::vector<unsigned char> data; data.swap(out); //convert fills a new out from the unconverted pixels
         error = convert(out, &data[0], info, info.width, info.height);
       }
     }
@@ -382,43 +781,25 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
     }
     void unFilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t bytewidth, unsigned long filterType, size_t length)
     {
-      switch(filterType)
+      error = unfilterScanline(recon, scanline, precon, bytewidth, filterType, length); //the SIMD or scalar kernels above decodeFile
+    }
+    int unFilterRows(unsigned char* out_, const std::vector<unsigned char>& scanlines, InflateProgress& progress, size_t bytewidth, size_t linelength, unsigned long height)
+    { //unfilters each row of a non interlaced image as soon as inflate has produced it, runs on its own thread. Returns the error value
+      size_t linestart = 0;
+      for(unsigned long y = 0; y < height;)
       {
-        case 0: for(size_t i = 0; i < length; i++) recon[i] = scanline[i]; break;
-        case 1:
-          for(size_t i =         0; i < bytewidth; i++) recon[i] = scanline[i];
-          for(size_t i = bytewidth; i <    length; i++) recon[i] = scanline[i] + recon[i - bytewidth];
-          break;
-        case 2:
-          if(precon) for(size_t i = 0; i < length; i++) recon[i] = scanline[i] + precon[i];
-          else       for(size_t i = 0; i < length; i++) recon[i] = scanline[i];
-          break;
-        case 3:
-          if(precon)
-          {
-            for(size_t i =         0; i < bytewidth; i++) recon[i] = scanline[i] + precon[i] / 2;
-            for(size_t i = bytewidth; i <    length; i++) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) / 2);
-          }
-          else
-          {
-            for(size_t i =         0; i < bytewidth; i++) recon[i] = scanline[i];
-            for(size_t i = bytewidth; i <    length; i++) recon[i] = scanline[i] + recon[i - bytewidth] / 2;
-          }
-          break;
-        case 4:
-          if(precon)
-          {
-            for(size_t i =         0; i < bytewidth; i++) recon[i] = scanline[i] + paethPredictor(0, precon[i], 0);
-            for(size_t i = bytewidth; i <    length; i++) recon[i] = scanline[i] + paethPredictor(recon[i - bytewidth], precon[i], precon[i - bytewidth]);
-          }
-          else
-          {
-            for(size_t i =         0; i < bytewidth; i++) recon[i] = scanline[i];
-            for(size_t i = bytewidth; i <    length; i++) recon[i] = scanline[i] + paethPredictor(recon[i - bytewidth], 0, 0);
-          }
-          break;
-        default: error = 36; return; //error: unexisting filter type given
+        size_t available = progress.waitFor(linestart + 1 + linelength);
+        if(linestart + 1 + linelength > available) return 0; //inflate stopped early, its error is the one reported
+        std::lock_guard<std::mutex> lock(progress.bufferMutex);
+        const unsigned char* in = &scanlines[0];
+        for(; y < height && linestart + 1 + linelength <= available; y++)
+        {
+          const unsigned char* prevline = (y == 0) ? 0 : &out_[(y - 1) * linelength];
+          int rowerror = unfilterScanline(&out_[linestart - y], &in[linestart + 1], prevline, bytewidth, in[linestart], linelength); if(rowerror) return rowerror;
+          linestart += (1 + linelength); //go to start of next scanline
+        }
       }
+      return 0;
     }
     void adam7Pass(unsigned char* out, unsigned char* linen, unsigned char* lineo, const unsigned char* in, unsigned long w, size_t passleft, size_t passtop, size_t spacex, size_t spacey, size_t passw, size_t passh, unsigned long bpp)
     { //filter and reposition the pixels into the output when the image is Adam7 interlaced. This function can only do it after the full image is already decoded. The out buffer must have the correct allocated memory size already.
@@ -471,6 +852,7 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
         out_[4 * i + 0] = out_[4 * i + 1] = out_[4 * i + 2] = in[i];
         out_[4 * i + 3] = (infoIn.key_defined && in[i] == infoIn.key_r) ? 0 : 255;
       }
+      else if(infoIn.bitDepth == 8 && infoIn.colorType == 2 && !infoIn.key_defined) expandRgbToRgba(out_, in, numpixels); //RGB color, every pixel opaque
       else if(infoIn.bitDepth == 8 && infoIn.colorType == 2) //RGB color
       for(size_t i = 0; i < numpixels; i++)
       {
@@ -525,11 +907,6 @@ int Texture::decodeFile(std::vector<unsigned char>& out_image, int& image_width,
       }
       return 0;
     }
-    unsigned char paethPredictor(short a, short b, short c) //Paeth predicter, used by PNG filter type 4
-    {
-      short p = a + b - c, pa = p > a ? (p - a) : (a - p), pb = p > b ? (p - b) : (b - p), pc = p > c ? (p - c) : (c - p);
-      return (unsigned char)((pa <= pb && pa <= pc) ? a : pb <= pc ? b : c);
-    }
   };
   PNG decoder; decoder.decode(out_image, in_png, in_size, convert_to_rgba32);
   image_width = decoder.info.width; image_height = decoder.info.height;
@@ -8,11 +8,10 @@ layout (location = 1) in vec2 texCoords;
 out vec2 fTexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frameData.glsl"
 
 void main() {
-  gl_Position = projection * view * model * vec4(position, 1.0f);
+  gl_Position = viewProjection * model * vec4(position, 1.0f);
   fTexCoords = texCoords;
 }
 
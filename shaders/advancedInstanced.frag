@@ -0,0 +1,14 @@
+// Fragment shader for instanced primitives.
+// ========================
+#version 330 core
+
+in vec2 fTexCoords;
+flat in vec4 fTint;
+
+out vec4 color;
+
+uniform sampler2D texture1;
+
+void main() {
+  color = texture(texture1, fTexCoords) * fTint;
+}
@@ -0,0 +1,20 @@
+// Vertex shader for instanced primitives.
+// =============================
+#version 330 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texCoords;
+layout (location = 6) in mat4 instanceModel; // Per instance, locations 6 to 9
+layout (location = 10) in vec4 instanceTint; // Per instance
+
+out vec2 fTexCoords;
+flat out vec4 fTint;
+
+uniform mat4 model; // The primitive's own matrix, under each instance's
+#include "frameData.glsl"
+
+void main() {
+  gl_Position = viewProjection * instanceModel * model * vec4(position, 1.0f);
+  fTexCoords = texCoords;
+  fTint = instanceTint;
+}
@@ -0,0 +1,9 @@
+// Shared by every draw of a frame, uploaded once per frame by
+// FrameUniforms (src/FrameData.h) and bound at FRAME_DATA_BINDING.
+layout (std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  vec4 cameraPosition; // w is 1
+  float time;          // Seconds since the start
+};
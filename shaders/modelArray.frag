@@ -0,0 +1,20 @@
+// Fragment shader for models with packed texture arrays.
+// ========================
+#version 330 core
+
+in vec2 fTexCoords;
+flat in vec2 fMaterialLayers;
+
+out vec4 color;
+
+uniform sampler2DArray texture_diffuse_array;
+uniform sampler2DArray texture_specular_array;
+
+void main() {
+  // A negative layer means the mesh has no diffuse texture
+  if (fMaterialLayers.x < 0.0) {
+    color = vec4(1.0);
+  } else {
+    color = texture(texture_diffuse_array, vec3(fTexCoords, fMaterialLayers.x));
+  }
+}
@@ -0,0 +1,20 @@
+// Vertex shader for models with packed texture arrays.
+// =============================
+#version 330 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoords;
+layout (location = 3) in vec2 materialLayers; // Per mesh: diffuse and specular layer
+
+out vec2 fTexCoords;
+flat out vec2 fMaterialLayers;
+
+uniform mat4 model;
+#include "frameData.glsl"
+
+void main() {
+  gl_Position = viewProjection * model * vec4(position, 1.0f);
+  fTexCoords = texCoords;
+  fMaterialLayers = materialLayers;
+}
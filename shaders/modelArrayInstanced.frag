@@ -0,0 +1,21 @@
+// Fragment shader for instanced models with packed texture arrays.
+// ========================
+#version 330 core
+
+in vec2 fTexCoords;
+flat in vec2 fMaterialLayers;
+flat in vec4 fTint;
+
+out vec4 color;
+
+uniform sampler2DArray texture_diffuse_array;
+uniform sampler2DArray texture_specular_array;
+
+void main() {
+  // A negative layer means the mesh has no diffuse texture
+  if (fMaterialLayers.x < 0.0) {
+    color = fTint;
+  } else {
+    color = texture(texture_diffuse_array, vec3(fTexCoords, fMaterialLayers.x)) * fTint;
+  }
+}
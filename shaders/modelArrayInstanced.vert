@@ -0,0 +1,24 @@
+// Vertex shader for instanced models with packed texture arrays.
+// =============================
+#version 330 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoords;
+layout (location = 3) in vec2 materialLayers; // Per mesh: diffuse and specular layer
+layout (location = 6) in mat4 instanceModel;  // Per instance, locations 6 to 9
+layout (location = 10) in vec4 instanceTint;  // Per instance
+
+out vec2 fTexCoords;
+flat out vec2 fMaterialLayers;
+flat out vec4 fTint;
+
+uniform mat4 model; // The node's matrix within the model
+#include "frameData.glsl"
+
+void main() {
+  gl_Position = viewProjection * instanceModel * model * vec4(position, 1.0f);
+  fTexCoords = texCoords;
+  fMaterialLayers = materialLayers;
+  fTint = instanceTint;
+}
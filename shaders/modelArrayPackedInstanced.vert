@@ -0,0 +1,38 @@
+// Vertex shader for instanced models with packed texture arrays and packed vertices.
+// =============================
+#version 330 core
+
+layout (location = 0) in vec3 position;       // Unorm16 within the mesh's bounding box
+layout (location = 1) in vec2 normal;         // Octahedral, snorm16
+layout (location = 2) in vec2 texCoords;      // Half floats
+layout (location = 3) in vec2 materialLayers; // Per mesh: diffuse and specular layer
+layout (location = 4) in vec3 positionOffset; // Per mesh: bounding box minimum
+layout (location = 5) in vec3 positionScale;  // Per mesh: bounding box size
+layout (location = 6) in mat4 instanceModel;  // Per instance, locations 6 to 9
+layout (location = 10) in vec4 instanceTint;  // Per instance
+
+out vec2 fTexCoords;
+out vec3 fNormal;
+flat out vec2 fMaterialLayers;
+flat out vec4 fTint;
+
+uniform mat4 model; // The node's matrix within the model
+#include "frameData.glsl"
+
+vec3 octahedralDecode(vec2 encoded) {
+  vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  float fold = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -fold : fold;
+  n.y += n.y >= 0.0 ? -fold : fold;
+  return normalize(n);
+}
+
+void main() {
+  vec3 meshPosition = positionOffset + position * positionScale;
+  mat4 world = instanceModel * model;
+  gl_Position = viewProjection * world * vec4(meshPosition, 1.0f);
+  fTexCoords = texCoords;
+  fNormal = mat3(world) * octahedralDecode(normal);
+  fMaterialLayers = materialLayers;
+  fTint = instanceTint;
+}
@@ -0,0 +1,141 @@
+#include "AllocationCounter.h"
+
+#ifdef GAME_COUNT_ALLOCATIONS
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+  std::atomic<size_t> heapAllocations(0);
+
+  void* allocate(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+  }
+
+  // Over-aligned types, their new and delete bypass the plain forms
+  void* allocateAligned(size_t size, std::align_val_t alignment) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    size = (std::max<size_t>(size, 1) + align - 1) & ~(align - 1);
+#ifdef _MSC_VER
+    return _aligned_malloc(size, align);
+#else
+    return std::aligned_alloc(align, size);
+#endif
+  }
+
+  void freeAligned(void* memory) {
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+  }
+}
+
+// Every replaceable form of new is counted here, so none of them can fall
+// back on a library version that would not count
+void* operator new(size_t size) {
+  void* memory = allocate(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  void* memory = allocateAligned(size, alignment);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return ::operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+  freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+  freeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+  freeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+  freeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+  freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+  freeAligned(memory);
+}
+
+size_t heapAllocationCount() {
+  return heapAllocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+size_t heapAllocationCount() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+// STD
+#include <cstddef>
+
+// Built with GAME_COUNT_ALLOCATIONS the global operator new, in all its
+// forms, counts every heap allocation the program makes, on any thread. Take the count before
+// and after a piece of code to see whether it allocated. Without it the
+// count stays 0.
+size_t heapAllocationCount();
@@ -0,0 +1,502 @@
+#include "BlockCompression.h"
+
+// STD
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  // The 16 texels of a block split by channel. Values are whole numbers, so
+  // squared distances stay exact in float and the SSE2 and scalar index
+  // search pick the same entries.
+  struct Block {
+    float channels[4][16];
+  };
+
+  const int COLOR_CHANNELS[3] = { 0, 1, 2 };
+
+  void fetchBlock(const unsigned char* rgbaPixels, int width, int height,
+		  int blockX, int blockY, Block& block) {
+    for (int y = 0; y < 4; y++) {
+      int sourceY = std::min(blockY * 4 + y, height - 1);
+      for (int x = 0; x < 4; x++) {
+	int sourceX = std::min(blockX * 4 + x, width - 1);
+	const unsigned char* texel = rgbaPixels + ((size_t)sourceY * width + sourceX) * 4;
+	for (int channel = 0; channel < 4; channel++) {
+	  block.channels[channel][y * 4 + x] = texel[channel];
+	}
+      }
+    }
+  }
+
+  // Picks the closest palette entry for every texel of the block
+  void selectIndices(const Block& block, const int* channels, int channelCount,
+		     const float palette[][3], int paletteSize, unsigned char indices[16]) {
+#if defined(BC_SIMD_SSE2)
+    for (int group = 0; group < 16; group += 4) {
+      __m128 best = _mm_set1_ps(FLT_MAX);
+      __m128i bestIndex = _mm_setzero_si128();
+
+      for (int entry = 0; entry < paletteSize; entry++) {
+	__m128 distance = _mm_setzero_ps();
+	for (int k = 0; k < channelCount; k++) {
+	  __m128 difference = _mm_sub_ps(_mm_loadu_ps(&block.channels[channels[k]][group]),
+					 _mm_set1_ps(palette[entry][k]));
+	  distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+	}
+
+	__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+	best = _mm_min_ps(distance, best);
+	bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(entry)),
+				 _mm_andnot_si128(closer, bestIndex));
+      }
+
+      int32_t lanes[4];
+      _mm_storeu_si128((__m128i*)lanes, bestIndex);
+      for (int i = 0; i < 4; i++) {
+	indices[group + i] = (unsigned char)lanes[i];
+      }
+    }
+#else
+    for (int texel = 0; texel < 16; texel++) {
+      float best = FLT_MAX;
+      int bestIndex = 0;
+
+      for (int entry = 0; entry < paletteSize; entry++) {
+	float distance = 0.0f;
+	for (int k = 0; k < channelCount; k++) {
+	  float difference = block.channels[channels[k]][texel] - palette[entry][k];
+	  distance = distance + difference * difference;
+	}
+
+	if (distance < best) {
+	  best = distance;
+	  bestIndex = entry;
+	}
+      }
+      indices[texel] = (unsigned char)bestIndex;
+    }
+#endif
+  }
+
+  uint16_t packRgb565(const float color[3]) {
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+  }
+
+  void unpackRgb565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+  }
+
+  // The four BC1 colours, or three plus black when color0 <= color1
+  void colorPalette(uint16_t color0, uint16_t color1, bool forceFourColors, int palette[4][3]) {
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+      if (color0 > color1 || forceFourColors) {
+	palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+	palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+      } else {
+	palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+	palette[3][c] = 0;
+      }
+    }
+  }
+
+  // The eight BC4 values, or six plus 0 and 255 when value0 <= value1
+  void singleChannelPalette(int value0, int value1, int palette[8]) {
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1) {
+      for (int k = 1; k < 7; k++) {
+	palette[k + 1] = ((7 - k) * value0 + k * value1 + 3) / 7;
+      }
+    } else {
+      for (int k = 1; k < 5; k++) {
+	palette[k + 1] = ((5 - k) * value0 + k * value1 + 2) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+  }
+
+  // Least squares fit of the two endpoints to the texels, given which of
+  // the four palette steps each texel is currently closest to
+  void refineEndpoints(const Block& block, float end0[3], float end1[3]) {
+    float direction[3] = { end0[0] - end1[0], end0[1] - end1[1], end0[2] - end1[2] };
+    float length = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+    if (length < 1.0f) {
+      return;
+    }
+
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x[3] = {}, y[3] = {};
+    for (int texel = 0; texel < 16; texel++) {
+      float projection = 0.0f;
+      for (int k = 0; k < 3; k++) {
+	projection += (block.channels[k][texel] - end1[k]) * direction[k];
+      }
+      float t = std::floor(std::min(std::max(projection / length * 3.0f, 0.0f), 3.0f) + 0.5f) / 3.0f;
+
+      a += (1.0f - t) * (1.0f - t);
+      b += t * (1.0f - t);
+      c += t * t;
+      for (int k = 0; k < 3; k++) {
+	x[k] += (1.0f - t) * block.channels[k][texel];
+	y[k] += t * block.channels[k][texel];
+      }
+    }
+
+    float determinant = a * c - b * b;
+    if (std::fabs(determinant) < 1e-6f) {
+      return;
+    }
+
+    for (int k = 0; k < 3; k++) {
+      end1[k] = std::min(std::max((c * x[k] - b * y[k]) / determinant, 0.0f), 255.0f);
+      end0[k] = std::min(std::max((a * y[k] - b * x[k]) / determinant, 0.0f), 255.0f);
+    }
+  }
+
+  // BC1 colour block, always in four colour mode
+  void encodeColorBlock(const Block& block, unsigned char* out) {
+    // Principal axis of the colours, by power iteration on the covariance
+    float mean[3] = {}, minimum[3], maximum[3];
+    for (int k = 0; k < 3; k++) {
+      minimum[k] = maximum[k] = block.channels[k][0];
+      for (int texel = 0; texel < 16; texel++) {
+	mean[k] += block.channels[k][texel];
+	minimum[k] = std::min(minimum[k], block.channels[k][texel]);
+	maximum[k] = std::max(maximum[k], block.channels[k][texel]);
+      }
+      mean[k] /= 16.0f;
+    }
+
+    float covariance[3][3] = {};
+    for (int texel = 0; texel < 16; texel++) {
+      float offset[3];
+      for (int k = 0; k < 3; k++) {
+	offset[k] = block.channels[k][texel] - mean[k];
+      }
+      for (int i = 0; i < 3; i++) {
+	for (int j = 0; j < 3; j++) {
+	  covariance[i][j] += offset[i] * offset[j];
+	}
+      }
+    }
+
+    float axis[3] = { maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2] };
+    for (int iteration = 0; iteration < 4; iteration++) {
+      float next[3];
+      for (int i = 0; i < 3; i++) {
+	next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+      }
+      float scale = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+      if (scale < 1e-6f) {
+	break;
+      }
+      for (int i = 0; i < 3; i++) {
+	axis[i] = next[i] / scale;
+      }
+    }
+
+    // The texels furthest apart along the axis are the first endpoints
+    int lowest = 0, highest = 0;
+    float lowestProjection = FLT_MAX, highestProjection = -FLT_MAX;
+    for (int texel = 0; texel < 16; texel++) {
+      float projection = block.channels[0][texel] * axis[0] +
+	block.channels[1][texel] * axis[1] + block.channels[2][texel] * axis[2];
+      if (projection < lowestProjection) {
+	lowestProjection = projection;
+	lowest = texel;
+      }
+      if (projection > highestProjection) {
+	highestProjection = projection;
+	highest = texel;
+      }
+    }
+
+    float end0[3], end1[3];
+    for (int k = 0; k < 3; k++) {
+      end0[k] = block.channels[k][highest];
+      end1[k] = block.channels[k][lowest];
+    }
+    refineEndpoints(block, end0, end1);
+
+    uint16_t color0 = packRgb565(end0);
+    uint16_t color1 = packRgb565(end1);
+    if (color0 < color1) {
+      std::swap(color0, color1);
+    }
+
+    unsigned char indices[16] = {};
+    if (color0 != color1) {
+      int palette[4][3];
+      colorPalette(color0, color1, true, palette);
+
+      float floatPalette[4][3];
+      for (int entry = 0; entry < 4; entry++) {
+	for (int k = 0; k < 3; k++) {
+	  floatPalette[entry][k] = (float)palette[entry][k];
+	}
+      }
+      selectIndices(block, COLOR_CHANNELS, 3, floatPalette, 4, indices);
+    }
+
+    uint32_t bits = 0;
+    for (int texel = 0; texel < 16; texel++) {
+      bits |= (uint32_t)indices[texel] << (texel * 2);
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+      out[4 + i] = (bits >> (i * 8)) & 0xFF;
+    }
+  }
+
+  // BC4 block for one channel, always in eight value mode
+  void encodeSingleChannelBlock(const Block& block, int channel, unsigned char* out) {
+    float minimum = block.channels[channel][0], maximum = minimum;
+    for (int texel = 1; texel < 16; texel++) {
+      minimum = std::min(minimum, block.channels[channel][texel]);
+      maximum = std::max(maximum, block.channels[channel][texel]);
+    }
+
+    int value0 = (int)maximum, value1 = (int)minimum;
+    unsigned char indices[16] = {};
+    if (value0 != value1) {
+      int palette[8];
+      singleChannelPalette(value0, value1, palette);
+
+      float floatPalette[8][3];
+      for (int entry = 0; entry < 8; entry++) {
+	floatPalette[entry][0] = (float)palette[entry];
+      }
+      selectIndices(block, &channel, 1, floatPalette, 8, indices);
+    }
+
+    uint64_t bits = 0;
+    for (int texel = 0; texel < 16; texel++) {
+      bits |= (uint64_t)indices[texel] << (texel * 3);
+    }
+
+    out[0] = (unsigned char)value0;
+    out[1] = (unsigned char)value1;
+    for (int i = 0; i < 6; i++) {
+      out[2 + i] = (bits >> (i * 8)) & 0xFF;
+    }
+  }
+
+  void decodeColorBlock(const unsigned char* in, bool forceFourColors, unsigned char texels[16][4]) {
+    uint16_t color0 = in[0] | (in[1] << 8);
+    uint16_t color1 = in[2] | (in[3] << 8);
+    uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+
+    int palette[4][3];
+    colorPalette(color0, color1, forceFourColors, palette);
+    for (int texel = 0; texel < 16; texel++) {
+      int index = (bits >> (texel * 2)) & 3;
+      for (int k = 0; k < 3; k++) {
+	texels[texel][k] = (unsigned char)palette[index][k];
+      }
+    }
+  }
+
+  void decodeSingleChannelBlock(const unsigned char* in, int channel, unsigned char texels[16][4]) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) {
+      bits |= (uint64_t)in[2 + i] << (i * 8);
+    }
+
+    int palette[8];
+    singleChannelPalette(in[0], in[1], palette);
+    for (int texel = 0; texel < 16; texel++) {
+      texels[texel][channel] = (unsigned char)palette[(bits >> (texel * 3)) & 7];
+    }
+  }
+
+  void compressBlockRows(TextureEncoding encoding, const unsigned char* rgbaPixels,
+			 int width, int height, unsigned char* blocks,
+			 int firstRow, int rowStep) {
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    size_t blockBytes = compressedBlockBytes(encoding);
+
+    Block block;
+    for (int blockY = firstRow; blockY < blocksY; blockY += rowStep) {
+      unsigned char* out = blocks + (size_t)blockY * blocksX * blockBytes;
+      for (int blockX = 0; blockX < blocksX; blockX++, out += blockBytes) {
+	fetchBlock(rgbaPixels, width, height, blockX, blockY, block);
+
+	switch (encoding) {
+	case TextureEncoding::BC1:
+	  encodeColorBlock(block, out);
+	  break;
+	case TextureEncoding::BC3:
+	  encodeSingleChannelBlock(block, 3, out);
+	  encodeColorBlock(block, out + 8);
+	  break;
+	case TextureEncoding::BC4:
+	  encodeSingleChannelBlock(block, 0, out);
+	  break;
+	case TextureEncoding::BC5:
+	  encodeSingleChannelBlock(block, 0, out);
+	  encodeSingleChannelBlock(block, 1, out + 8);
+	  break;
+	default:
+	  break;
+	}
+      }
+    }
+  }
+}
+
+size_t compressedBlockBytes(TextureEncoding encoding) {
+  switch (encoding) {
+  case TextureEncoding::BC1:
+  case TextureEncoding::BC4:
+    return 8;
+  case TextureEncoding::BC3:
+  case TextureEncoding::BC5:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+size_t compressedImageBytes(TextureEncoding encoding, int width, int height) {
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(encoding);
+}
+
+GLenum compressedInternalFormat(TextureEncoding encoding) {
+  switch (encoding) {
+  case TextureEncoding::BC1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case TextureEncoding::BC3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case TextureEncoding::BC4:
+    return GL_COMPRESSED_RED_RGTC1;
+  case TextureEncoding::BC5:
+    return GL_COMPRESSED_RG_RGTC2;
+  default:
+    return GL_RGBA8;
+  }
+}
+
+void compressImage(TextureEncoding encoding, const unsigned char* rgbaPixels,
+		   int width, int height, unsigned char* blocks, unsigned int threadCount) {
+  // Rows are dealt out round robin so every thread gets a similar share
+  int blocksY = (height + 3) / 4;
+  int rowStep = (int)std::max(1u, std::min(threadCount, (unsigned int)blocksY));
+  if (rowStep == 1) {
+    compressBlockRows(encoding, rgbaPixels, width, height, blocks, 0, 1);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  for (int firstRow = 0; firstRow < rowStep; firstRow++) {
+    workers.push_back(std::thread(compressBlockRows, encoding, rgbaPixels, width, height,
+				  blocks, firstRow, rowStep));
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void decompressImage(TextureEncoding encoding, const unsigned char* blocks,
+		     int width, int height, unsigned char* rgbaPixels) {
+  int blocksX = (width + 3) / 4;
+  int blocksY = (height + 3) / 4;
+  size_t blockBytes = compressedBlockBytes(encoding);
+
+  for (int blockY = 0; blockY < blocksY; blockY++) {
+    for (int blockX = 0; blockX < blocksX; blockX++) {
+      const unsigned char* in = blocks + ((size_t)blockY * blocksX + blockX) * blockBytes;
+
+      unsigned char texels[16][4];
+      for (int texel = 0; texel < 16; texel++) {
+	texels[texel][0] = texels[texel][1] = texels[texel][2] = 0;
+	texels[texel][3] = 255;
+      }
+
+      switch (encoding) {
+      case TextureEncoding::BC1:
+	decodeColorBlock(in, false, texels);
+	break;
+      case TextureEncoding::BC3:
+	decodeSingleChannelBlock(in, 3, texels);
+	decodeColorBlock(in + 8, true, texels);
+	break;
+      case TextureEncoding::BC4:
+	decodeSingleChannelBlock(in, 0, texels);
+	break;
+      case TextureEncoding::BC5:
+	decodeSingleChannelBlock(in, 0, texels);
+	decodeSingleChannelBlock(in + 8, 1, texels);
+	break;
+      default:
+	break;
+      }
+
+      // Blocks hanging over the edge only write the texels inside the image
+      for (int y = 0; y < 4 && blockY * 4 + y < height; y++) {
+	for (int x = 0; x < 4 && blockX * 4 + x < width; x++) {
+	  std::memcpy(rgbaPixels + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4,
+		      texels[y * 4 + x], 4);
+	}
+      }
+    }
+  }
+}
+
+double compressionPSNR(TextureEncoding encoding, const unsigned char* original,
+		       const unsigned char* decoded, int width, int height) {
+  int channelCount;
+  switch (encoding) {
+  case TextureEncoding::BC1:
+    channelCount = 3;
+    break;
+  case TextureEncoding::BC4:
+    channelCount = 1;
+    break;
+  case TextureEncoding::BC5:
+    channelCount = 2;
+    break;
+  default:
+    channelCount = 4;
+    break;
+  }
+
+  double squaredError = 0.0;
+  size_t texelCount = (size_t)width * height;
+  for (size_t texel = 0; texel < texelCount; texel++) {
+    for (int channel = 0; channel < channelCount; channel++) {
+      double difference = (double)original[texel * 4 + channel] - decoded[texel * 4 + channel];
+      squaredError += difference * difference;
+    }
+  }
+
+  double meanSquaredError = squaredError / ((double)texelCount * channelCount);
+  if (meanSquaredError == 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// STD
+#include <cstddef>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "Constants.h"
+
+// BC1/BC3/BC4/BC5 block compression for cooked textures.
+//
+// Images are RGBA8 and split into 4x4 blocks, edges repeat the last texel.
+// BC1 and BC3 store colour (BC3 adds alpha), BC4 stores red only, for
+// single channel maps like specular (TextureLoader swizzles it to grey),
+// and BC5 stores red and green, for normal maps whose z lightShader.frag
+// rebuilds.
+
+// Bytes per 4x4 block, 8 for BC1/BC4 and 16 for BC3/BC5
+size_t compressedBlockBytes(TextureEncoding encoding);
+
+// Bytes needed for a whole image of the given size
+size_t compressedImageBytes(TextureEncoding encoding, int width, int height);
+
+// GL internal format to upload the blocks with
+GLenum compressedInternalFormat(TextureEncoding encoding);
+
+// Encodes the image, rows of blocks are spread across threadCount threads
+void compressImage(TextureEncoding encoding, const unsigned char* rgbaPixels,
+		   int width, int height, unsigned char* blocks, unsigned int threadCount);
+
+// Decodes blocks back to RGBA8, channels BC4/BC5 don't store read as 0 (alpha 255)
+void decompressImage(TextureEncoding encoding, const unsigned char* blocks,
+		     int width, int height, unsigned char* rgbaPixels);
+
+// Peak signal to noise ratio in dB over the channels the encoding stores
+double compressionPSNR(TextureEncoding encoding, const unsigned char* original,
+		       const unsigned char* decoded, int width, int height);
@@ -0,0 +1,51 @@
+#include "Bounds.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+
+void computeBounds(const glm::vec3* positions, size_t count, size_t stride,
+		   BoundingBox& box, BoundingSphere& sphere) {
+  box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+  sphere = { glm::vec3(0.0f), 0.0f };
+  if (count == 0) {
+    return;
+  }
+
+  auto position = [positions, stride](size_t i) -> const glm::vec3& {
+    return *(const glm::vec3*)((const char*)positions + i * stride);
+  };
+
+  box.min = box.max = position(0);
+  for (size_t i = 1; i < count; i++) {
+    box.min = glm::min(box.min, position(i));
+    box.max = glm::max(box.max, position(i));
+  }
+
+  sphere.center = (box.min + box.max) * 0.5f;
+  float radiusSquared = 0.0f;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 offset = position(i) - sphere.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  sphere.radius = std::sqrt(radiusSquared);
+}
+
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& transform) {
+  glm::vec3 center = (box.min + box.max) * 0.5f;
+  glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+  glm::vec3 transformedCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+  glm::vec3 transformedExtents(0.0f);
+  for (int column = 0; column < 3; column++) {
+    transformedExtents += glm::abs(glm::vec3(transform[column])) * extents[column];
+  }
+
+  return { transformedCenter - transformedExtents, transformedCenter + transformedExtents };
+}
+
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform) {
+  float scale = std::max(glm::length(glm::vec3(transform[0])),
+			 std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+  return { glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// STD
+#include <cstddef>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Axis aligned box
+struct BoundingBox {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+struct BoundingSphere {
+  glm::vec3 center;
+  float radius;
+};
+
+// Bounds of count positions, stride bytes apart. The sphere is centred on
+// the box and just reaches the farthest position, which is never larger
+// than the box's own circumsphere.
+void computeBounds(const glm::vec3* positions, size_t count, size_t stride,
+		   BoundingBox& box, BoundingSphere& sphere);
+
+// The box of the transformed box (Arvo 1990), so it still encloses the
+// original corners
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& transform);
+
+// Scales the radius by the transform's largest axis scale
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform);
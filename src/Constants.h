@@ -7,3 +7,9 @@ enum class Attribs : GLuint { VERTICES = 0, TEX_COORDS = 1};
 
 enum class TextureType { DIFFUSE, SPECULAR };
 
+
+// How texture levels are stored in cooked files and on the GPU
+enum class TextureEncoding { RGBA8, BC1, BC3, BC4, BC5 };
+
+// How Mesh stores its vertices on the GPU, see VertexLayout.h
+enum class VertexFormat { FLOAT32, PACKED16 };
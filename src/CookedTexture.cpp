@@ -0,0 +1,201 @@
+#include "CookedTexture.h"
+#include "BlockCompression.h"
+
+// STD
+#include <cstring>
+#include <filesystem>
+
+namespace {
+  size_t alignOffset(size_t offset) {
+    return (offset + COOKED_TEXTURE_ALIGNMENT - 1) & ~(size_t)(COOKED_TEXTURE_ALIGNMENT - 1);
+  }
+
+  // The encoding the header describes, false if the loader can't upload it
+  bool headerEncoding(const CookedTextureHeader& header, TextureEncoding& encoding) {
+    if (header.internalFormat == GL_RGBA8) {
+      encoding = TextureEncoding::RGBA8;
+      return header.format == GL_RGBA && header.type == GL_UNSIGNED_BYTE;
+    }
+
+    const TextureEncoding compressed[] = { TextureEncoding::BC1, TextureEncoding::BC3,
+					   TextureEncoding::BC4, TextureEncoding::BC5 };
+    for (TextureEncoding candidate : compressed) {
+      if (header.internalFormat == compressedInternalFormat(candidate)) {
+	encoding = candidate;
+	return header.format == 0 && header.type == 0;
+      }
+    }
+    return false;
+  }
+
+  // 2x2 box filter with rounding. Odd edges reuse the last row or column,
+  // integer maths keeps the output identical on every machine.
+  void downsample(const unsigned char* source, int sourceWidth, int sourceHeight,
+		  unsigned char* destination, int width, int height) {
+    for (int y = 0; y < height; y++) {
+      int y0 = y * 2;
+      int y1 = y0 + 1 < sourceHeight ? y0 + 1 : y0;
+      const unsigned char* row0 = source + (size_t)y0 * sourceWidth * 4;
+      const unsigned char* row1 = source + (size_t)y1 * sourceWidth * 4;
+
+      for (int x = 0; x < width; x++) {
+	int x0 = x * 2 * 4;
+	int x1 = (x * 2 + 1 < sourceWidth ? x * 2 + 1 : x * 2) * 4;
+	unsigned char* pixel = destination + ((size_t)y * width + x) * 4;
+
+	for (int channel = 0; channel < 4; channel++) {
+	  int sum = row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel];
+	  pixel[channel] = (unsigned char)((sum + 2) >> 2);
+	}
+      }
+    }
+  }
+}
+
+bool CookedTexture::open(const std::string& path) {
+  if (!this->mFile.open(path)) {
+    return false;
+  }
+
+  size_t size = this->mFile.size();
+
+  if (size < sizeof(CookedTextureHeader)) {
+    this->mFile.close();
+    return false;
+  }
+
+  const CookedTextureHeader& header = this->header();
+  size_t indexEnd = sizeof(CookedTextureHeader) + (size_t)header.levelCount * sizeof(CookedTextureLevel);
+  if (memcmp(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != COOKED_TEXTURE_VERSION ||
+      header.levelCount == 0 || header.levelCount > 32 ||
+      indexEnd > size) {
+    this->mFile.close();
+    return false;
+  }
+
+  TextureEncoding encoding;
+  if (!headerEncoding(header, encoding) || header.width == 0 || header.height == 0) {
+    this->mFile.close();
+    return false;
+  }
+
+  // Every level has to lie inside the file and hold exactly the bytes GL
+  // reads for it, each half the size of the one above down to 1x1
+  uint32_t width = header.width;
+  uint32_t height = header.height;
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+    const CookedTextureLevel& level = this->level(i);
+    uint64_t levelBytes = encoding == TextureEncoding::RGBA8
+      ? (uint64_t)width * height * 4
+      : compressedImageBytes(encoding, width, height);
+
+    if (level.width != width || level.height != height || level.size != levelBytes ||
+	level.offset < indexEnd || level.offset > size || level.size > size - level.offset ||
+	(i + 1 < header.levelCount && width == 1 && height == 1)) {
+      this->mFile.close();
+      return false;
+    }
+
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+
+  return true;
+}
+
+const CookedTextureHeader& CookedTexture::header() const {
+  return *(const CookedTextureHeader*)this->mFile.data();
+}
+
+const CookedTextureLevel& CookedTexture::level(uint32_t index) const {
+  const CookedTextureLevel* levels = (const CookedTextureLevel*)(this->mFile.data() + sizeof(CookedTextureHeader));
+  return levels[index];
+}
+
+const unsigned char* CookedTexture::levelData(uint32_t index) const {
+  return this->mFile.data() + this->level(index).offset;
+}
+
+size_t CookedTexture::dataSize() const {
+  const CookedTextureLevel& last = this->level(this->header().levelCount - 1);
+  return (size_t)(last.offset + last.size - this->level(0).offset);
+}
+
+std::vector<unsigned char> cookTexture(const unsigned char* rgbaPixels, int width, int height,
+				       TextureEncoding encoding, unsigned int threadCount) {
+  // RGBA mip chain down to 1x1, each level filtered from the one above it
+  std::vector<std::vector<unsigned char>> chain;
+  std::vector<CookedTextureLevel> levels;
+  chain.push_back(std::vector<unsigned char>(rgbaPixels, rgbaPixels + (size_t)width * height * 4));
+  levels.push_back({ 0, 0, (uint32_t)width, (uint32_t)height });
+
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const CookedTextureLevel& above = levels.back();
+    uint32_t levelWidth = above.width > 1 ? above.width / 2 : 1;
+    uint32_t levelHeight = above.height > 1 ? above.height / 2 : 1;
+
+    std::vector<unsigned char> pixels((size_t)levelWidth * levelHeight * 4);
+    downsample(chain.back().data(), above.width, above.height, pixels.data(), levelWidth, levelHeight);
+    chain.push_back(pixels);
+    levels.push_back({ 0, 0, levelWidth, levelHeight });
+  }
+
+  size_t offset = sizeof(CookedTextureHeader) + levels.size() * sizeof(CookedTextureLevel);
+  for (auto& level : levels) {
+    level.size = encoding == TextureEncoding::RGBA8
+      ? (uint64_t)level.width * level.height * 4
+      : compressedImageBytes(encoding, level.width, level.height);
+    offset = alignOffset(offset);
+    level.offset = offset;
+    offset += level.size;
+  }
+
+  // Zero filled so padding bytes are deterministic too
+  std::vector<unsigned char> file(offset, 0);
+
+  CookedTextureHeader header = {};
+  std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic));
+  header.version = COOKED_TEXTURE_VERSION;
+  header.internalFormat = encoding == TextureEncoding::RGBA8 ? GL_RGBA8 : compressedInternalFormat(encoding);
+  // Compressed levels have no pixel format or type
+  header.format = encoding == TextureEncoding::RGBA8 ? GL_RGBA : 0;
+  header.type = encoding == TextureEncoding::RGBA8 ? GL_UNSIGNED_BYTE : 0;
+  header.width = width;
+  header.height = height;
+  header.levelCount = (uint32_t)levels.size();
+
+  std::memcpy(file.data(), &header, sizeof(header));
+  std::memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(CookedTextureLevel));
+
+  for (size_t i = 0; i < levels.size(); i++) {
+    unsigned char* levelData = file.data() + levels[i].offset;
+    if (encoding == TextureEncoding::RGBA8) {
+      std::memcpy(levelData, chain[i].data(), levels[i].size);
+    } else {
+      compressImage(encoding, chain[i].data(), levels[i].width, levels[i].height, levelData, threadCount);
+    }
+  }
+
+  return file;
+}
+
+std::string cookedTexturePath(const std::string& sourcePath) {
+  return std::filesystem::path(sourcePath).replace_extension(COOKED_TEXTURE_EXTENSION).string();
+}
+
+bool isCookedTextureCurrent(const std::string& sourcePath, const std::string& cookedPath) {
+  std::error_code error;
+  auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+  if (error) {
+    return false;
+  }
+
+  // Shipping only the cooked file is fine
+  auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+  if (error) {
+    return true;
+  }
+
+  return cookedTime >= sourceTime;
+}
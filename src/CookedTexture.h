@@ -0,0 +1,81 @@
+#pragma once
+
+// STD
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "Constants.h"
+#include "MappedFile.h"
+
+// Cooked textures are written offline by texcook and mapped straight into
+// memory at load time. Layout:
+//
+//   CookedTextureHeader
+//   CookedTextureLevel[levelCount]   largest level first
+//   level data                       each level starts on a 16 byte boundary
+//
+// Level data is already in the layout GL uploads, so loading needs no
+// decode, no swizzle and no glGenerateMipmap. Compressed levels have a
+// format and type of 0 and go through glCompressedTexImage2D. All fields
+// are little-endian.
+#define COOKED_TEXTURE_MAGIC "GTEXCOOK"
+#define COOKED_TEXTURE_VERSION 1
+#define COOKED_TEXTURE_EXTENSION ".ctex"
+#define COOKED_TEXTURE_ALIGNMENT 16
+
+struct CookedTextureHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t internalFormat; // GL internal format of the texture
+  uint32_t format;         // GL pixel format of the level data
+  uint32_t type;           // GL pixel type of the level data
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t reserved;
+};
+
+struct CookedTextureLevel {
+  uint64_t offset; // From the start of the file
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+// A cooked texture mapped from disk
+class CookedTexture {
+ public:
+  // Maps the file and checks its header and level index
+  bool open(const std::string& path);
+
+  // Pulls the file into memory so the GL thread doesn't wait on the disk
+  void prefault() const { this->mFile.prefault(); }
+
+  const CookedTextureHeader& header() const;
+  const CookedTextureLevel& level(uint32_t index) const;
+  const unsigned char* levelData(uint32_t index) const;
+
+  // Bytes from the start of the first level to the end of the last one
+  size_t dataSize() const;
+
+ private:
+  MappedFile mFile;
+};
+
+// Builds the whole container for a RGBA8 image, mip chain included, with
+// every level stored in the given encoding. Rows go bottom to top, the way
+// FreeImage stores them. The output only depends on the pixels and the
+// encoding, so cooking the same image twice gives the same bytes.
+std::vector<unsigned char> cookTexture(const unsigned char* rgbaPixels, int width, int height,
+				       TextureEncoding encoding = TextureEncoding::RGBA8,
+				       unsigned int threadCount = 1);
+
+// Where the cooked version of a source image lives (same name, .ctex extension)
+std::string cookedTexturePath(const std::string& sourcePath);
+
+// True if the cooked file exists and is not older than its source
+bool isCookedTextureCurrent(const std::string& sourcePath, const std::string& cookedPath);
@@ -3,11 +3,11 @@
 namespace Graphics {
   Cube::Cube() {
     this->m_Model = glm::mat4();
-    this->m_View = glm::mat4();
-    this->m_Projection = glm::mat4();
     
     glGenVertexArrays(1, &this->m_VAO);
     glGenBuffers(1, &this->m_VBO);
+
+    computeBounds((const glm::vec3*)this->m_Vertices, 36, 5 * sizeof(GLfloat), this->m_BoundingBox, this->m_BoundingSphere);
   }
 
   void Cube::setUp(Shader& shader) {
@@ -41,29 +41,22 @@ namespace Graphics {
   }
 
   // Core functionality.
-  // Update the object matrices
-  void Cube::update(Game::World& world) {
-    this->m_View = world.camera.getViewMatrix();
-    this->m_Projection = glm::perspective(world.camera.zoom,
-					  (float)world.screenWidth / (float)world.screenHeight,
-					  0.1f, 100.f);
-  }
-  
   void Cube::render() {
-    // Activate the shader program
-    this->m_Shader.use();
+    this->draw(nullptr);
+  }
 
-    // Set uniform param to the view matrix
-    glUniformMatrix4fv(glGetUniformLocation(this->m_Shader.getProgram(), "view"),
-		       1, GL_FALSE, glm::value_ptr(this->m_View));
+  void Cube::renderInstanced(const InstanceBuffer& instances) {
+    if (instances.size() > 0) {
+      this->draw(&instances);
+    }
+  }
 
-    // Set uniform param to the projection matrix
-    glUniformMatrix4fv(glGetUniformLocation(this->m_Shader.getProgram(), "projection"),
-		       1, GL_FALSE, glm::value_ptr(this->m_Projection));
+  void Cube::draw(const InstanceBuffer* instances) {
+    // Activate the shader program
+    this->m_Shader.use();
 
-    // Set uniform param to the model matrix
-    glUniformMatrix4fv(glGetUniformLocation(this->m_Shader.getProgram(), "model"),
-		       1, GL_FALSE, glm::value_ptr(this->m_Model));
+    // View and projection come from the frame's uniform buffer
+    this->m_Shader.setMat4(UNIFORM("model"), this->m_Model);
 
     // Bind vertex array
     glBindVertexArray(this->m_VAO);
@@ -73,11 +66,24 @@ namespace Graphics {
       glBindTexture(GL_TEXTURE_2D, texture.id);
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    if (instances == nullptr) {
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+    } else {
+      instances->bind();
+      glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances->size());
+      instances->unbind();
+    }
     
     glBindVertexArray(0);
 
     this->m_Shader.unuse();
   }
-}
 
+  BoundingBox Cube::getBoundingBox() {
+    return transformBoundingBox(this->m_BoundingBox, this->m_Model);
+  }
+
+  BoundingSphere Cube::getBoundingSphere() {
+    return transformBoundingSphere(this->m_BoundingSphere, this->m_Model);
+  }
+}
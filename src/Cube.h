@@ -12,10 +12,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "World.h"
 #include "Shader.h"
 #include "Texture.h"
 #include "Constants.h"
+#include "Bounds.h"
+#include "InstanceBuffer.h"
 
 namespace Graphics {
   class Cube {
@@ -31,17 +32,29 @@ namespace Graphics {
     void rotate(glm::vec3 rotateDirection, float angle);
     void translate(glm::vec3 translateVector);
 
-    // Core functionality
-    void update(Game::World& world);
+    // Core functionality. The camera comes from FrameUniforms, updated
+    // once per frame for every object.
     void render();
+    // One draw call for every instance, the cube has to be set up with
+    // shaders/advancedInstanced.*. Each instance's matrix applies on top
+    // of the model matrix.
+    void renderInstanced(const InstanceBuffer& instances);
+
+    // World space bounds, following the model matrix
+    BoundingBox getBoundingBox();
+    BoundingSphere getBoundingSphere();
     
   private:
     Shader m_Shader;
     glm::mat4 m_Model;
-    glm::mat4 m_View;
-    glm::mat4 m_Projection;
     GLuint m_VAO, m_VBO;
     std::vector<Texture> m_Textures;
+    // Of the vertices, in model space
+    BoundingBox m_BoundingBox;
+    BoundingSphere m_BoundingSphere;
+
+    // Renders once, or once per instance
+    void draw(const InstanceBuffer* instances);
     GLfloat m_Vertices[36 * 5] = {
       // Positions          // Texture Coords
       -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -0,0 +1,33 @@
+#include "FrameData.h"
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+FrameUniforms::FrameUniforms() : mBuffer(0), mData() {
+  glGenBuffers(1, &this->mBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, this->mBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  // Stays bound, programs find it through their block binding
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, this->mBuffer);
+}
+
+FrameUniforms::~FrameUniforms() {
+  glDeleteBuffers(1, &this->mBuffer);
+}
+
+void FrameUniforms::update(Game::World& world, float time) {
+  this->mData.view = world.camera.getViewMatrix();
+  this->mData.projection = glm::perspective(world.camera.zoom,
+					    (float)world.screenWidth / (float)world.screenHeight,
+					    FRAME_NEAR_PLANE, FRAME_FAR_PLANE);
+  this->mData.viewProjection = this->mData.projection * this->mData.view;
+  this->mData.cameraPosition = glm::vec4(world.camera.position, 1.0f);
+  this->mData.time = time;
+
+  // Orphans last frame's copy, draws still reading it don't stall the upload
+  glBindBuffer(GL_UNIFORM_BUFFER, this->mBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &this->mData, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "World.h"
+
+// Uniform block binding point of FrameData, the same in every program.
+// GLSL 330 has no layout(binding), so Shader sets it after linking.
+#define FRAME_DATA_BINDING 0
+#define FRAME_DATA_BLOCK "FrameData"
+
+// Camera near and far planes
+#define FRAME_NEAR_PLANE 0.1f
+#define FRAME_FAR_PLANE 100.0f
+
+// What every draw of a frame shares, laid out like the std140 FrameData
+// block in shaders/frameData.glsl
+struct FrameData {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 viewProjection;
+  glm::vec4 cameraPosition; // w is 1
+  float time;               // Seconds since the start
+  float padding[3];         // std140 rounds the block up to 16 bytes
+};
+
+static_assert(sizeof(FrameData) == 224, "FrameData has to match the std140 block");
+
+// The uniform buffer FrameData lives in, bound at FRAME_DATA_BINDING
+class FrameUniforms {
+ public:
+  FrameUniforms();
+  ~FrameUniforms();
+
+  FrameUniforms(const FrameUniforms&) = delete;
+  FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+  // Works the matrices out from the world's camera and uploads them.
+  // Call it once per frame, before the first draw.
+  void update(Game::World& world, float time);
+
+  const FrameData& data() const { return this->mData; }
+
+ private:
+  GLuint mBuffer;
+  FrameData mData;
+};
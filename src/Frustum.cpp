@@ -0,0 +1,155 @@
+#include "Frustum.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_SIMD_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SIMD_WIDTH 4
+#else
+#define FRUSTUM_SIMD_WIDTH 1
+#endif
+
+void BoundingSphereList::clear() {
+  this->mX.clear();
+  this->mY.clear();
+  this->mZ.clear();
+  this->mRadius.clear();
+  this->mCount = 0;
+}
+
+void BoundingSphereList::add(const BoundingSphere& sphere) {
+  // Grow a whole register at a time, the padding is never reported
+  if (this->mCount == this->mX.size()) {
+    size_t size = this->mCount + FRUSTUM_SIMD_WIDTH;
+    this->mX.resize(size, 0.0f);
+    this->mY.resize(size, 0.0f);
+    this->mZ.resize(size, 0.0f);
+    this->mRadius.resize(size, 0.0f);
+  }
+
+  this->set(this->mCount++, sphere);
+}
+
+void BoundingSphereList::set(size_t index, const BoundingSphere& sphere) {
+  this->mX[index] = sphere.center.x;
+  this->mY[index] = sphere.center.y;
+  this->mZ[index] = sphere.center.z;
+  this->mRadius[index] = sphere.radius;
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+  // Rows of the matrix, glm stores columns
+  glm::vec4 rows[4];
+  for (int row = 0; row < 4; row++) {
+    rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+  }
+
+  // Left, right, bottom, top, near, far
+  for (int axis = 0; axis < 3; axis++) {
+    this->mPlanes[axis * 2 + 0] = rows[3] + rows[axis];
+    this->mPlanes[axis * 2 + 1] = rows[3] - rows[axis];
+  }
+
+  // Unit normals, so the plane equation gives distances
+  for (auto& plane : this->mPlanes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+  for (auto& plane : this->mPlanes) {
+    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+  glm::vec3 center = (box.min + box.max) * 0.5f;
+  glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+  for (auto& plane : this->mPlanes) {
+    glm::vec3 normal(plane);
+    // How far the box reaches towards the plane's inside from its center
+    float reach = glm::dot(glm::abs(normal), extents);
+    if (glm::dot(normal, center) + plane.w < -reach) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CullStats Frustum::cull(const BoundingSphereList& spheres, std::vector<GLuint>& visible) const {
+  size_t count = spheres.size();
+  size_t before = visible.size();
+
+#if FRUSTUM_SIMD_WIDTH == 8
+  __m256 planes[6][4];
+  for (int plane = 0; plane < 6; plane++) {
+    for (int component = 0; component < 4; component++) {
+      planes[plane][component] = _mm256_set1_ps(this->mPlanes[plane][component]);
+    }
+  }
+
+  for (size_t i = 0; i < count; i += 8) {
+    __m256 x = _mm256_loadu_ps(&spheres.mX[i]);
+    __m256 y = _mm256_loadu_ps(&spheres.mY[i]);
+    __m256 z = _mm256_loadu_ps(&spheres.mZ[i]);
+    __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.mRadius[i]));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int plane = 0; plane < 6; plane++) {
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[plane][0], x), _mm256_mul_ps(planes[plane][1], y)),
+				      _mm256_add_ps(_mm256_mul_ps(planes[plane][2], z), planes[plane][3]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (size_t lane = 0; mask != 0; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) {
+	visible.push_back((GLuint)(i + lane));
+      }
+    }
+  }
+#elif FRUSTUM_SIMD_WIDTH == 4
+  __m128 planes[6][4];
+  for (int plane = 0; plane < 6; plane++) {
+    for (int component = 0; component < 4; component++) {
+      planes[plane][component] = _mm_set1_ps(this->mPlanes[plane][component]);
+    }
+  }
+
+  for (size_t i = 0; i < count; i += 4) {
+    __m128 x = _mm_loadu_ps(&spheres.mX[i]);
+    __m128 y = _mm_loadu_ps(&spheres.mY[i]);
+    __m128 z = _mm_loadu_ps(&spheres.mZ[i]);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.mRadius[i]));
+
+    __m128 inside = _mm_cmpeq_ps(x, x);
+    for (int plane = 0; plane < 6; plane++) {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[plane][0], x), _mm_mul_ps(planes[plane][1], y)),
+				   _mm_add_ps(_mm_mul_ps(planes[plane][2], z), planes[plane][3]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (size_t lane = 0; mask != 0; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) {
+	visible.push_back((GLuint)(i + lane));
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    BoundingSphere sphere = { glm::vec3(spheres.mX[i], spheres.mY[i], spheres.mZ[i]), spheres.mRadius[i] };
+    if (this->intersects(sphere)) {
+      visible.push_back((GLuint)i);
+    }
+  }
+#endif
+
+  size_t visibleCount = visible.size() - before;
+  return { visibleCount, count - visibleCount };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// STD
+#include <vector>
+#include <cstddef>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// How many bounds a frustum test kept and dropped
+struct CullStats {
+  size_t visible;
+  size_t culled;
+};
+
+// Bounding spheres stored as separate x, y, z and radius arrays, so the
+// frustum can test several per instruction. The arrays are padded to a
+// whole number of SIMD registers.
+class BoundingSphereList {
+ public:
+  BoundingSphereList() : mCount(0) {}
+
+  void clear();
+  void add(const BoundingSphere& sphere);
+  // For objects that moved
+  void set(size_t index, const BoundingSphere& sphere);
+
+  inline size_t size() const { return this->mCount; }
+
+ private:
+  friend class Frustum;
+
+  std::vector<float> mX, mY, mZ, mRadius;
+  size_t mCount;
+};
+
+// The six planes of a view frustum, normalized and facing inward
+class Frustum {
+ public:
+  // Extracts the planes from the combined matrix (Gribb and Hartmann), in
+  // the space the matrix transforms from: a projection * view matrix gives
+  // world space planes
+  explicit Frustum(const glm::mat4& viewProjection);
+
+  // Conservative, bounds near a frustum corner may pass while outside it
+  bool intersects(const BoundingSphere& sphere) const;
+  bool intersects(const BoundingBox& box) const;
+
+  // Appends the indices of the spheres that intersect the frustum to
+  // visible, in order. Tests 8 spheres at a time with AVX, 4 with SSE.
+  CullStats cull(const BoundingSphereList& spheres, std::vector<GLuint>& visible) const;
+
+ private:
+  glm::vec4 mPlanes[6];
+};
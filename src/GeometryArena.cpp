@@ -0,0 +1,140 @@
+#include "GeometryArena.h"
+#include "VertexLayout.h"
+
+// STD
+#include <cstdint>
+
+GeometryArena::GeometryArena() : mPools(), mGrowths(0) {
+}
+
+GeometryArena::~GeometryArena() {
+  for (Pool& pool : this->mPools) {
+    if (pool.vertexArray != 0) {
+      glDeleteVertexArrays(1, &pool.vertexArray);
+      glDeleteBuffers(1, &pool.vertexBuffer);
+      glDeleteBuffers(1, &pool.indexBuffer);
+    }
+  }
+}
+
+GeometryArena::Allocation GeometryArena::allocate(VertexFormat format, const GLvoid* vertices, GLsizei vertexCount,
+						  const GLvoid* indices, size_t indexBytes) {
+  Pool& pool = this->mPools[(int)format];
+  if (pool.vertexArray == 0) {
+    this->createPool(pool, format);
+  }
+
+  // Vertices stay on whole strides so base vertex can address them,
+  // indices on 4 bytes so 16 and 32 bit ones can share the buffer
+  size_t stride = vertexLayout(format).stride;
+  size_t vertexBytes = (size_t)vertexCount * stride;
+  size_t indexOffset = (pool.indexUsed + 3) & ~(size_t)3;
+
+  size_t vertexCapacity = pool.vertexCapacity;
+  while (pool.vertexUsed + vertexBytes > vertexCapacity) {
+    vertexCapacity *= 2;
+  }
+  size_t indexCapacity = pool.indexCapacity;
+  while (indexOffset + indexBytes > indexCapacity) {
+    indexCapacity *= 2;
+  }
+
+  glBindVertexArray(0);
+
+  if (vertexCapacity != pool.vertexCapacity || indexCapacity != pool.indexCapacity) {
+    if (vertexCapacity != pool.vertexCapacity) {
+      pool.vertexBuffer = this->growBuffer(pool.vertexBuffer, pool.vertexUsed, vertexCapacity);
+      pool.vertexCapacity = vertexCapacity;
+    }
+    if (indexCapacity != pool.indexCapacity) {
+      pool.indexBuffer = this->growBuffer(pool.indexBuffer, pool.indexUsed, indexCapacity);
+      pool.indexCapacity = indexCapacity;
+    }
+    this->setupAttributes(pool, format);
+  }
+
+  Allocation allocation = { (GLint)(pool.vertexUsed / stride), indexOffset };
+
+  glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+  glBufferSubData(GL_ARRAY_BUFFER, pool.vertexUsed, vertexBytes, vertices);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  pool.vertexUsed += vertexBytes;
+
+  // Not through GL_ELEMENT_ARRAY_BUFFER, that would change the bound VAO
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool.indexBuffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  pool.indexUsed = indexOffset + indexBytes;
+
+  return allocation;
+}
+
+GLuint GeometryArena::vertexArray(VertexFormat format) const {
+  return this->mPools[(int)format].vertexArray;
+}
+
+GeometryArena::Stats GeometryArena::stats() const {
+  Stats stats = { 0, 0, 0, this->mGrowths };
+  for (const Pool& pool : this->mPools) {
+    stats.vertexBytes += pool.vertexUsed;
+    stats.indexBytes += pool.indexUsed;
+    stats.capacityBytes += pool.vertexCapacity + pool.indexCapacity;
+  }
+  return stats;
+}
+
+void GeometryArena::createPool(Pool& pool, VertexFormat format) {
+  pool.vertexCapacity = GEOMETRY_ARENA_INITIAL_BYTES;
+  pool.indexCapacity = GEOMETRY_ARENA_INITIAL_BYTES;
+  pool.vertexUsed = 0;
+  pool.indexUsed = 0;
+
+  glGenVertexArrays(1, &pool.vertexArray);
+  glGenBuffers(1, &pool.vertexBuffer);
+  glGenBuffers(1, &pool.indexBuffer);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, pool.vertexCapacity, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool.indexBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, pool.indexCapacity, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  this->setupAttributes(pool, format);
+}
+
+GLuint GeometryArena::growBuffer(GLuint buffer, size_t used, size_t capacity) {
+  GLuint grown;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+
+  if (used > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glDeleteBuffers(1, &buffer);
+  this->mGrowths++;
+  return grown;
+}
+
+void GeometryArena::setupAttributes(Pool& pool, VertexFormat format) {
+  const VertexLayout& layout = vertexLayout(format);
+
+  glBindVertexArray(pool.vertexArray);
+  glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+
+  for (auto& attribute : layout.attributes) {
+    glEnableVertexAttribArray(attribute.index);
+    glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized,
+			  layout.stride, (GLvoid *)(uintptr_t)attribute.offset);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// STD
+#include <cstddef>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "Constants.h"
+
+// Initial size of each arena buffer, they double whenever they run out
+#define GEOMETRY_ARENA_INITIAL_BYTES (1024 * 1024)
+
+// Shared vertex and index buffers for many meshes, one set and one VAO
+// per vertex format. Meshes suballocate from them and draw with
+// glDrawElementsBaseVertex, so drawing any number of meshes of one format
+// needs a single VAO bind.
+//
+// Growing a buffer copies it on the GPU into a larger one. Offsets stay
+// valid, only the buffer names change. Only use it from the thread that
+// owns the GL context.
+class GeometryArena {
+ public:
+  // Where a mesh's data ended up
+  struct Allocation {
+    GLint baseVertex;    // Added to every index of the mesh
+    size_t indexOffset;  // In bytes, the indices pointer to draw with
+  };
+
+  struct Stats {
+    size_t vertexBytes;   // In use, all formats
+    size_t indexBytes;
+    size_t capacityBytes; // Allocated on the GPU
+    size_t growths;       // Buffers reallocated to make room
+  };
+
+  GeometryArena();
+  ~GeometryArena();
+
+  GeometryArena(const GeometryArena&) = delete;
+  GeometryArena& operator=(const GeometryArena&) = delete;
+
+  // Copies the vertices (already in the format's layout) and the indices in
+  Allocation allocate(VertexFormat format, const GLvoid* vertices, GLsizei vertexCount,
+		      const GLvoid* indices, size_t indexBytes);
+
+  // The VAO all meshes of the format draw with
+  GLuint vertexArray(VertexFormat format) const;
+
+  Stats stats() const;
+
+ private:
+  struct Pool {
+    GLuint vertexArray;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    size_t vertexCapacity; // Bytes
+    size_t vertexUsed;
+    size_t indexCapacity;
+    size_t indexUsed;
+  };
+
+  Pool mPools[2]; // Indexed by VertexFormat
+  size_t mGrowths;
+
+  void createPool(Pool& pool, VertexFormat format);
+  // Replaces the buffer with a larger one holding the same first used bytes
+  GLuint growBuffer(GLuint buffer, size_t used, size_t capacity);
+  void setupAttributes(Pool& pool, VertexFormat format);
+};
@@ -0,0 +1,61 @@
+#include "InstanceBuffer.h"
+
+// STD
+#include <algorithm>
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer() : mBuffer(0), mCount(0), mCapacity(INSTANCE_BUFFER_INITIAL_CAPACITY) {
+  glGenBuffers(1, &this->mBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, this->mBuffer);
+  glBufferData(GL_ARRAY_BUFFER, this->mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+  glDeleteBuffers(1, &this->mBuffer);
+}
+
+void InstanceBuffer::update(const InstanceData* instances, GLsizei count) {
+  if (count > this->mCapacity) {
+    this->mCapacity = std::max(count, this->mCapacity * 2);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, this->mBuffer);
+  glBufferData(GL_ARRAY_BUFFER, this->mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+  if (count > 0) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  this->mCount = count;
+}
+
+void InstanceBuffer::update(const std::vector<InstanceData>& instances) {
+  this->update(instances.data(), (GLsizei)instances.size());
+}
+
+void InstanceBuffer::bind() const {
+  glBindBuffer(GL_ARRAY_BUFFER, this->mBuffer);
+
+  for (GLuint column = 0; column < 4; column++) {
+    GLuint index = INSTANCE_MODEL_ATTRIB_INDEX + column;
+    glEnableVertexAttribArray(index);
+    glVertexAttribPointer(index, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			  (GLvoid *)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(index, 1);
+  }
+
+  glEnableVertexAttribArray(INSTANCE_TINT_ATTRIB_INDEX);
+  glVertexAttribPointer(INSTANCE_TINT_ATTRIB_INDEX, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(GLvoid *)offsetof(InstanceData, tint));
+  glVertexAttribDivisor(INSTANCE_TINT_ATTRIB_INDEX, 1);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::unbind() const {
+  for (GLuint column = 0; column < 4; column++) {
+    glDisableVertexAttribArray(INSTANCE_MODEL_ATTRIB_INDEX + column);
+  }
+  glDisableVertexAttribArray(INSTANCE_TINT_ATTRIB_INDEX);
+}
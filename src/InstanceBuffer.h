@@ -0,0 +1,52 @@
+#pragma once
+
+// STD
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Per-instance attributes of the instanced shaders. The model matrix
+// takes four locations, one per column.
+#define INSTANCE_MODEL_ATTRIB_INDEX 6
+#define INSTANCE_TINT_ATTRIB_INDEX 10
+
+// Instances the buffer has room for before the first update
+#define INSTANCE_BUFFER_INITIAL_CAPACITY 256
+
+struct InstanceData {
+  glm::mat4 model;
+  glm::vec4 tint; // Multiplies the colour, white leaves it as is
+};
+
+// A stream of per-instance model matrices and tints for instanced draws.
+// The data goes to the GPU as vertex attributes with divisor 1, which a
+// 3.3 context has, rather than a storage buffer, which it has not.
+class InstanceBuffer {
+ public:
+  InstanceBuffer();
+  ~InstanceBuffer();
+
+  InstanceBuffer(const InstanceBuffer&) = delete;
+  InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+  // Replaces the instances. The storage is orphaned rather than
+  // overwritten, so draws still reading the old data never stall it.
+  void update(const InstanceData* instances, GLsizei count);
+  void update(const std::vector<InstanceData>& instances);
+
+  inline GLsizei size() const { return this->mCount; }
+
+  // Points the instance attributes of the bound VAO at the buffer, and
+  // disables them again
+  void bind() const;
+  void unbind() const;
+
+ private:
+  GLuint mBuffer;
+  GLsizei mCount;
+  GLsizei mCapacity;
+};
@@ -1,10 +1,20 @@
+#pragma once
+
 // GLM
 #include <glm/glm.hpp>
 
+enum class LightType { POINT, SPOT };
+
+// A point light or spotlight, as LightGrid bins it
 struct Light {
   glm::vec3 color;
   float constant;
   float linear;
   float quadratic;
-};
 
+  LightType type;
+  glm::vec3 position;
+  glm::vec3 direction; // Spotlights only
+  float cutOff;        // Cosines of the inner and outer cone angles
+  float outerCutOff;
+};
@@ -0,0 +1,395 @@
+#include "LightGrid.h"
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LIGHT_GRID_SIMD_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#define LIGHT_GRID_SIMD_WIDTH 4
+#else
+#define LIGHT_GRID_SIMD_WIDTH 1
+#endif
+
+namespace {
+  // Tile of a normalized device coordinate, clamped to the grid
+  inline int tileOf(float ndc, int tiles) {
+    float tile = (ndc * 0.5f + 0.5f) * (float)tiles;
+    return (int)std::min(std::max(tile, 0.0f), (float)(tiles - 1));
+  }
+
+  inline int sliceOf(float depth, float scale, float bias) {
+    float slice = std::floor(std::log(depth) * scale + bias);
+    return (int)std::min(std::max(slice, 0.0f), (float)(LIGHT_GRID_Z - 1));
+  }
+
+  // Creates a texture buffer over a new buffer object
+  void createTextureBuffer(GLenum format, GLuint& buffer, GLuint& texture) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  }
+
+  // Orphans the buffer's old contents, draws still reading them don't stall
+  void uploadTextureBuffer(GLuint buffer, const void* data, size_t size) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // Empty buffers can't back a texture, keep a few bytes
+    glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+    if (size > 0) {
+      glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  }
+}
+
+float lightRange(const Light& light) {
+  float brightest = std::max(light.color.r, std::max(light.color.g, light.color.b));
+  // Solves brightest / (constant + linear * d + quadratic * d^2) = cutoff
+  float c = light.constant - brightest / LIGHT_CUTOFF_INTENSITY;
+  if (c >= 0.0f) {
+    return 0.0f;
+  }
+  if (light.quadratic > 0.0f) {
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+  }
+  if (light.linear > 0.0f) {
+    return -c / light.linear;
+  }
+  // No falloff, reaches everything the camera sees
+  return FRAME_FAR_PLANE;
+}
+
+LightGrid::LightGrid() : mRecordBuffer(0), mCellBuffer(0), mIndexBuffer(0), mClusterBuffer(0),
+			 mRecordTexture(0), mCellTexture(0), mIndexTexture(0),
+			 mCells(LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z * 2, 0),
+			 mCursor(LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z, 0),
+			 mStats({ 0, 0, 0, 0, 0.0 }) {
+  createTextureBuffer(GL_RGBA32F, this->mRecordBuffer, this->mRecordTexture);
+  createTextureBuffer(GL_RG32UI, this->mCellBuffer, this->mCellTexture);
+  createTextureBuffer(GL_R32UI, this->mIndexBuffer, this->mIndexTexture);
+
+  glGenBuffers(1, &this->mClusterBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, this->mClusterBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterData), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_DATA_BINDING, this->mClusterBuffer);
+}
+
+LightGrid::~LightGrid() {
+  GLuint buffers[] = { this->mRecordBuffer, this->mCellBuffer, this->mIndexBuffer, this->mClusterBuffer };
+  GLuint textures[] = { this->mRecordTexture, this->mCellTexture, this->mIndexTexture };
+  glDeleteBuffers(4, buffers);
+  glDeleteTextures(3, textures);
+}
+
+void LightGrid::update(const std::vector<Light>& lights, const FrameData& frame, int screenWidth, int screenHeight) {
+  auto start = std::chrono::steady_clock::now();
+  size_t count = lights.size();
+
+  // Spheres and records, the arrays padded to a whole register
+  size_t padded = (count + LIGHT_GRID_SIMD_WIDTH - 1) / LIGHT_GRID_SIMD_WIDTH * LIGHT_GRID_SIMD_WIDTH;
+  this->mX.assign(padded, 0.0f);
+  this->mY.assign(padded, 0.0f);
+  this->mZ.assign(padded, 0.0f);
+  this->mRadius.assign(padded, 0.0f);
+  this->mRecords.resize(count * LIGHT_RECORD_TEXELS);
+
+  for (size_t i = 0; i < count; i++) {
+    const Light& light = lights[i];
+    float range = lightRange(light);
+    this->mX[i] = light.position.x;
+    this->mY[i] = light.position.y;
+    this->mZ[i] = light.position.z;
+    this->mRadius[i] = range;
+
+    glm::vec4* record = &this->mRecords[i * LIGHT_RECORD_TEXELS];
+    record[0] = glm::vec4(light.position, range);
+    record[1] = glm::vec4(light.color, light.type == LightType::SPOT ? 1.0f : 0.0f);
+    record[2] = glm::vec4(light.direction, light.cutOff);
+    record[3] = glm::vec4(light.constant, light.linear, light.quadratic, light.outerCutOff);
+  }
+
+  this->projectLights(frame, padded);
+
+  // Depth slices are spaced evenly in log(depth)
+  float sliceScale = (float)LIGHT_GRID_Z / std::log(FRAME_FAR_PLANE / FRAME_NEAR_PLANE);
+  float sliceBias = -sliceScale * std::log(FRAME_NEAR_PLANE);
+
+  // Counts the lights of every cluster, then turns the counts into offsets
+  std::fill(this->mCursor.begin(), this->mCursor.end(), 0);
+  size_t visible = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!this->mVisible[i]) {
+      continue;
+    }
+    visible++;
+
+    int minZ = sliceOf(this->mNearDepth[i], sliceScale, sliceBias);
+    int maxZ = sliceOf(this->mFarDepth[i], sliceScale, sliceBias);
+    for (int z = minZ; z <= maxZ; z++) {
+      for (int y = this->mMinY[i]; y <= this->mMaxY[i]; y++) {
+	GLuint* row = &this->mCursor[(z * LIGHT_GRID_Y + y) * LIGHT_GRID_X];
+	for (int x = this->mMinX[i]; x <= this->mMaxX[i]; x++) {
+	  row[x]++;
+	}
+      }
+    }
+  }
+
+  GLuint offset = 0;
+  size_t maxPerCluster = 0;
+  for (size_t cell = 0; cell < this->mCursor.size(); cell++) {
+    GLuint cellCount = this->mCursor[cell];
+    this->mCells[cell * 2 + 0] = offset;
+    this->mCells[cell * 2 + 1] = cellCount;
+    this->mCursor[cell] = offset;
+    offset += cellCount;
+    maxPerCluster = std::max(maxPerCluster, (size_t)cellCount);
+  }
+
+  this->mIndices.resize(offset);
+  for (size_t i = 0; i < count; i++) {
+    if (!this->mVisible[i]) {
+      continue;
+    }
+
+    int minZ = sliceOf(this->mNearDepth[i], sliceScale, sliceBias);
+    int maxZ = sliceOf(this->mFarDepth[i], sliceScale, sliceBias);
+    for (int z = minZ; z <= maxZ; z++) {
+      for (int y = this->mMinY[i]; y <= this->mMaxY[i]; y++) {
+	GLuint* row = &this->mCursor[(z * LIGHT_GRID_Y + y) * LIGHT_GRID_X];
+	for (int x = this->mMinX[i]; x <= this->mMaxX[i]; x++) {
+	  this->mIndices[row[x]++] = (GLuint)i;
+	}
+      }
+    }
+  }
+
+  this->mStats = { count, visible, this->mIndices.size(), maxPerCluster,
+		   std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+  uploadTextureBuffer(this->mRecordBuffer, this->mRecords.data(), this->mRecords.size() * sizeof(glm::vec4));
+  uploadTextureBuffer(this->mCellBuffer, this->mCells.data(), this->mCells.size() * sizeof(GLuint));
+  uploadTextureBuffer(this->mIndexBuffer, this->mIndices.data(), this->mIndices.size() * sizeof(GLuint));
+
+  ClusterData cluster;
+  cluster.grid = glm::uvec4(LIGHT_GRID_X, LIGHT_GRID_Y, LIGHT_GRID_Z, (GLuint)count);
+  cluster.scale = glm::vec4((float)LIGHT_GRID_X / (float)screenWidth, (float)LIGHT_GRID_Y / (float)screenHeight,
+			    sliceScale, sliceBias);
+  glBindBuffer(GL_UNIFORM_BUFFER, this->mClusterBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterData), &cluster, GL_STREAM_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void LightGrid::bind(Shader& shader) {
+  glActiveTexture(GL_TEXTURE0 + LIGHT_RECORDS_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_BUFFER, this->mRecordTexture);
+  glActiveTexture(GL_TEXTURE0 + LIGHT_CELLS_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_BUFFER, this->mCellTexture);
+  glActiveTexture(GL_TEXTURE0 + LIGHT_INDICES_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_BUFFER, this->mIndexTexture);
+  glActiveTexture(GL_TEXTURE0);
+
+  shader.setInt(UNIFORM("lightRecords"), LIGHT_RECORDS_TEXTURE_UNIT);
+  shader.setInt(UNIFORM("lightCells"), LIGHT_CELLS_TEXTURE_UNIT);
+  shader.setInt(UNIFORM("lightIndices"), LIGHT_INDICES_TEXTURE_UNIT);
+}
+
+void LightGrid::projectLights(const FrameData& frame, size_t count) {
+  this->mMinX.resize(count);
+  this->mMaxX.resize(count);
+  this->mMinY.resize(count);
+  this->mMaxY.resize(count);
+  this->mNearDepth.resize(count);
+  this->mFarDepth.resize(count);
+  this->mVisible.resize(count);
+
+  // The rows of the view matrix that give view x, y and depth (-z)
+  const glm::mat4& view = frame.view;
+  float rowX[4] = { view[0][0], view[1][0], view[2][0], view[3][0] };
+  float rowY[4] = { view[0][1], view[1][1], view[2][1], view[3][1] };
+  float rowDepth[4] = { -view[0][2], -view[1][2], -view[2][2], -view[3][2] };
+  float projectionX = frame.projection[0][0];
+  float projectionY = frame.projection[1][1];
+
+  // The bounds of a sphere's box, projected: the smallest x is at the far
+  // end of the box when that x is positive and the near end otherwise,
+  // the largest the other way round
+#if LIGHT_GRID_SIMD_WIDTH == 8
+  __m256 vRowX[4], vRowY[4], vRowDepth[4];
+  for (int i = 0; i < 4; i++) {
+    vRowX[i] = _mm256_set1_ps(rowX[i]);
+    vRowY[i] = _mm256_set1_ps(rowY[i]);
+    vRowDepth[i] = _mm256_set1_ps(rowDepth[i]);
+  }
+  __m256 nearPlane = _mm256_set1_ps(FRAME_NEAR_PLANE);
+  __m256 farPlane = _mm256_set1_ps(FRAME_FAR_PLANE);
+  __m256 zero = _mm256_setzero_ps();
+  __m256 centerX = _mm256_set1_ps(0.5f * LIGHT_GRID_X);
+  __m256 centerY = _mm256_set1_ps(0.5f * LIGHT_GRID_Y);
+  __m256 scaleX = _mm256_set1_ps(projectionX * 0.5f * LIGHT_GRID_X);
+  __m256 scaleY = _mm256_set1_ps(projectionY * 0.5f * LIGHT_GRID_Y);
+  __m256 tilesX = _mm256_set1_ps((float)LIGHT_GRID_X);
+  __m256 tilesY = _mm256_set1_ps((float)LIGHT_GRID_Y);
+  __m256 lastX = _mm256_set1_ps((float)(LIGHT_GRID_X - 1));
+  __m256 lastY = _mm256_set1_ps((float)(LIGHT_GRID_Y - 1));
+
+  for (size_t i = 0; i < count; i += 8) {
+    __m256 x = _mm256_loadu_ps(&this->mX[i]);
+    __m256 y = _mm256_loadu_ps(&this->mY[i]);
+    __m256 z = _mm256_loadu_ps(&this->mZ[i]);
+    __m256 radius = _mm256_loadu_ps(&this->mRadius[i]);
+
+    __m256 viewX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vRowX[0], x), _mm256_mul_ps(vRowX[1], y)),
+				 _mm256_add_ps(_mm256_mul_ps(vRowX[2], z), vRowX[3]));
+    __m256 viewY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vRowY[0], x), _mm256_mul_ps(vRowY[1], y)),
+				 _mm256_add_ps(_mm256_mul_ps(vRowY[2], z), vRowY[3]));
+    __m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vRowDepth[0], x), _mm256_mul_ps(vRowDepth[1], y)),
+				 _mm256_add_ps(_mm256_mul_ps(vRowDepth[2], z), vRowDepth[3]));
+
+    __m256 nearDepth = _mm256_max_ps(_mm256_sub_ps(depth, radius), nearPlane);
+    __m256 farDepth = _mm256_min_ps(_mm256_add_ps(depth, radius), farPlane);
+    __m256 visible = _mm256_and_ps(_mm256_cmp_ps(radius, zero, _CMP_GT_OQ),
+				   _mm256_cmp_ps(nearDepth, farDepth, _CMP_LE_OQ));
+
+    __m256 low = _mm256_sub_ps(viewX, radius);
+    __m256 high = _mm256_add_ps(viewX, radius);
+    __m256 minX = _mm256_div_ps(low, _mm256_blendv_ps(nearDepth, farDepth, _mm256_cmp_ps(low, zero, _CMP_GE_OQ)));
+    __m256 maxX = _mm256_div_ps(high, _mm256_blendv_ps(farDepth, nearDepth, _mm256_cmp_ps(high, zero, _CMP_GE_OQ)));
+    low = _mm256_sub_ps(viewY, radius);
+    high = _mm256_add_ps(viewY, radius);
+    __m256 minY = _mm256_div_ps(low, _mm256_blendv_ps(nearDepth, farDepth, _mm256_cmp_ps(low, zero, _CMP_GE_OQ)));
+    __m256 maxY = _mm256_div_ps(high, _mm256_blendv_ps(farDepth, nearDepth, _mm256_cmp_ps(high, zero, _CMP_GE_OQ)));
+
+    // Tiles, (ndc * 0.5 + 0.5) * tiles with the projection folded in
+    minX = _mm256_add_ps(_mm256_mul_ps(minX, scaleX), centerX);
+    maxX = _mm256_add_ps(_mm256_mul_ps(maxX, scaleX), centerX);
+    minY = _mm256_add_ps(_mm256_mul_ps(minY, scaleY), centerY);
+    maxY = _mm256_add_ps(_mm256_mul_ps(maxY, scaleY), centerY);
+    visible = _mm256_and_ps(visible, _mm256_and_ps(_mm256_cmp_ps(maxX, zero, _CMP_GE_OQ), _mm256_cmp_ps(minX, tilesX, _CMP_LT_OQ)));
+    visible = _mm256_and_ps(visible, _mm256_and_ps(_mm256_cmp_ps(maxY, zero, _CMP_GE_OQ), _mm256_cmp_ps(minY, tilesY, _CMP_LT_OQ)));
+
+    // Clamped to the grid first, so truncating is flooring
+    _mm256_storeu_si256((__m256i*)&this->mMinX[i], _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(minX, zero), lastX)));
+    _mm256_storeu_si256((__m256i*)&this->mMaxX[i], _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(maxX, zero), lastX)));
+    _mm256_storeu_si256((__m256i*)&this->mMinY[i], _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(minY, zero), lastY)));
+    _mm256_storeu_si256((__m256i*)&this->mMaxY[i], _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(maxY, zero), lastY)));
+    _mm256_storeu_ps(&this->mNearDepth[i], nearDepth);
+    _mm256_storeu_ps(&this->mFarDepth[i], farDepth);
+
+    int mask = _mm256_movemask_ps(visible);
+    for (int lane = 0; lane < 8; lane++) {
+      this->mVisible[i + lane] = (mask >> lane) & 1;
+    }
+  }
+#elif LIGHT_GRID_SIMD_WIDTH == 4
+  __m128 vRowX[4], vRowY[4], vRowDepth[4];
+  for (int i = 0; i < 4; i++) {
+    vRowX[i] = _mm_set1_ps(rowX[i]);
+    vRowY[i] = _mm_set1_ps(rowY[i]);
+    vRowDepth[i] = _mm_set1_ps(rowDepth[i]);
+  }
+  __m128 nearPlane = _mm_set1_ps(FRAME_NEAR_PLANE);
+  __m128 farPlane = _mm_set1_ps(FRAME_FAR_PLANE);
+  __m128 zero = _mm_setzero_ps();
+  __m128 centerX = _mm_set1_ps(0.5f * LIGHT_GRID_X);
+  __m128 centerY = _mm_set1_ps(0.5f * LIGHT_GRID_Y);
+  __m128 scaleX = _mm_set1_ps(projectionX * 0.5f * LIGHT_GRID_X);
+  __m128 scaleY = _mm_set1_ps(projectionY * 0.5f * LIGHT_GRID_Y);
+  __m128 tilesX = _mm_set1_ps((float)LIGHT_GRID_X);
+  __m128 tilesY = _mm_set1_ps((float)LIGHT_GRID_Y);
+  __m128 lastX = _mm_set1_ps((float)(LIGHT_GRID_X - 1));
+  __m128 lastY = _mm_set1_ps((float)(LIGHT_GRID_Y - 1));
+
+  for (size_t i = 0; i < count; i += 4) {
+    __m128 x = _mm_loadu_ps(&this->mX[i]);
+    __m128 y = _mm_loadu_ps(&this->mY[i]);
+    __m128 z = _mm_loadu_ps(&this->mZ[i]);
+    __m128 radius = _mm_loadu_ps(&this->mRadius[i]);
+
+    __m128 viewX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vRowX[0], x), _mm_mul_ps(vRowX[1], y)),
+			      _mm_add_ps(_mm_mul_ps(vRowX[2], z), vRowX[3]));
+    __m128 viewY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vRowY[0], x), _mm_mul_ps(vRowY[1], y)),
+			      _mm_add_ps(_mm_mul_ps(vRowY[2], z), vRowY[3]));
+    __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vRowDepth[0], x), _mm_mul_ps(vRowDepth[1], y)),
+			      _mm_add_ps(_mm_mul_ps(vRowDepth[2], z), vRowDepth[3]));
+
+    __m128 nearDepth = _mm_max_ps(_mm_sub_ps(depth, radius), nearPlane);
+    __m128 farDepth = _mm_min_ps(_mm_add_ps(depth, radius), farPlane);
+    __m128 visible = _mm_and_ps(_mm_cmpgt_ps(radius, zero), _mm_cmple_ps(nearDepth, farDepth));
+
+    // SSE has no blend, masks pick the depth to divide by
+    __m128 low = _mm_sub_ps(viewX, radius);
+    __m128 high = _mm_add_ps(viewX, radius);
+    __m128 positive = _mm_cmpge_ps(low, zero);
+    __m128 minX = _mm_div_ps(low, _mm_or_ps(_mm_and_ps(positive, farDepth), _mm_andnot_ps(positive, nearDepth)));
+    positive = _mm_cmpge_ps(high, zero);
+    __m128 maxX = _mm_div_ps(high, _mm_or_ps(_mm_and_ps(positive, nearDepth), _mm_andnot_ps(positive, farDepth)));
+    low = _mm_sub_ps(viewY, radius);
+    high = _mm_add_ps(viewY, radius);
+    positive = _mm_cmpge_ps(low, zero);
+    __m128 minY = _mm_div_ps(low, _mm_or_ps(_mm_and_ps(positive, farDepth), _mm_andnot_ps(positive, nearDepth)));
+    positive = _mm_cmpge_ps(high, zero);
+    __m128 maxY = _mm_div_ps(high, _mm_or_ps(_mm_and_ps(positive, nearDepth), _mm_andnot_ps(positive, farDepth)));
+
+    // Tiles, (ndc * 0.5 + 0.5) * tiles with the projection folded in
+    minX = _mm_add_ps(_mm_mul_ps(minX, scaleX), centerX);
+    maxX = _mm_add_ps(_mm_mul_ps(maxX, scaleX), centerX);
+    minY = _mm_add_ps(_mm_mul_ps(minY, scaleY), centerY);
+    maxY = _mm_add_ps(_mm_mul_ps(maxY, scaleY), centerY);
+    visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(maxX, zero), _mm_cmplt_ps(minX, tilesX)));
+    visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(maxY, zero), _mm_cmplt_ps(minY, tilesY)));
+
+    // Clamped to the grid first, so truncating is flooring
+    _mm_storeu_si128((__m128i*)&this->mMinX[i], _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(minX, zero), lastX)));
+    _mm_storeu_si128((__m128i*)&this->mMaxX[i], _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(maxX, zero), lastX)));
+    _mm_storeu_si128((__m128i*)&this->mMinY[i], _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(minY, zero), lastY)));
+    _mm_storeu_si128((__m128i*)&this->mMaxY[i], _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(maxY, zero), lastY)));
+    _mm_storeu_ps(&this->mNearDepth[i], nearDepth);
+    _mm_storeu_ps(&this->mFarDepth[i], farDepth);
+
+    int mask = _mm_movemask_ps(visible);
+    for (int lane = 0; lane < 4; lane++) {
+      this->mVisible[i + lane] = (mask >> lane) & 1;
+    }
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    float x = this->mX[i], y = this->mY[i], z = this->mZ[i], radius = this->mRadius[i];
+    float viewX = rowX[0] * x + rowX[1] * y + rowX[2] * z + rowX[3];
+    float viewY = rowY[0] * x + rowY[1] * y + rowY[2] * z + rowY[3];
+    float depth = rowDepth[0] * x + rowDepth[1] * y + rowDepth[2] * z + rowDepth[3];
+
+    float nearDepth = std::max(depth - radius, FRAME_NEAR_PLANE);
+    float farDepth = std::min(depth + radius, FRAME_FAR_PLANE);
+
+    float low = viewX - radius, high = viewX + radius;
+    float minX = projectionX * low / (low >= 0.0f ? farDepth : nearDepth);
+    float maxX = projectionX * high / (high >= 0.0f ? nearDepth : farDepth);
+    low = viewY - radius;
+    high = viewY + radius;
+    float minY = projectionY * low / (low >= 0.0f ? farDepth : nearDepth);
+    float maxY = projectionY * high / (high >= 0.0f ? nearDepth : farDepth);
+
+    this->mVisible[i] = radius > 0.0f && nearDepth <= farDepth &&
+      maxX >= -1.0f && minX < 1.0f && maxY >= -1.0f && minY < 1.0f;
+    this->mMinX[i] = tileOf(minX, LIGHT_GRID_X);
+    this->mMaxX[i] = tileOf(maxX, LIGHT_GRID_X);
+    this->mMinY[i] = tileOf(minY, LIGHT_GRID_Y);
+    this->mMaxY[i] = tileOf(maxY, LIGHT_GRID_Y);
+    this->mNearDepth[i] = nearDepth;
+    this->mFarDepth[i] = farDepth;
+  }
+#endif
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// STD
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "Shader.h"
+#include "FrameData.h"
+
+// Clusters the view frustum is cut into: tiles across the screen and
+// slices in depth, exponentially spaced so near clusters stay small
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+
+// A light reaches until its attenuated color falls below this
+#define LIGHT_CUTOFF_INTENSITY (1.0f / 256.0f)
+
+// Texels per light in the record buffer, see Shaders/clusteredLights.glsl
+#define LIGHT_RECORD_TEXELS 4
+
+// Texture units of the grid's buffers, above any a material uses
+#define LIGHT_RECORDS_TEXTURE_UNIT 13
+#define LIGHT_CELLS_TEXTURE_UNIT 14
+#define LIGHT_INDICES_TEXTURE_UNIT 15
+
+// Uniform block binding point of ClusterData, set by Shader like FrameData
+#define CLUSTER_DATA_BINDING 1
+#define CLUSTER_DATA_BLOCK "ClusterData"
+
+// How the shaders find their cluster, laid out like the std140
+// ClusterData block in Shaders/clusteredLights.glsl
+struct ClusterData {
+  glm::uvec4 grid;  // Clusters along x, y and z, and the light count
+  glm::vec4 scale;  // Clusters per pixel in x and y, then the depth slice
+		    // scale and bias: slice = log(depth) * z + w
+};
+
+// What the last update binned
+struct LightGridStats {
+  size_t lights;
+  size_t visible;        // In the frustum
+  size_t indices;        // Light references over all clusters
+  size_t maxPerCluster;
+  double binMilliseconds;
+};
+
+// Distance at which the light's attenuation drops to LIGHT_CUTOFF_INTENSITY
+float lightRange(const Light& light);
+
+// Lights binned into a 3D grid of view space clusters, for shaders built
+// with CLUSTERED_LIGHTS. Each fragment then shades only the lights of its
+// own cluster, however many there are in the scene.
+//
+// The records, the clusters (offset and count into the index list) and
+// the index list live in texture buffers, so the GL 3.3 context needs no
+// storage buffers.
+class LightGrid {
+ public:
+  LightGrid();
+  ~LightGrid();
+
+  LightGrid(const LightGrid&) = delete;
+  LightGrid& operator=(const LightGrid&) = delete;
+
+  // Bins the lights for the frame's camera and uploads the result. Call
+  // it once per frame, after FrameUniforms::update. Bounds are culled and
+  // projected 8 lights at a time with AVX, 4 with SSE.
+  void update(const std::vector<Light>& lights, const FrameData& frame, int screenWidth, int screenHeight);
+
+  // Binds the buffers to their texture units and points the shader's
+  // samplers at them. The shader has to be in use.
+  void bind(Shader& shader);
+
+  LightGridStats getStats() const { return this->mStats; }
+
+  // Offset and count pairs into indices(), x fastest, then y, then z
+  const std::vector<GLuint>& cells() const { return this->mCells; }
+  const std::vector<GLuint>& indices() const { return this->mIndices; }
+
+ private:
+  GLuint mRecordBuffer, mCellBuffer, mIndexBuffer, mClusterBuffer;
+  GLuint mRecordTexture, mCellTexture, mIndexTexture;
+
+  // Light spheres as separate arrays, padded to whole SIMD registers
+  std::vector<float> mX, mY, mZ, mRadius;
+  // Cluster ranges of each light, from the SIMD pass
+  std::vector<int32_t> mMinX, mMaxX, mMinY, mMaxY;
+  std::vector<float> mNearDepth, mFarDepth;
+  std::vector<uint8_t> mVisible;
+
+  std::vector<glm::vec4> mRecords;
+  std::vector<GLuint> mCells;
+  std::vector<GLuint> mIndices;
+  std::vector<GLuint> mCursor;
+  LightGridStats mStats;
+
+  // Culls the lights and finds their tile ranges, in view space
+  void projectLights(const FrameData& frame, size_t count);
+};
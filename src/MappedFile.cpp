@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : mData(nullptr), mSize(0) {
+#ifdef _WIN32
+  this->mFile = INVALID_HANDLE_VALUE;
+  this->mMapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+  this->close();
+}
+
+bool MappedFile::open(const std::string& path) {
+  this->close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  this->mFile = file;
+  this->mMapping = mapping;
+  this->mData = (const unsigned char*)data;
+  this->mSize = (size_t)fileSize.QuadPart;
+#else
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+
+  struct stat fileInfo;
+  if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+
+  void* data = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping keeps its own reference to the file
+  ::close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  this->mData = (const unsigned char*)data;
+  this->mSize = (size_t)fileInfo.st_size;
+#endif
+
+  return true;
+}
+
+void MappedFile::close() {
+  if (this->mData == nullptr) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(this->mData);
+  CloseHandle(this->mMapping);
+  CloseHandle(this->mFile);
+  this->mFile = INVALID_HANDLE_VALUE;
+  this->mMapping = nullptr;
+#else
+  munmap((void*)this->mData, this->mSize);
+#endif
+
+  this->mData = nullptr;
+  this->mSize = 0;
+}
+
+void MappedFile::prefault() const {
+#ifndef _WIN32
+  madvise((void*)this->mData, this->mSize, MADV_WILLNEED);
+#endif
+
+  // Reading one byte per page faults the whole file in
+  volatile unsigned char sink = 0;
+  for (size_t offset = 0; offset < this->mSize; offset += 4096) {
+    sink = sink + this->mData[offset];
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// STD
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file can't be opened or is empty
+  bool open(const std::string& path);
+  void close();
+
+  // Touches every page so later reads don't stall on disk
+  void prefault() const;
+
+  const unsigned char* data() const { return this->mData; }
+  size_t size() const { return this->mSize; }
+
+ private:
+  const unsigned char* mData;
+  size_t mSize;
+#ifdef _WIN32
+  void* mFile;
+  void* mMapping;
+#endif
+};
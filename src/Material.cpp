@@ -0,0 +1,35 @@
+#include "Material.h"
+
+Material::Material(std::vector<Texture *> textures, float shininess) : mTextures(std::move(textures)),
+								       mShininess(shininess),
+								       mSamplerNames() {
+  // Numbered per type in texture order: texture_diffuse1, texture_diffuse2, ...
+  GLuint diffuseNumber = 1;
+  GLuint specularNumber = 1;
+  for(Texture* texture : this->mTextures) {
+    std::string name = texture->type;
+    if(texture->type == "texture_diffuse") {
+      name += std::to_string(diffuseNumber++);
+    } else if(texture->type == "texture_specular") {
+      name += std::to_string(specularNumber++);
+    }
+    this->mSamplerNames.push_back(uniformHash(name.c_str()));
+  }
+}
+
+void Material::bind(Shader* shader) {
+  for (GLuint unit = 0; unit < this->mTextures.size(); unit++) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, this->mTextures[unit]->id);
+    shader->setInt(this->mSamplerNames[unit], (GLint)unit);
+  }
+
+  shader->setFloat(UNIFORM("material.shininess"), this->mShininess);
+}
+
+void Material::unbind() {
+  for (GLuint unit = 0; unit < this->mTextures.size(); unit++) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+}
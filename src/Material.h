@@ -0,0 +1,49 @@
+#pragma once
+
+// STD
+#include <string>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// ASSIMP
+#include <assimp/types.h>
+
+#include "Shader.h"
+
+// Shininess every mesh material gets unless told otherwise
+#define MATERIAL_DEFAULT_SHININESS 16.0f
+
+struct Texture {
+  GLuint id;
+  std::string type;
+  aiString path;
+};
+
+// A mesh's textures and constants, bound to a shader in one call.
+//
+// The sampler names (type plus a number per type, texture_diffuse1,
+// texture_specular1, ...) are hashed once when the material is made, so
+// binding it is texture calls and shader setters only, without strings
+// or allocations. The setters leave out samplers already pointing at the
+// right unit. Texture i goes to unit i.
+class Material {
+ public:
+  explicit Material(std::vector<Texture *> textures = {}, float shininess = MATERIAL_DEFAULT_SHININESS);
+
+  // Binds the textures and sets the uniforms, the shader's program has to
+  // be in use
+  void bind(Shader* shader);
+
+  // Unbinds the textures again
+  void unbind();
+
+  inline const std::vector<Texture *>& getTextures() const { return this->mTextures; }
+  inline float getShininess() const { return this->mShininess; }
+
+ private:
+  std::vector<Texture *> mTextures;
+  float mShininess;
+  std::vector<uint32_t> mSamplerNames; // Hashed, one per texture
+};
@@ -1,84 +1,208 @@
 #include "Mesh.h"
+#include "VertexLayout.h"
+
+// STD
+#include <algorithm>
+#include <cstdint>
+
+Mesh::Mesh(std::vector<Vertex> vertices,
+	   std::vector<GLuint> indices,
+	   std::vector<Texture *> textures,
+	   VertexFormat vertexFormat,
+	   GeometryArena* arena,
+	   std::vector<MeshLod> lods) : mVAO(0),
+				   mVBO(0),
+				   mEBO(0),
+				   mLayerVBO(0),
+				   mQuantizationVBO(0),
+				   mVertices(std::move(vertices)),
+				   mIndices(std::move(indices)),
+				   mLods(std::move(lods)),
+				   mMaterial(std::move(textures)),
+				   mMaterialLayers({ 0, 0, -1, -1 }),
+				   mIndexType(GL_UNSIGNED_INT),
+				   mVertexFormat(vertexFormat),
+				   mArena(arena),
+				   mAllocation({ 0, 0 }),
+				   mHasMaterialLayers(false),
+				   mPositionOffset(0.0f),
+				   mPositionScale(0.0f),
+				   mBoundingBox({ glm::vec3(0.0f), glm::vec3(0.0f) }),
+				   mBoundingSphere({ glm::vec3(0.0f), 0.0f }) {
+  if(this->mLods.empty()) {
+    this->mLods.push_back({ 0, (GLuint)this->mIndices.size(), 0.0f });
+  }
 
-Mesh::Mesh(std::vector<Vertex *> vertices,
-	   std::vector<GLuint *> indices,
-	   std::vector<Texture *> textures) : mVertices(vertices),
-					    mIndices(indices),
-					    mTextures(textures) {
   this->setupMesh();
 }
 
-void Mesh::draw(Shader* shader) {
-  GLuint diffuseNumber = 1;
-  GLuint specularNumber = 1;
-
-  for(GLuint i = 0; i < this->mTextures.size(); i++) {
-    // Activate proper texture unit before binding
-    glActiveTexture(GL_TEXTURE0 + i);
-    // Retrive texture number (the N in diffuse_textureN)
-    std::stringstream stringStream;
-    std::string number;
-    std::string name = this->mTextures[i]->type;
-
-    if(name == "texture_diffuse") {
-      stringStream << diffuseNumber++; // Transfer GLuint to stream
-    } else if(name == "texture_specular") {
-      stringStream << specularNumber++; // Transfer GLuint to stream
+void Mesh::draw(Shader* shader, DrawStats* stats, GLuint lod, GLsizei instanceCount) {
+  this->mMaterial.bind(shader);
+  this->drawGeometry(stats, lod, instanceCount);
+  this->mMaterial.unbind();
+
+  if(stats != nullptr) {
+    stats->textureBinds += this->mMaterial.getTextures().size() * 2;
+  }
+}
+
+void Mesh::drawGeometry(DrawStats* stats, GLuint lod, GLsizei instanceCount) {
+  size_t levelIndex = std::min((size_t)lod, this->mLods.size() - 1);
+  const MeshLod& level = this->mLods[levelIndex];
+  size_t indexOffset = level.indexOffset * (this->mIndexType == GL_UNSIGNED_SHORT ? 2 : 4);
+
+  if(this->mArena == nullptr) {
+    glBindVertexArray(this->mVAO);
+    if(instanceCount == 1) {
+      glDrawElements(GL_TRIANGLES, level.indexCount, this->mIndexType, (GLvoid *)indexOffset);
+    } else {
+      glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, this->mIndexType, (GLvoid *)indexOffset, instanceCount);
     }
+    glBindVertexArray(0);
 
-    number = stringStream.str();
-    // Now set the sampler to the correct texture unit
-    glUniform1i(glGetUniformLocation(shader->getProgram(), (name + number).c_str()), i);
-    // And finally bind the texture
-    glBindTexture(GL_TEXTURE_2D, this->mTextures[i]->id);
+    if(stats != nullptr) {
+      stats->vertexArrayBinds += 2;
+      stats->drawCalls++;
+      stats->triangles += level.indexCount / 3 * instanceCount;
+      stats->lodTriangles[levelIndex] += level.indexCount / 3 * instanceCount;
+    }
+    return;
   }
 
-  // Also set each mesh's shininess property to a default value
-  // (if you want you could extend this to another mesh property and possibly change this value)
-  glUniform1i(glGetUniformLocation(shader->getProgram(), "material.shininess"), 16.0f);
+  // The arena's VAO leaves these attributes disabled, so the shader reads
+  // the current values, which are context state and survive the VAO
+  size_t attributeUpdates = 0;
+  if(this->mHasMaterialLayers) {
+    glVertexAttrib2f(LAYER_ATTRIB_INDEX, (GLfloat)this->mMaterialLayers.diffuseLayer,
+		     (GLfloat)this->mMaterialLayers.specularLayer);
+    attributeUpdates++;
+  }
+  if(this->mVertexFormat == VertexFormat::PACKED16) {
+    glVertexAttrib3fv(POSITION_OFFSET_ATTRIB_INDEX, &this->mPositionOffset[0]);
+    glVertexAttrib3fv(POSITION_SCALE_ATTRIB_INDEX, &this->mPositionScale[0]);
+    attributeUpdates += 2;
+  }
 
-  // Draw mesh
-  glBindVertexArray(this->mVAO);
-  glDrawElements(GL_TRIANGLES, this->mIndices.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+  const GLvoid* indices = (GLvoid *)(this->mAllocation.indexOffset + indexOffset);
+  if(instanceCount == 1) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, this->mIndexType, indices, this->mAllocation.baseVertex);
+  } else {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, this->mIndexType, indices, instanceCount,
+				      this->mAllocation.baseVertex);
+  }
+
+  if(stats != nullptr) {
+    stats->attributeUpdates += attributeUpdates;
+    stats->drawCalls++;
+    stats->triangles += level.indexCount / 3 * instanceCount;
+    stats->lodTriangles[levelIndex] += level.indexCount / 3 * instanceCount;
+  }
+}
+
+size_t Mesh::getVertexBufferBytes() {
+  return this->mVertices.size() * vertexLayout(this->mVertexFormat).stride;
+}
+
+void Mesh::setMaterialLayers(const MaterialLayers& layers) {
+  this->mMaterialLayers = layers;
+  this->mHasMaterialLayers = true;
+
+  if(this->mArena != nullptr) {
+    return;
+  }
+
+  // One element covers the mesh, however many instances draw it
+  GLfloat layerData[2] = { (GLfloat)layers.diffuseLayer, (GLfloat)layers.specularLayer };
 
-  // Always good practice to set everything back to defaults once configured
-  for(GLuint i = 0; i < this->mTextures.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, 0);
+  if(this->mLayerVBO == 0) {
+    glGenBuffers(1, &this->mLayerVBO);
   }
+
+  glBindVertexArray(this->mVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, this->mLayerVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(layerData), layerData, GL_STATIC_DRAW);
+
+  // Material Layers
+  glEnableVertexAttribArray(LAYER_ATTRIB_INDEX);
+  glVertexAttribPointer(LAYER_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(layerData), (GLvoid *)0);
+  glVertexAttribDivisor(LAYER_ATTRIB_INDEX, MESH_CONSTANT_DIVISOR);
+
+  glBindVertexArray(0);
 }
 
 void Mesh::setupMesh() {
+  const VertexLayout& layout = vertexLayout(this->mVertexFormat);
+  const GLvoid* vertexData = &this->mVertices[0];
+  std::vector<PackedVertex> packedVertices;
+
+  computeBounds(&this->mVertices[0].position, this->mVertices.size(), sizeof(Vertex),
+		this->mBoundingBox, this->mBoundingSphere);
+
+  if(this->mVertexFormat == VertexFormat::PACKED16) {
+    // Positions are quantized within the mesh's bounding box
+    this->mPositionOffset = this->mBoundingBox.min;
+    this->mPositionScale = this->mBoundingBox.max - this->mBoundingBox.min;
+
+    packedVertices.reserve(this->mVertices.size());
+    for(auto& vertex : this->mVertices) {
+      packedVertices.push_back(packVertex(vertex.position, vertex.normal, vertex.texCoords,
+					  this->mPositionOffset, this->mPositionScale));
+    }
+    vertexData = packedVertices.data();
+  }
+
+  // Half the index bytes whenever every index fits in 16 bits
+  const GLvoid* indexData = &this->mIndices[0];
+  std::vector<GLushort> shortIndices;
+  if(this->mVertices.size() <= 0x10000) {
+    shortIndices.assign(this->mIndices.begin(), this->mIndices.end());
+    this->mIndexType = GL_UNSIGNED_SHORT;
+    indexData = shortIndices.data();
+  } else {
+    this->mIndexType = GL_UNSIGNED_INT;
+  }
+
+  if(this->mArena != nullptr) {
+    this->mAllocation = this->mArena->allocate(this->mVertexFormat, vertexData, this->mVertices.size(),
+					       indexData, this->getIndexBufferBytes());
+    return;
+  }
+
   glGenVertexArrays(1, &this->mVAO);
   glGenBuffers(1, &this->mVBO);
   glGenBuffers(1, &this->mEBO);
 
   glBindVertexArray(this->mVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, this->mVBO);
 
-  glBufferData(GL_ARRAY_BUFFER, this->mVertices.size() * sizeof(Vertex),
-	       &this->mVertices[0], GL_STATIC_DRAW);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->mEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->mIndices.size() * sizeof(GLuint),
-	       &this->mIndices[0], GL_STATIC_DRAW);
+  if(this->mVertexFormat == VertexFormat::PACKED16) {
+    // The dequantization constants, per-instance data like the material layers
+    GLfloat quantization[6] = { this->mPositionOffset.x, this->mPositionOffset.y, this->mPositionOffset.z,
+				this->mPositionScale.x, this->mPositionScale.y, this->mPositionScale.z };
+    glGenBuffers(1, &this->mQuantizationVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->mQuantizationVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quantization), quantization, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(POSITION_OFFSET_ATTRIB_INDEX);
+    glVertexAttribPointer(POSITION_OFFSET_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(quantization), (GLvoid *)0);
+    glVertexAttribDivisor(POSITION_OFFSET_ATTRIB_INDEX, MESH_CONSTANT_DIVISOR);
+    glEnableVertexAttribArray(POSITION_SCALE_ATTRIB_INDEX);
+    glVertexAttribPointer(POSITION_SCALE_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(quantization),
+			  (GLvoid *)(3 * sizeof(GLfloat)));
+    glVertexAttribDivisor(POSITION_SCALE_ATTRIB_INDEX, MESH_CONSTANT_DIVISOR);
+  }
 
-  // Vertex Positions
-  glEnableVertexAttribArray(VERTEX_ATTRIB_INDEX);
-  glVertexAttribPointer(VERTEX_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(GLvoid *)0);
+  glBindBuffer(GL_ARRAY_BUFFER, this->mVBO);
+  glBufferData(GL_ARRAY_BUFFER, this->mVertices.size() * layout.stride, vertexData, GL_STATIC_DRAW);
 
-  // Vertex Normals
-  glEnableVertexAttribArray(NORMAL_ATTRIB_INDEX);
-  glVertexAttribPointer(NORMAL_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(GLvoid *)offsetof(Vertex, normal));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->mEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->getIndexBufferBytes(), indexData, GL_STATIC_DRAW);
 
-  // Vertex Texture Coords
-  glEnableVertexAttribArray(TEXTURE_ATTRIB_INDEX);
-  glVertexAttribPointer(TEXTURE_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			(GLvoid *)offsetof(Vertex, texCoords));
+  // Vertex positions, normals and texture coords, in whatever format the layout uses
+  for(auto& attribute : layout.attributes) {
+    glEnableVertexAttribArray(attribute.index);
+    glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized,
+			  layout.stride, (GLvoid *)(uintptr_t)attribute.offset);
+  }
 
   glBindVertexArray(0);
 }
-
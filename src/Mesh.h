@@ -15,10 +15,24 @@
 #include <assimp/postprocess.h>
 
 #include "Shader.h"
+#include "Constants.h"
+#include "GeometryArena.h"
+#include "Bounds.h"
+#include "Material.h"
 
 #define VERTEX_ATTRIB_INDEX 0
 #define NORMAL_ATTRIB_INDEX 1
 #define TEXTURE_ATTRIB_INDEX 2
+#define LAYER_ATTRIB_INDEX 3
+#define POSITION_OFFSET_ATTRIB_INDEX 4
+#define POSITION_SCALE_ATTRIB_INDEX 5
+
+// Divisor of per-mesh attributes, no instance count reaches it so every
+// instance reads the mesh's one element
+#define MESH_CONSTANT_DIVISOR 0x7FFFFFFF
+
+// Most levels of detail a mesh has, LOD 0 included
+#define MESH_MAX_LODS 5
 
 struct Vertex {
   glm::vec3 position;
@@ -26,30 +40,98 @@ struct Vertex {
   glm::vec2 texCoords;
 };
 
-struct Texture {
-  GLuint id;
-  std::string type;
-  aiString path;
+// Where a mesh's textures live once its model packed them into texture arrays
+struct MaterialLayers {
+  GLuint diffuseArray, specularArray; // 0 when the mesh has no such texture
+  GLint diffuseLayer, specularLayer;
+};
+
+// One level of detail, a range of the mesh's index buffer. All levels use
+// the same vertices.
+struct MeshLod {
+  GLuint indexOffset; // In indices
+  GLuint indexCount;
+  float error;        // How far the surface may be from LOD 0, in model units
+};
+
+// Texture binds (and unbinds), vertex array binds (and unbinds), per-mesh
+// vertex attribute updates, draw calls and triangles issued while drawing,
+// meshes left out by frustum culling, and heap allocations made on the
+// way (only counted with GAME_COUNT_ALLOCATIONS, see AllocationCounter.h)
+struct DrawStats {
+  size_t textureBinds;
+  size_t vertexArrayBinds;
+  size_t attributeUpdates;
+  size_t drawCalls;
+  size_t triangles;
+  size_t lodTriangles[MESH_MAX_LODS]; // The triangles by the LOD they drew at
+  size_t culledMeshes;
+  size_t heapAllocations;
 };
 
 class Mesh {
  public:
-  Mesh(std::vector<Vertex *> vertices, std::vector<GLuint *> indices, std::vector<Texture *> textures);
+  // Packed meshes need a vertex shader that dequantizes (see VertexLayout.h)
+  // With an arena the mesh has no buffers or VAO of its own, it lives in
+  // the arena's and the caller binds the arena's VAO before drawing it
+  // Without lods all indices make up LOD 0.
+  Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture *> textures,
+       VertexFormat vertexFormat = VertexFormat::FLOAT32, GeometryArena* arena = nullptr,
+       std::vector<MeshLod> lods = {});
+
+  // Binds the mesh's material and draws it. More than one instance
+  // needs the instance attributes bound (see InstanceBuffer.h).
+  void draw(Shader* shader, DrawStats* stats = nullptr, GLuint lod = 0, GLsizei instanceCount = 1);
+
+  // Draws with whatever textures the caller bound, used for packed models
+  void drawGeometry(DrawStats* stats = nullptr, GLuint lod = 0, GLsizei instanceCount = 1);
 
-  void draw(Shader* shader);
+  // Stores the layers as per-instance data of the mesh (with
+  // MESH_CONSTANT_DIVISOR), so the shader reads them without any per-draw
+  // state change.
+  // Arena meshes share one VAO, they set the layers as a constant vertex
+  // attribute right before their draw instead.
+  void setMaterialLayers(const MaterialLayers& layers);
 
   // Getters
-  inline std::vector<Vertex *> getVertices() { return this->mVertices; }
-  inline std::vector<GLuint *> getIndices() { return this->mIndices; }
-  inline std::vector<Texture *> getTextures() { return this->mTextures; }
+  inline std::vector<Vertex> getVertices() { return this->mVertices; }
+  inline size_t getVertexCount() { return this->mVertices.size(); }
+  inline std::vector<GLuint> getIndices() { return this->mIndices; }
+  inline std::vector<Texture *> getTextures() { return this->mMaterial.getTextures(); }
+  inline Material& getMaterial() { return this->mMaterial; }
+  inline const MaterialLayers& getMaterialLayers() { return this->mMaterialLayers; }
+  inline size_t getLodCount() { return this->mLods.size(); }
+  inline const MeshLod& getLod(GLuint lod) { return this->mLods[lod]; }
+
+  // Model space bounds
+  inline const BoundingBox& getBoundingBox() { return this->mBoundingBox; }
+  inline const BoundingSphere& getBoundingSphere() { return this->mBoundingSphere; }
+
+  // Meshes with at most 65536 vertices upload 16 bit indices
+  inline GLenum getIndexType() { return this->mIndexType; }
+  inline VertexFormat getVertexFormat() { return this->mVertexFormat; }
+  size_t getVertexBufferBytes();
+  inline size_t getIndexBufferBytes() { return this->mIndices.size() * (this->mIndexType == GL_UNSIGNED_SHORT ? 2 : 4); }
+  inline bool usesArena() { return this->mArena != nullptr; }
 
  private:
   // Render Data
-  GLuint mVAO, mVBO, mEBO;
+  GLuint mVAO, mVBO, mEBO, mLayerVBO, mQuantizationVBO;
   // Mesh Data
-  std::vector<Vertex *> mVertices;
-  std::vector<GLuint *> mIndices;
-  std::vector<Texture *> mTextures;
+  std::vector<Vertex> mVertices;
+  std::vector<GLuint> mIndices;
+  std::vector<MeshLod> mLods;
+  Material mMaterial;
+  MaterialLayers mMaterialLayers;
+  GLenum mIndexType;
+  VertexFormat mVertexFormat;
+  // Arena meshes: where their data is and their per-mesh constants
+  GeometryArena* mArena;
+  GeometryArena::Allocation mAllocation;
+  bool mHasMaterialLayers;
+  glm::vec3 mPositionOffset, mPositionScale;
+  BoundingBox mBoundingBox;
+  BoundingSphere mBoundingSphere;
 
   void setupMesh();
 };
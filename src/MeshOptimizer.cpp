@@ -0,0 +1,786 @@
+#include "MeshOptimizer.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Vertices are compared as raw bytes, so there must be no padding in them
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex has padding");
+
+namespace {
+  // FNV-1a over the vertex's 32 bit words, positions, normals and UVs alike
+  uint32_t hashVertex(const Vertex& vertex) {
+    uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+    std::memcpy(words, &vertex, sizeof(words));
+
+    uint32_t hash = 2166136261u;
+    for (uint32_t word : words) {
+      hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+  }
+
+  // FIFO post transform cache, a vertex is cached while fewer than size
+  // misses happened since it was loaded
+  class FifoCache {
+   public:
+    FifoCache(size_t vertexCount, unsigned int size) : mStamps(vertexCount, 0), mTime(size + 1), mSize(size) {}
+
+    // True if the vertex had to be transformed
+    bool access(GLuint vertex) {
+      if (this->mTime - this->mStamps[vertex] > this->mSize) {
+	this->mStamps[vertex] = this->mTime++;
+	return true;
+      }
+      return false;
+    }
+
+    unsigned int triangleMisses(const GLuint* triangle) {
+      return this->access(triangle[0]) + this->access(triangle[1]) + this->access(triangle[2]);
+    }
+
+    // Ages every vertex out of the cache
+    void flush() { this->mTime += this->mSize + 1; }
+
+   private:
+    std::vector<size_t> mStamps;
+    size_t mTime;
+    size_t mSize;
+  };
+
+  // Tipsify's choice of the next vertex to fan around: the candidate that
+  // stays in the cache while its remaining triangles are emitted, oldest
+  // first. Without one, the most recent dead end, then the next vertex in
+  // input order that still has triangles.
+  int64_t nextFanVertex(const std::vector<GLuint>& candidates, const std::vector<GLuint>& liveTriangles,
+			const std::vector<size_t>& stamps, size_t time, unsigned int cacheSize,
+			std::vector<GLuint>& deadEnds, size_t& cursor) {
+    int64_t best = -1;
+    int64_t bestPriority = -1;
+    for (GLuint vertex : candidates) {
+      if (liveTriangles[vertex] == 0) {
+	continue;
+      }
+
+      int64_t priority = 0;
+      if (time - stamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+	priority = time - stamps[vertex];
+      }
+      if (priority > bestPriority) {
+	best = vertex;
+	bestPriority = priority;
+      }
+    }
+
+    if (best != -1) {
+      return best;
+    }
+
+    while (!deadEnds.empty()) {
+      GLuint vertex = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[vertex] > 0) {
+	return vertex;
+      }
+    }
+
+    for (; cursor < liveTriangles.size(); cursor++) {
+      if (liveTriangles[cursor] > 0) {
+	return cursor;
+      }
+    }
+
+    return -1;
+  }
+
+  // Edges of the triangles leaving each vertex, in index space
+  class EdgeAdjacency {
+   public:
+    EdgeAdjacency(const std::vector<GLuint>& indices, size_t vertexCount) : mOffsets(vertexCount + 1, 0),
+									     mTargets(indices.size()) {
+      for (GLuint index : indices) {
+	this->mOffsets[index + 1]++;
+      }
+      for (size_t i = 0; i < vertexCount; i++) {
+	this->mOffsets[i + 1] += this->mOffsets[i];
+      }
+
+      std::vector<GLuint> fill(this->mOffsets.begin(), this->mOffsets.end() - 1);
+      for (size_t corner = 0; corner < indices.size(); corner++) {
+	size_t next = corner % 3 == 2 ? corner - 2 : corner + 1;
+	this->mTargets[fill[indices[corner]]++] = indices[next];
+      }
+    }
+
+    bool hasEdge(GLuint from, GLuint to) const {
+      for (GLuint i = this->mOffsets[from]; i < this->mOffsets[from + 1]; i++) {
+	if (this->mTargets[i] == to) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
+    // The one edge out of and into every vertex that no triangle has the
+    // other way round, noOpenEdge if there is none and the vertex itself
+    // if there are several
+    void findOpenEdges(std::vector<GLuint>& openOut, std::vector<GLuint>& openIn) const {
+      size_t vertexCount = this->mOffsets.size() - 1;
+      openOut.assign(vertexCount, noOpenEdge);
+      openIn.assign(vertexCount, noOpenEdge);
+
+      for (GLuint vertex = 0; vertex < vertexCount; vertex++) {
+	for (GLuint i = this->mOffsets[vertex]; i < this->mOffsets[vertex + 1]; i++) {
+	  GLuint target = this->mTargets[i];
+	  if (!this->hasEdge(target, vertex)) {
+	    openOut[vertex] = openOut[vertex] == noOpenEdge ? target : vertex;
+	    openIn[target] = openIn[target] == noOpenEdge ? vertex : target;
+	  }
+	}
+      }
+    }
+
+    static constexpr GLuint noOpenEdge = ~0u;
+
+   private:
+    std::vector<GLuint> mOffsets;
+    std::vector<GLuint> mTargets;
+  };
+
+  // Symmetric matrix, vector and constant of the summed squared distances to
+  // a set of planes, with the total weight of the planes
+  struct Quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double weight;
+  };
+
+  Quadric planeQuadric(const glm::vec3& normal, const glm::vec3& point, double weight) {
+    double d = -glm::dot(normal, point);
+    Quadric quadric = {
+      weight * normal.x * normal.x, weight * normal.y * normal.y, weight * normal.z * normal.z,
+      weight * normal.x * normal.y, weight * normal.x * normal.z, weight * normal.y * normal.z,
+      weight * normal.x * d, weight * normal.y * d, weight * normal.z * d,
+      weight * d * d,
+      weight
+    };
+    return quadric;
+  }
+
+  void addQuadric(Quadric& quadric, const Quadric& other) {
+    quadric.a00 += other.a00; quadric.a11 += other.a11; quadric.a22 += other.a22;
+    quadric.a01 += other.a01; quadric.a02 += other.a02; quadric.a12 += other.a12;
+    quadric.b0 += other.b0; quadric.b1 += other.b1; quadric.b2 += other.b2;
+    quadric.c += other.c;
+    quadric.weight += other.weight;
+  }
+
+  // Weighted mean squared distance of the point to the planes
+  double quadricError(const Quadric& quadric, const glm::vec3& point) {
+    double x = point.x, y = point.y, z = point.z;
+    double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z
+      + 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+      + 2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z)
+      + quadric.c;
+    return quadric.weight > 0.0 ? std::max(error, 0.0) / quadric.weight : 0.0;
+  }
+
+  // How a vertex may move. Seam vertices share their position with exactly
+  // one other vertex, the two sides of an attribute seam.
+  enum class VertexKind { MANIFOLD, BORDER, SEAM, LOCKED };
+
+  // Border and seam planes count this much more than the surface, so
+  // outlines stay put
+  const double BORDER_WEIGHT = 10.0;
+
+  struct Collapse {
+    GLuint vertex;
+    GLuint target;
+    float error;
+  };
+}
+
+void weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+  if (vertices.empty()) {
+    return;
+  }
+
+  // Open addressing table of new vertex indices, at most half full
+  size_t tableSize = 1;
+  while (tableSize < vertices.size() * 2) {
+    tableSize *= 2;
+  }
+  const GLuint empty = ~0u;
+  std::vector<GLuint> table(tableSize, empty);
+
+  std::vector<GLuint> remap(vertices.size());
+  std::vector<Vertex> welded;
+  welded.reserve(vertices.size());
+
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const Vertex& vertex = vertices[i];
+    size_t slot = hashVertex(vertex) & (tableSize - 1);
+
+    while (table[slot] != empty && std::memcmp(&welded[table[slot]], &vertex, sizeof(Vertex)) != 0) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+
+    if (table[slot] == empty) {
+      table[slot] = (GLuint)welded.size();
+      welded.push_back(vertex);
+    }
+    remap[i] = table[slot];
+  }
+
+  for (GLuint& index : indices) {
+    index = remap[index];
+  }
+  vertices.swap(welded);
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles around each vertex
+  std::vector<GLuint> offsets(vertexCount + 1, 0);
+  for (GLuint index : indices) {
+    offsets[index + 1]++;
+  }
+  for (size_t i = 0; i < vertexCount; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+
+  std::vector<GLuint> adjacency(indices.size());
+  std::vector<GLuint> liveTriangles(vertexCount, 0);
+  for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+    for (int corner = 0; corner < 3; corner++) {
+      GLuint vertex = indices[triangle * 3 + corner];
+      adjacency[offsets[vertex] + liveTriangles[vertex]++] = (GLuint)triangle;
+    }
+  }
+
+  std::vector<size_t> stamps(vertexCount, 0);
+  size_t time = cacheSize + 1;
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<GLuint> deadEnds;
+  std::vector<GLuint> candidates;
+  std::vector<GLuint> output;
+  output.reserve(indices.size());
+  size_t cursor = 0;
+
+  int64_t fanVertex = nextFanVertex(candidates, liveTriangles, stamps, time, cacheSize, deadEnds, cursor);
+  while (fanVertex >= 0) {
+    // Emit every triangle left around the fan vertex
+    candidates.clear();
+    for (GLuint i = offsets[fanVertex]; i < offsets[fanVertex + 1]; i++) {
+      GLuint triangle = adjacency[i];
+      if (emitted[triangle]) {
+	continue;
+      }
+
+      for (int corner = 0; corner < 3; corner++) {
+	GLuint vertex = indices[triangle * 3 + corner];
+	output.push_back(vertex);
+	deadEnds.push_back(vertex);
+	candidates.push_back(vertex);
+	liveTriangles[vertex]--;
+	if (time - stamps[vertex] > cacheSize) {
+	  stamps[vertex] = time++;
+	}
+      }
+      emitted[triangle] = true;
+    }
+
+    fanVertex = nextFanVertex(candidates, liveTriangles, stamps, time, cacheSize, deadEnds, cursor);
+  }
+
+  indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+		      float threshold, unsigned int cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2) {
+    return;
+  }
+
+  // Hard boundaries: triangles that miss on all corners start over from
+  // a cold cache anyway, so cutting there costs nothing
+  std::vector<size_t> hardClusters;
+  FifoCache cache(vertices.size(), cacheSize);
+  for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+    if (cache.triangleMisses(&indices[triangle * 3]) == 3 || triangle == 0) {
+      hardClusters.push_back(triangle);
+    }
+  }
+  hardClusters.push_back(triangleCount);
+
+  // Soft boundaries: cut a hard cluster wherever the part so far is within
+  // the threshold of the whole cluster's ACMR. The next part starts cold,
+  // it may end up anywhere in the draw order.
+  std::vector<size_t> clusters;
+  for (size_t i = 0; i + 1 < hardClusters.size(); i++) {
+    size_t start = hardClusters[i];
+    size_t end = hardClusters[i + 1];
+
+    cache.flush();
+    size_t clusterMisses = 0;
+    for (size_t triangle = start; triangle < end; triangle++) {
+      clusterMisses += cache.triangleMisses(&indices[triangle * 3]);
+    }
+    float limit = threshold * clusterMisses / (end - start);
+
+    cache.flush();
+    clusters.push_back(start);
+    size_t misses = 0;
+    size_t triangles = 0;
+    for (size_t triangle = start; triangle + 1 < end; triangle++) {
+      misses += cache.triangleMisses(&indices[triangle * 3]);
+      triangles++;
+      if (misses <= limit * triangles) {
+	clusters.push_back(triangle + 1);
+	cache.flush();
+	misses = 0;
+	triangles = 0;
+      }
+    }
+  }
+  clusters.push_back(triangleCount);
+
+  // Area weighted centroid and normal of every cluster and of the mesh
+  size_t clusterCount = clusters.size() - 1;
+  std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+  std::vector<float> areas(clusterCount, 0.0f);
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+
+  for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+    for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++) {
+      const glm::vec3& a = vertices[indices[triangle * 3 + 0]].position;
+      const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+      const glm::vec3& c = vertices[indices[triangle * 3 + 2]].position;
+
+      glm::vec3 normal = glm::cross(b - a, c - a);
+      float area = glm::length(normal);
+      centroids[cluster] += (a + b + c) * (area / 3.0f);
+      normals[cluster] += normal;
+      areas[cluster] += area;
+    }
+    meshCentroid += centroids[cluster];
+    meshArea += areas[cluster];
+  }
+  if (meshArea > 0.0f) {
+    meshCentroid /= meshArea;
+  }
+
+  // Clusters far out along their own normal cover the most, they go first
+  std::vector<float> sortKeys(clusterCount, 0.0f);
+  for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+    float normalLength = glm::length(normals[cluster]);
+    if (areas[cluster] > 0.0f && normalLength > 0.0f) {
+      sortKeys[cluster] = glm::dot(centroids[cluster] / areas[cluster] - meshCentroid,
+				   normals[cluster] / normalLength);
+    }
+  }
+
+  std::vector<size_t> order(clusterCount);
+  for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+    order[cluster] = cluster;
+  }
+  std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) {
+    return sortKeys[a] > sortKeys[b];
+  });
+
+  std::vector<GLuint> output;
+  output.reserve(indices.size());
+  for (size_t cluster : order) {
+    output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+  }
+  indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+  const GLuint unused = ~0u;
+  std::vector<GLuint> remap(vertices.size(), unused);
+  std::vector<Vertex> ordered;
+  ordered.reserve(vertices.size());
+
+  for (GLuint& index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = (GLuint)ordered.size();
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(ordered);
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount,
+				    unsigned int cacheSize) {
+  FifoCache cache(vertexCount, cacheSize);
+  std::vector<bool> referenced(vertexCount, false);
+  size_t misses = 0;
+  size_t referencedCount = 0;
+
+  for (GLuint index : indices) {
+    misses += cache.access(index);
+    if (!referenced[index]) {
+      referenced[index] = true;
+      referencedCount++;
+    }
+  }
+
+  VertexCacheStats stats = { 0.0f, 0.0f };
+  if (indices.size() >= 3) {
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / referencedCount;
+  }
+  return stats;
+}
+
+float simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+		   size_t targetIndexCount, float targetError, std::vector<GLuint>& destination) {
+  destination = indices;
+  size_t vertexCount = vertices.size();
+  if (destination.size() <= targetIndexCount || vertexCount == 0) {
+    return 0.0f;
+  }
+
+  // Positions scaled into the unit cube, so errors are relative to the size
+  glm::vec3 boundsMin = vertices[0].position;
+  glm::vec3 boundsMax = vertices[0].position;
+  for (auto& vertex : vertices) {
+    boundsMin = glm::min(boundsMin, vertex.position);
+    boundsMax = glm::max(boundsMax, vertex.position);
+  }
+  float extent = std::max(boundsMax.x - boundsMin.x, std::max(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z));
+  if (extent <= 0.0f) {
+    return 0.0f;
+  }
+
+  std::vector<glm::vec3> positions(vertexCount);
+  for (size_t i = 0; i < vertexCount; i++) {
+    positions[i] = (vertices[i].position - boundsMin) / extent;
+  }
+
+  // The first vertex at every position stands for all of them, the others
+  // are linked to it in a ring
+  std::vector<GLuint> order(vertexCount);
+  for (size_t i = 0; i < vertexCount; i++) {
+    order[i] = (GLuint)i;
+  }
+  std::sort(order.begin(), order.end(), [&vertices](GLuint a, GLuint b) {
+    const glm::vec3& pa = vertices[a].position;
+    const glm::vec3& pb = vertices[b].position;
+    return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z != pb.z ? pa.z < pb.z : a < b;
+  });
+
+  std::vector<GLuint> remap(vertexCount);
+  std::vector<GLuint> wedge(vertexCount);
+  for (size_t start = 0, end = 0; start < vertexCount; start = end) {
+    for (end = start + 1; end < vertexCount && vertices[order[end]].position == vertices[order[start]].position; end++) {
+    }
+    for (size_t i = start; i < end; i++) {
+      remap[order[i]] = order[start];
+      wedge[order[i]] = order[i + 1 < end ? i + 1 : start];
+    }
+  }
+
+  // Open edges by index are borders or seams, open edges by position are
+  // only borders
+  std::vector<GLuint> openOut, openIn;
+  EdgeAdjacency(destination, vertexCount).findOpenEdges(openOut, openIn);
+
+  std::vector<GLuint> positionIndices(destination.size());
+  for (size_t i = 0; i < destination.size(); i++) {
+    positionIndices[i] = remap[destination[i]];
+  }
+  std::vector<GLuint> positionOpenOut, positionOpenIn;
+  EdgeAdjacency(positionIndices, vertexCount).findOpenEdges(positionOpenOut, positionOpenIn);
+
+  const GLuint none = EdgeAdjacency::noOpenEdge;
+  auto singleOpenEdges = [&](GLuint vertex) {
+    return openOut[vertex] != none && openOut[vertex] != vertex && openIn[vertex] != none && openIn[vertex] != vertex;
+  };
+
+  std::vector<VertexKind> kinds(vertexCount, VertexKind::LOCKED);
+  for (GLuint vertex = 0; vertex < vertexCount; vertex++) {
+    if (remap[vertex] != vertex) {
+      continue;
+    }
+
+    bool positionBorder = positionOpenOut[vertex] != none || positionOpenIn[vertex] != none;
+    VertexKind kind = VertexKind::LOCKED;
+
+    if (wedge[vertex] == vertex) {
+      if (openOut[vertex] == none && openIn[vertex] == none) {
+	kind = VertexKind::MANIFOLD;
+      } else if (singleOpenEdges(vertex) &&
+		 remap[openOut[vertex]] == positionOpenOut[vertex] && remap[openIn[vertex]] == positionOpenIn[vertex]) {
+	kind = VertexKind::BORDER;
+      }
+    } else if (wedge[wedge[vertex]] == vertex && !positionBorder) {
+      GLuint other = wedge[vertex];
+      if (singleOpenEdges(vertex) && singleOpenEdges(other) &&
+	  remap[openIn[vertex]] == remap[openOut[other]] && remap[openOut[vertex]] == remap[openIn[other]]) {
+	kind = VertexKind::SEAM;
+      }
+    }
+
+    GLuint i = vertex;
+    do {
+      kinds[i] = kind;
+      i = wedge[i];
+    } while (i != vertex);
+  }
+
+  // Surface planes weighted by area, plus planes through the border and
+  // seam edges at right angles to the surface
+  std::vector<Quadric> quadrics(vertexCount, Quadric());
+  {
+    EdgeAdjacency adjacency(destination, vertexCount);
+    for (size_t triangle = 0; triangle < destination.size() / 3; triangle++) {
+      const GLuint* corners = &destination[triangle * 3];
+      glm::vec3 normal = glm::cross(positions[corners[1]] - positions[corners[0]],
+				    positions[corners[2]] - positions[corners[0]]);
+      float area = glm::length(normal);
+      if (area == 0.0f) {
+	continue;
+      }
+      normal /= area;
+
+      Quadric surface = planeQuadric(normal, positions[corners[0]], area);
+      for (int corner = 0; corner < 3; corner++) {
+	addQuadric(quadrics[remap[corners[corner]]], surface);
+      }
+
+      for (int corner = 0; corner < 3; corner++) {
+	GLuint from = corners[corner];
+	GLuint to = corners[(corner + 1) % 3];
+	if (adjacency.hasEdge(to, from)) {
+	  continue;
+	}
+
+	glm::vec3 edge = positions[to] - positions[from];
+	float length = glm::length(edge);
+	if (length == 0.0f) {
+	  continue;
+	}
+	Quadric border = planeQuadric(glm::normalize(glm::cross(edge, normal)), positions[from],
+				      length * length * BORDER_WEIGHT);
+	addQuadric(quadrics[remap[from]], border);
+	addQuadric(quadrics[remap[to]], border);
+      }
+    }
+  }
+
+  double errorLimit = (double)targetError * targetError;
+  double resultError = 0.0;
+  std::vector<GLuint> collapseRemap(vertexCount);
+  std::vector<bool> collapseLocked(vertexCount);
+  std::vector<Collapse> collapses;
+
+  // Passes of collapses, each touching a position at most once, until the
+  // target is reached or nothing more can go
+  while (destination.size() > targetIndexCount) {
+    size_t triangleCount = destination.size() / 3;
+    EdgeAdjacency adjacency(destination, vertexCount);
+    adjacency.findOpenEdges(openOut, openIn);
+
+    // Triangles around each vertex, for the flip test
+    std::vector<GLuint> triangleOffsets(vertexCount + 1, 0);
+    for (GLuint index : destination) {
+      triangleOffsets[index + 1]++;
+    }
+    for (size_t i = 0; i < vertexCount; i++) {
+      triangleOffsets[i + 1] += triangleOffsets[i];
+    }
+    std::vector<GLuint> vertexTriangles(destination.size());
+    {
+      std::vector<GLuint> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+      for (size_t corner = 0; corner < destination.size(); corner++) {
+	vertexTriangles[fill[destination[corner]]++] = (GLuint)(corner / 3);
+      }
+    }
+
+    // For seam vertices, the matching collapse of the other side
+    auto seamTarget = [&](GLuint vertex, GLuint target) {
+      GLuint other = wedge[vertex];
+      GLuint otherTarget = target == openOut[vertex] ? openIn[other] : openOut[other];
+      if (otherTarget == none || otherTarget == other || remap[otherTarget] != remap[target]) {
+	return none;
+      }
+      return otherTarget;
+    };
+
+    auto canCollapse = [&](GLuint vertex, GLuint target) {
+      switch (kinds[vertex]) {
+      case VertexKind::MANIFOLD:
+	return true;
+      case VertexKind::BORDER:
+	return target == openOut[vertex] || target == openIn[vertex];
+      case VertexKind::SEAM:
+	return (target == openOut[vertex] || target == openIn[vertex]) && seamTarget(vertex, target) != none;
+      default:
+	return false;
+      }
+    };
+
+    auto collapseError = [&](GLuint vertex, GLuint target) {
+      Quadric quadric = quadrics[remap[vertex]];
+      addQuadric(quadric, quadrics[remap[target]]);
+      return (float)quadricError(quadric, positions[target]);
+    };
+
+    // The cheaper direction of every edge that may collapse at all
+    collapses.clear();
+    for (size_t corner = 0; corner < destination.size(); corner++) {
+      GLuint from = destination[corner];
+      GLuint to = destination[corner % 3 == 2 ? corner - 2 : corner + 1];
+      if (remap[from] == remap[to] || (from > to && adjacency.hasEdge(to, from))) {
+	continue;
+      }
+
+      bool forward = canCollapse(from, to);
+      bool backward = canCollapse(to, from);
+      if (!forward && !backward) {
+	continue;
+      }
+
+      float forwardError = forward ? collapseError(from, to) : 0.0f;
+      float backwardError = backward ? collapseError(to, from) : 0.0f;
+      if (forward && (!backward || forwardError <= backwardError)) {
+	collapses.push_back({ from, to, forwardError });
+      } else {
+	collapses.push_back({ to, from, backwardError });
+      }
+    }
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+      return a.error < b.error;
+    });
+
+    // True if moving the vertex to the target turns any of its remaining
+    // triangles over
+    auto flipsTriangles = [&](GLuint vertex, GLuint target) {
+      const glm::vec3& from = positions[vertex];
+      const glm::vec3& to = positions[target];
+      for (GLuint i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; i++) {
+	const GLuint* corners = &destination[vertexTriangles[i] * 3];
+	int corner = corners[0] == vertex ? 0 : corners[1] == vertex ? 1 : 2;
+	GLuint a = collapseRemap[corners[(corner + 1) % 3]];
+	GLuint b = collapseRemap[corners[(corner + 2) % 3]];
+	if (remap[a] == remap[target] || remap[b] == remap[target]) {
+	  continue;
+	}
+
+	// Turning by more than about 75 degrees counts, over several passes
+	// smaller turns would add up to a flip too
+	glm::vec3 before = glm::cross(positions[a] - from, positions[b] - from);
+	glm::vec3 after = glm::cross(positions[a] - to, positions[b] - to);
+	if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+	  return true;
+	}
+      }
+      return false;
+    };
+
+    for (size_t i = 0; i < vertexCount; i++) {
+      collapseRemap[i] = (GLuint)i;
+    }
+    std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+
+    size_t triangleGoal = (destination.size() - targetIndexCount) / 3;
+    size_t trianglesRemoved = 0;
+    size_t collapsed = 0;
+
+    for (const Collapse& collapse : collapses) {
+      if (collapse.error > errorLimit || trianglesRemoved >= triangleGoal) {
+	break;
+      }
+
+      GLuint vertex = collapse.vertex;
+      GLuint target = collapse.target;
+      if (collapseLocked[remap[vertex]] || collapseLocked[remap[target]]) {
+	continue;
+      }
+
+      GLuint otherVertex = none, otherTarget = none;
+      if (kinds[vertex] == VertexKind::SEAM) {
+	otherVertex = wedge[vertex];
+	otherTarget = seamTarget(vertex, target);
+      }
+
+      if (flipsTriangles(vertex, target) || (otherVertex != none && flipsTriangles(otherVertex, otherTarget))) {
+	continue;
+      }
+
+      collapseRemap[vertex] = target;
+      if (otherVertex != none) {
+	collapseRemap[otherVertex] = otherTarget;
+      }
+      addQuadric(quadrics[remap[target]], quadrics[remap[vertex]]);
+      collapseLocked[remap[vertex]] = true;
+      collapseLocked[remap[target]] = true;
+
+      // An interior edge and a seam take two triangles with them, a border one
+      trianglesRemoved += kinds[vertex] == VertexKind::BORDER ? 1 : 2;
+      resultError = std::max(resultError, (double)collapse.error);
+      collapsed++;
+    }
+
+    if (collapsed == 0) {
+      break;
+    }
+
+    // Drop the triangles that lost an edge
+    size_t write = 0;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+      GLuint a = collapseRemap[destination[triangle * 3 + 0]];
+      GLuint b = collapseRemap[destination[triangle * 3 + 1]];
+      GLuint c = collapseRemap[destination[triangle * 3 + 2]];
+      if (remap[a] != remap[b] && remap[b] != remap[c] && remap[a] != remap[c]) {
+	destination[write++] = a;
+	destination[write++] = b;
+	destination[write++] = c;
+      }
+    }
+    destination.resize(write);
+  }
+
+  return (float)std::sqrt(resultError) * extent;
+}
+
+void generateLods(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<MeshLod>& lods,
+		  unsigned int maxLods) {
+  lods.clear();
+  lods.push_back({ 0, (GLuint)indices.size(), 0.0f });
+
+  // Every level starts from the full mesh, so its error is the real
+  // distance to LOD 0 rather than a sum of steps
+  std::vector<GLuint> source = indices;
+  std::vector<GLuint> simplified;
+  float targetRatio = 1.0f;
+
+  while (lods.size() < maxLods) {
+    targetRatio *= LOD_REDUCTION;
+    size_t targetIndexCount = (size_t)(source.size() / 3 * targetRatio) * 3;
+    float error = simplifyMesh(vertices, source, targetIndexCount, LOD_MAX_ERROR, simplified);
+
+    if (simplified.empty() || simplified.size() > lods.back().indexCount * LOD_MIN_REDUCTION) {
+      break;
+    }
+
+    optimizeVertexCache(simplified, vertices.size());
+    lods.push_back({ (GLuint)indices.size(), (GLuint)simplified.size(), std::max(error, lods.back().error) });
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+  }
+}
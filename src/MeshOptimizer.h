@@ -0,0 +1,77 @@
+#pragma once
+
+// STD
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "Mesh.h"
+
+// Load time passes over a mesh's vertex and index data. They run on the
+// model's processing threads, before anything reaches GL.
+
+// Merges vertices whose bytes are identical and rewrites the indices to
+// match. Surviving vertices keep their original relative order.
+void weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+// Post transform cache the passes below optimize for and the analyzer
+// simulates, in vertices. Most GPUs behave like a FIFO of about this size.
+#define VERTEX_CACHE_SIZE 16
+
+// Cluster ACMR allowed over the ACMR of its source run when optimizeOverdraw
+// splits the index buffer. Higher values give more clusters to sort.
+#define OVERDRAW_THRESHOLD 1.05f
+
+// Post transform cache behaviour of an index buffer
+struct VertexCacheStats {
+  float acmr; // Vertices transformed per triangle, 0.5 at best and 3 at worst
+  float atvr; // Vertices transformed per vertex referenced, 1 at best
+};
+
+// Reorders the triangles for the post transform cache (Tipsify, Sander et
+// al. 2007). Linear in the number of triangles.
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount,
+			 unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Cuts a cache optimized index buffer into clusters where that costs
+// little cache efficiency, then draws the clusters that face outward from
+// the mesh centre first so they hide the rest from any viewpoint.
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices,
+		      float threshold = OVERDRAW_THRESHOLD, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Sorts the vertices by first use so the index buffer walks the vertex
+// buffer in order. Vertices no triangle uses are dropped.
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+// Simulates a FIFO post transform cache
+VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount,
+				    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// LOD chains: every level aims for this fraction of the previous level's
+// triangles, and is dropped (ending the chain) when it keeps more than
+// LOD_MIN_REDUCTION of them
+#define LOD_REDUCTION 0.5f
+#define LOD_MIN_REDUCTION 0.85f
+
+// Largest simplification error allowed in a LOD, relative to the mesh's
+// largest dimension
+#define LOD_MAX_ERROR 0.1f
+
+// Collapses edges in order of their quadric error (Garland and Heckbert
+// 1997) until the index buffer is down to targetIndexCount or the next
+// collapse would move the surface by more than targetError, relative to
+// the mesh's largest dimension. Only the indices change, the result uses
+// the same vertex buffer.
+// Vertices that share a position but not their other attributes (UV seams,
+// hard normals) only collapse along the seam, both sides together, and
+// open borders only collapse along the border, so neither tears or
+// shifts. Returns the error reached, in model units.
+float simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+		   size_t targetIndexCount, float targetError, std::vector<GLuint>& destination);
+
+// Simplifies the mesh into up to maxLods levels, LOD 0 being the indices
+// as they are. The coarser levels are cache optimized and appended to the
+// indices, lods gets where each level starts and its error.
+void generateLods(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<MeshLod>& lods,
+		  unsigned int maxLods = MESH_MAX_LODS);
@@ -1,56 +1,397 @@
 #include "Model.h"
+#include "AllocationCounter.h"
+
+Model::Model(std::string path, TextureLoader& loader, bool packTextures,
+	     VertexFormat vertexFormat, unsigned int threadCount,
+	     GeometryArena* arena) : mTextureLoader(loader),
+				     mArena(arena),
+				     mDrawStats({ 0, 0, 0, 0, 0, {}, 0, 0 }),
+				     mGeometryStats({ 0, 0, 0, 0, 0, 0, {}, 0.0, { 0.0f, 0.0f }, { 0.0f, 0.0f } }),
+				     mBoundingBox({ glm::vec3(0.0f), glm::vec3(0.0f) }),
+				     mBoundingSphere({ glm::vec3(0.0f), 0.0f }),
+				     mPackTextures(packTextures),
+				     mVertexFormat(vertexFormat),
+				     mThreadCount(threadCount) {
+  if(this->mThreadCount == 0) {
+    this->mThreadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  if(this->mArena == nullptr) {
+    this->mOwnedArena.reset(new GeometryArena());
+    this->mArena = this->mOwnedArena.get();
+  }
 
-Model::Model(std::string path, TextureLoader& loader) {
-  this->mTextureLoader = loader;
   this->loadModel(path);
 }
 
-void Model::draw(Shader* shader) {
-  for(GLuint i = 0; i < this->mMeshes.size(); i++) {
-    this->mMeshes[i]->draw(shader);
+void Model::draw(Shader* shader, const glm::mat4& transform) {
+  size_t heapAllocations = heapAllocationCount();
+  this->updateTransforms();
+  std::fill(this->mMeshLods.begin(), this->mMeshLods.end(), 0);
+  this->drawMeshes(shader, transform);
+  this->mDrawStats.heapAllocations = heapAllocationCount() - heapAllocations;
+}
+
+void Model::draw(Shader* shader, const Game::World& world, const FrameData& frame, const glm::mat4& transform,
+		 const Frustum* frustum) {
+  size_t heapAllocations = heapAllocationCount();
+  this->updateTransforms();
+
+  // Pixels per unit at unit distance, from the projection the frame
+  // actually draws with. projection[1][1] is 1 / tan(fovy / 2).
+  float pixelsPerUnit = world.screenHeight * 0.5f * frame.projection[1][1];
+  glm::vec3 cameraPosition(frame.cameraPosition);
+
+  // World space spheres of the node meshes. They come in node order,
+  // each node's matrix is worked out once.
+  int currentNode = SCENE_NO_PARENT;
+  glm::mat4 matrix(1.0f);
+  float scale = 1.0f;
+
+  for(GLuint i = 0; i < this->mNodeMeshes.size(); i++) {
+    const NodeMesh& nodeMesh = this->mNodeMeshes[i];
+    if((int)nodeMesh.node != currentNode) {
+      currentNode = (int)nodeMesh.node;
+      matrix = transform * this->mSceneGraph.worldMatrix(nodeMesh.node);
+      // The matrix's largest axis scale
+      scale = std::max(glm::length(glm::vec3(matrix[0])),
+		       std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+    }
+
+    this->mMeshSpheres[i] = transformBoundingSphere(this->mMeshes[nodeMesh.mesh]->getBoundingSphere(), matrix);
+    this->mMeshScales[i] = scale;
+    this->mMeshSphereList.set(i, this->mMeshSpheres[i]);
+  }
+
+  // Every node mesh at once, several spheres per instruction
+  this->mVisibleMeshes.clear();
+  if(frustum != nullptr) {
+    std::fill(this->mMeshLods.begin(), this->mMeshLods.end(), MESH_CULLED);
+    frustum->cull(this->mMeshSphereList, this->mVisibleMeshes);
+  } else {
+    for(GLuint i = 0; i < this->mNodeMeshes.size(); i++) {
+      this->mVisibleMeshes.push_back(i);
+    }
   }
+
+  for(GLuint i : this->mVisibleMeshes) {
+    Mesh* mesh = this->mMeshes[this->mNodeMeshes[i].mesh];
+    const BoundingSphere& sphere = this->mMeshSpheres[i];
+
+    // The nearest the mesh can get, a camera inside it gets full detail
+    float distance = glm::length(sphere.center - cameraPosition) - sphere.radius;
+
+    GLuint lod = 0;
+    while(distance > 0.0f && lod + 1 < mesh->getLodCount() &&
+	  mesh->getLod(lod + 1).error * this->mMeshScales[i] / distance * pixelsPerUnit <= LOD_PIXEL_ERROR) {
+      lod++;
+    }
+    this->mMeshLods[i] = lod;
+  }
+
+  this->drawMeshes(shader, transform);
+  this->mDrawStats.heapAllocations = heapAllocationCount() - heapAllocations;
 }
 
-void Model::loadModel(std::string path) {
-  // Read file via ASSIMP
-  Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+void Model::drawInstanced(Shader* shader, const InstanceBuffer& instances, GLuint lod) {
+  size_t heapAllocations = heapAllocationCount();
+  this->updateTransforms();
+  std::fill(this->mMeshLods.begin(), this->mMeshLods.end(), lod);
+  this->drawMeshes(shader, glm::mat4(1.0f), &instances);
+  this->mDrawStats.heapAllocations = heapAllocationCount() - heapAllocations;
+}
+
+void Model::updateTransforms() {
+  if(this->mSceneGraph.updateWorldMatrices() == 0) {
+    return;
+  }
+
+  BoundingBox& box = this->mBoundingBox;
+  box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+  for(GLuint i = 0; i < this->mNodeMeshes.size(); i++) {
+    const glm::mat4& world = this->mSceneGraph.worldMatrix(this->mNodeMeshes[i].node);
+    BoundingBox meshBox = transformBoundingBox(this->mMeshes[this->mNodeMeshes[i].mesh]->getBoundingBox(), world);
+    box.min = i == 0 ? meshBox.min : glm::min(box.min, meshBox.min);
+    box.max = i == 0 ? meshBox.max : glm::max(box.max, meshBox.max);
+  }
+
+  // A sphere around the box centre that holds every mesh's sphere
+  this->mBoundingSphere = { (box.min + box.max) * 0.5f, 0.0f };
+  for(auto& nodeMesh : this->mNodeMeshes) {
+    BoundingSphere sphere = transformBoundingSphere(this->mMeshes[nodeMesh.mesh]->getBoundingSphere(),
+						    this->mSceneGraph.worldMatrix(nodeMesh.node));
+    this->mBoundingSphere.radius = std::max(this->mBoundingSphere.radius,
+					    glm::length(sphere.center - this->mBoundingSphere.center) + sphere.radius);
+  }
+}
 
-  // Check for errors
-  if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-    std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+void Model::drawMeshes(Shader* shader, const glm::mat4& transform, const InstanceBuffer* instances) {
+  DrawStats stats = { 0, 0, 0, 0, 0, {}, 0, 0 };
+  if(instances != nullptr && instances->size() == 0) {
+    this->mDrawStats = stats;
     return;
   }
 
+  // Every mesh draws from the arena's buffers, one bind covers them all
+  glBindVertexArray(this->mArena->vertexArray(this->mVertexFormat));
+  stats.vertexArrayBinds++;
+
+  GLsizei instanceCount = 1;
+  if(instances != nullptr) {
+    instances->bind();
+    instanceCount = instances->size();
+  }
+
+  if(this->mPackTextures) {
+    // Arrays stay bound from one mesh to the next, only a different array costs a bind
+    shader->setInt(UNIFORM("texture_diffuse_array"), 0);
+    shader->setInt(UNIFORM("texture_specular_array"), 1);
+  }
+
+  // Nodes with the same world matrix share an upload, the shader skips it
+  int currentNode = SCENE_NO_PARENT;
+
+  GLuint boundArrays[2] = { 0, 0 };
+  for(GLuint i = 0; i < this->mNodeMeshes.size(); i++) {
+    if(this->mMeshLods[i] == MESH_CULLED) {
+      stats.culledMeshes++;
+      continue;
+    }
+
+    const NodeMesh& nodeMesh = this->mNodeMeshes[i];
+    if((int)nodeMesh.node != currentNode) {
+      currentNode = (int)nodeMesh.node;
+      shader->setMat4(UNIFORM("model"), transform * this->mSceneGraph.worldMatrix(nodeMesh.node));
+    }
+
+    Mesh* mesh = this->mMeshes[nodeMesh.mesh];
+    if(!this->mPackTextures) {
+      mesh->draw(shader, &stats, this->mMeshLods[i], instanceCount);
+      continue;
+    }
+
+    const MaterialLayers& layers = mesh->getMaterialLayers();
+    GLuint arrays[2] = { layers.diffuseArray, layers.specularArray };
+
+    for(GLuint unit = 0; unit < 2; unit++) {
+      if(arrays[unit] != 0 && arrays[unit] != boundArrays[unit]) {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[unit]);
+	boundArrays[unit] = arrays[unit];
+	stats.textureBinds++;
+      }
+    }
+
+    mesh->drawGeometry(&stats, this->mMeshLods[i], instanceCount);
+  }
+
+  for(GLuint unit = 0; unit < 2; unit++) {
+    if(boundArrays[unit] != 0) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+      stats.textureBinds++;
+    }
+  }
+
+  if(instances != nullptr) {
+    instances->unbind();
+  }
+  glBindVertexArray(0);
+  stats.vertexArrayBinds++;
+  this->mDrawStats = stats;
+}
+
+void Model::loadModel(std::string path) {
   // Retrieve the directory path of the filepath
   this->mDirectory = path.substr(0, path.find_last_of('/'));
 
-  // Process ASSIMP's root node recursively
-  this->processNode(scene->mRootNode, scene);
-}
+  std::vector<ModelMeshData> meshes;
+  std::vector<ModelNodeData> nodes;
+  std::string cachePath = modelCachePath(path);
+  uint64_t sourceHash = 0;
+  bool hashed = hashModelSource(path, sourceHash);
+
+  ModelCache cache;
+  if(hashed && cache.open(cachePath, sourceHash, MODEL_IMPORT_FLAGS)) {
+    for(uint32_t meshIndex = 0; meshIndex < cache.meshCount(); meshIndex++) {
+      meshes.push_back(cache.meshData(meshIndex));
+    }
+    nodes = cache.nodeData();
+  } else {
+    // Read file via ASSIMP
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+
+    // Check for errors
+    if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+      std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+      return;
+    }
+
+    // Every mesh is converted once, however many nodes draw it
+    std::vector<aiMesh*> sceneMeshes(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+    auto conversionStart = std::chrono::steady_clock::now();
+    this->processMeshes(sceneMeshes, scene, meshes);
+    std::chrono::duration<double, std::milli> conversionTime = std::chrono::steady_clock::now() - conversionStart;
+    this->mGeometryStats.conversionMilliseconds = conversionTime.count();
+
+    // Process ASSIMP's root node recursively
+    this->processNode(scene->mRootNode, SCENE_NO_PARENT, nodes);
+
+    // Not fatal, the next run just imports again
+    if(hashed && !writeModelCache(cachePath, meshes, nodes, sourceHash, MODEL_IMPORT_FLAGS)) {
+      std::cout << "Could not write model cache: " << cachePath << std::endl;
+    }
+  }
+
+  // Vertex cache misses and referenced vertices of all meshes, the model's
+  // ACMR and ATVR weigh each mesh by its triangles and vertices
+  double importedMisses = 0.0, misses = 0.0;
+  size_t triangles = 0, referencedVertices = 0;
+
+  // GL buffers and texture loads stay on the context thread
+  for(GLuint meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+    size_t meshTriangles = meshes[meshIndex].lods[0].indexCount / 3;
+    importedMisses += meshes[meshIndex].importedCacheStats.acmr * meshTriangles;
+    misses += meshes[meshIndex].cacheStats.acmr * meshTriangles;
+    triangles += meshTriangles;
+    referencedVertices += meshes[meshIndex].vertices.size();
+    this->mGeometryStats.importedVertices += meshes[meshIndex].importedVertexCount;
+    this->mGeometryStats.importedVertexBytes += meshes[meshIndex].importedVertexCount * sizeof(Vertex);
+    this->mGeometryStats.importedIndexBytes += meshes[meshIndex].lods[0].indexCount * sizeof(GLuint);
+    for(GLuint lod = 0; lod < meshes[meshIndex].lods.size() && lod < MESH_MAX_LODS; lod++) {
+      this->mGeometryStats.lodTriangles[lod] += meshes[meshIndex].lods[lod].indexCount / 3;
+    }
+    this->mMeshes.push_back(this->createMesh(meshes[meshIndex]));
+    this->mGeometryStats.vertices += this->mMeshes.back()->getVertexCount();
+    this->mGeometryStats.vertexBytes += this->mMeshes.back()->getVertexBufferBytes();
+    this->mGeometryStats.indexBytes += this->mMeshes.back()->getIndexBufferBytes();
+  }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-  // Process each mesh located at the current node
-  for(GLuint meshIndex = 0; meshIndex < node->mNumMeshes; meshIndex++) {
-    // The node object only contains indices to index the actual objects in the scene.
-    // The scene contains all the data, node is just to keep stuff organized (like relations between nodes)
-    aiMesh* mesh = scene->mMeshes[node->mMeshes[meshIndex]];
-    this->mMeshes.push_back(this->processMesh(mesh, scene));
+  if(triangles > 0) {
+    this->mGeometryStats.importedCacheStats = { (float)(importedMisses / triangles),
+						(float)(importedMisses / referencedVertices) };
+    this->mGeometryStats.cacheStats = { (float)(misses / triangles), (float)(misses / referencedVertices) };
   }
 
-  if(node->mNumChildren == 0) { return; }
-  
-  // After we've processed all of the meshes (if any) we then recursively process each of the children nodes
+  // The nodes keep the file's order, which is depth first
+  std::vector<int> nodeIndices(nodes.size(), SCENE_NO_PARENT);
+  for(GLuint nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++) {
+    const ModelNodeData& node = nodes[nodeIndex];
+    int parent = node.parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : nodeIndices[node.parent];
+    if(node.parent != SCENE_NO_PARENT && parent == SCENE_NO_PARENT) {
+      continue; // Its parent was left out
+    }
+
+    nodeIndices[nodeIndex] = this->mSceneGraph.addNode(parent, node.local, node.name);
+    if(nodeIndices[nodeIndex] == SCENE_NO_PARENT) {
+      continue;
+    }
+    for(GLuint meshIndex : node.meshes) {
+      this->mNodeMeshes.push_back({ (GLuint)nodeIndices[nodeIndex], meshIndex });
+    }
+  }
+
+  std::cout << "Model: " << path << std::endl
+	    << "Vertices: " << this->mGeometryStats.importedVertices
+	    << " -> " << this->mGeometryStats.vertices << std::endl
+	    << "Vertex bytes: " << this->mGeometryStats.importedVertexBytes
+	    << " -> " << this->mGeometryStats.vertexBytes << std::endl
+	    << "Index bytes: " << this->mGeometryStats.importedIndexBytes
+	    << " -> " << this->mGeometryStats.indexBytes << std::endl
+	    << "LOD triangles:";
+  for(GLuint lod = 0; lod < MESH_MAX_LODS && this->mGeometryStats.lodTriangles[lod] > 0; lod++) {
+    std::cout << " " << this->mGeometryStats.lodTriangles[lod];
+  }
+  std::cout << std::endl
+	    << "Vertex cache ACMR: " << this->mGeometryStats.importedCacheStats.acmr
+	    << " -> " << this->mGeometryStats.cacheStats.acmr
+	    << ", ATVR: " << this->mGeometryStats.importedCacheStats.atvr
+	    << " -> " << this->mGeometryStats.cacheStats.atvr << std::endl;
+  for(GLuint meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+    std::cout << " mesh " << meshIndex << ": ACMR " << meshes[meshIndex].importedCacheStats.acmr
+	      << " -> " << meshes[meshIndex].cacheStats.acmr
+	      << ", ATVR " << meshes[meshIndex].importedCacheStats.atvr
+	      << " -> " << meshes[meshIndex].cacheStats.atvr << std::endl;
+  }
+  if(this->mGeometryStats.conversionMilliseconds > 0.0) {
+    std::cout << "Mesh conversion: " << this->mGeometryStats.conversionMilliseconds
+	      << " ms on " << this->mThreadCount << " threads" << std::endl;
+  }
+  this->mMeshLods.assign(this->mNodeMeshes.size(), 0);
+  this->mMeshSpheres.assign(this->mNodeMeshes.size(), { glm::vec3(0.0f), 0.0f });
+  this->mMeshScales.assign(this->mNodeMeshes.size(), 1.0f);
+  for(GLuint i = 0; i < this->mNodeMeshes.size(); i++) {
+    this->mMeshSphereList.add(this->mMeshSpheres[i]);
+  }
+  this->mVisibleMeshes.reserve(this->mNodeMeshes.size());
+  this->updateTransforms();
+
+  if(this->mPackTextures) {
+    this->packMaterials();
+  }
+}
+
+void Model::processNode(aiNode* node, int parent, std::vector<ModelNodeData>& nodes) {
+  ModelNodeData nodeData = {};
+  nodeData.parent = parent;
+  nodeData.name = node->mName.C_Str();
+
+  // Shear, if any, does not survive the decomposition
+  aiVector3D scaling;
+  aiQuaternion rotation;
+  aiVector3D position;
+  node->mTransformation.Decompose(scaling, rotation, position);
+  nodeData.local.translation = glm::vec3(position.x, position.y, position.z);
+  nodeData.local.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+  nodeData.local.scale = glm::vec3(scaling.x, scaling.y, scaling.z);
+
+  // The node object only contains indices to index the actual objects in the scene.
+  // The scene contains all the data, node is just to keep stuff organized (like relations between nodes)
+  nodeData.meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+  int nodeIndex = (int)nodes.size();
+  nodes.push_back(std::move(nodeData));
+
+  // After we've processed the node we then recursively process each of the children nodes
   for(GLuint childIndex = 0; childIndex < node->mNumChildren; childIndex++) {
-    this->processNode(node->mChildren[childIndex], scene);
+    this->processNode(node->mChildren[childIndex], nodeIndex, nodes);
+  }
+}
+
+void Model::processMeshes(const std::vector<aiMesh*>& meshes, const aiScene* scene,
+			  std::vector<ModelMeshData>& meshData) {
+  meshData.resize(meshes.size());
+
+  // Meshes are handed out one at a time since their sizes vary a lot,
+  // and each result goes to the mesh's own slot
+  std::atomic<size_t> nextMesh(0);
+  auto convert = [&]() {
+    for(size_t meshIndex = nextMesh++; meshIndex < meshes.size(); meshIndex = nextMesh++) {
+      meshData[meshIndex] = this->processMesh(meshes[meshIndex], scene);
+    }
+  };
+
+  unsigned int threadCount = (unsigned int)std::min((size_t)this->mThreadCount, meshes.size());
+  if(threadCount <= 1) {
+    convert();
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  for(unsigned int i = 0; i < threadCount; i++) {
+    workers.push_back(std::thread(convert));
+  }
+  for(auto& worker : workers) {
+    worker.join();
   }
 }
 
-Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+ModelMeshData Model::processMesh(aiMesh* mesh, const aiScene* scene) {
   // Data to fill
-  std::vector<Vertex *> vertices = {};
-  std::vector<GLuint *> indices = {};
-  std::vector<Texture *> textures = {};
+  ModelMeshData meshData = {};
+  meshData.vertices.reserve(mesh->mNumVertices);
+  meshData.indices.reserve(mesh->mNumFaces * 3);
 
   // Walk throug each of the mesh's vertices
   for(GLuint vertexIndex = 0; vertexIndex < mesh->mNumVertices; vertexIndex++) {
@@ -81,8 +422,10 @@ Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     } else {
       vertex.texCoords = glm::vec2(0.0f, 0.0f);
     }
-    
-    vertices.push_back(&vertex);
+
+    meshData.boundsMin = vertexIndex == 0 ? vertex.position : glm::min(meshData.boundsMin, vertex.position);
+    meshData.boundsMax = vertexIndex == 0 ? vertex.position : glm::max(meshData.boundsMax, vertex.position);
+    meshData.vertices.push_back(vertex);
   }
 
   // Now walk through each of the mesh's faces (a face is a mesh its triangle)
@@ -91,69 +434,133 @@ Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     aiFace face = mesh->mFaces[faceIndex];
     // Retrieve all indices of the face and store them in the indices vector
     for(GLuint index = 0; index < face.mNumIndices; index++) {
-      indices.push_back(&face.mIndices[index]);
+      meshData.indices.push_back(face.mIndices[index]);
     }
   }
 
-  // Process material
+  // Assimp gives every face its own corners, most of them are shared
+  meshData.importedVertexCount = meshData.vertices.size();
+  weldVertices(meshData.vertices, meshData.indices);
+
+  // Then order the triangles for the post transform cache and for overdraw,
+  // and the vertices for the order the triangles fetch them in. Meshes that
+  // come in a better order than the passes find (already optimized ones)
+  // keep it.
+  meshData.importedCacheStats = analyzeVertexCache(meshData.indices, meshData.vertices.size());
+  std::vector<GLuint> importedIndices = meshData.indices;
+  optimizeVertexCache(meshData.indices, meshData.vertices.size());
+  optimizeOverdraw(meshData.indices, meshData.vertices);
+  // Reordering the vertices later doesn't change which ones the cache holds
+  meshData.cacheStats = analyzeVertexCache(meshData.indices, meshData.vertices.size());
+  if(meshData.cacheStats.acmr >= meshData.importedCacheStats.acmr) {
+    meshData.indices.swap(importedIndices);
+    meshData.cacheStats = meshData.importedCacheStats;
+  }
+
+  // Coarser levels for the distance, appended to the same index buffer.
+  // The vertices are then ordered by LOD 0, the levels share them.
+  generateLods(meshData.vertices, meshData.indices, meshData.lods);
+  optimizeVertexFetch(meshData.vertices, meshData.indices);
+
+  // Process material, the diffuse maps first and then the specular ones
   if(mesh->mMaterialIndex > 0) {
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    for(aiTextureType textureType : { aiTextureType_DIFFUSE, aiTextureType_SPECULAR }) {
+      for(GLuint textureIndex = 0; textureIndex < material->GetTextureCount(textureType); textureIndex++) {
+	aiString str;
+	material->GetTexture(textureType, textureIndex, &str);
+	meshData.textures.push_back({ textureType, str.C_Str() });
+      }
+    }
+  }
+
+  return meshData;
+}
+
+Mesh* Model::createMesh(ModelMeshData& meshData) {
+  std::vector<Texture *> textures = {};
+
+  if(this->mPackTextures) {
+    // Packed models only note the files here, packMaterials loads them.
+    // The array shader samples one texture of each type.
+    MeshMaterial meshMaterial = {};
+    for(auto& reference : meshData.textures) {
+      std::string& path = reference.type == aiTextureType_DIFFUSE ? meshMaterial.diffusePath : meshMaterial.specularPath;
+      if(path.empty()) {
+	path = this->mDirectory + '/' + reference.file;
+      }
+    }
+    this->mMeshMaterials.push_back(meshMaterial);
+  } else {
     // We assume a convention for sampler names in the shaders. Each diffuse texture should be named
     // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER
     // Same applies to ohter texture as the following list summarizes:
     // Diffuse: texture_difusseN
     // Specular: texture_specularN
     // Normal: texture_normalN
-
-    // 1. Diffuse maps
-    aiTextureType textureType = aiTextureType_DIFFUSE;
-    std::vector<Texture *> diffuseMaps = this->loadMaterialTextures(material,
-								    textureType,
-								    "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-    // 2. Specular maps
-    textureType = aiTextureType_SPECULAR;
-    std::vector<Texture *> specularMaps = this->loadMaterialTextures(material, 
-								     textureType,
-								     "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    for(auto& reference : meshData.textures) {
+      std::string typeName = reference.type == aiTextureType_DIFFUSE ? "texture_diffuse" : "texture_specular";
+      textures.push_back(this->loadMaterialTexture(reference.file, typeName));
+    }
   }
 
   // Return a mesh object created from the extracted mesh data
-  return new Mesh(vertices, indices, textures);
+  return new Mesh(std::move(meshData.vertices), std::move(meshData.indices), textures, this->mVertexFormat,
+		  this->mArena, std::move(meshData.lods));
 }
 
-std::vector<Texture *> Model::loadMaterialTextures(aiMaterial* material,
-						   aiTextureType type,
-						   std::string typeName) {
-  std::vector<Texture *> textures = {};
-  
-  for(GLuint textureIndex = 0; textureIndex < material->GetTextureCount(type); textureIndex++) {
-    aiString str;
-    GLboolean skip = false;
-    material->GetTexture(type, textureIndex, &str);
-
-    for(GLuint i = 0; i < this->mTexturesLoaded.size(); i++) {
-
-      if(this->mTexturesLoaded[i]->path == str) {
-	textures.push_back(this->mTexturesLoaded[i]);
-	skip = true;
-	break;
+void Model::packMaterials() {
+  // Every file becomes one layer, however many meshes use it
+  std::vector<std::string> paths;
+  std::unordered_map<std::string, size_t> pathIndices;
+  for(auto& meshMaterial : this->mMeshMaterials) {
+    for(const std::string* path : { &meshMaterial.diffusePath, &meshMaterial.specularPath }) {
+      if(!path->empty() && pathIndices.find(*path) == pathIndices.end()) {
+	pathIndices[*path] = paths.size();
+	paths.push_back(*path);
       }
     }
+  }
 
-    if(!skip) {
-      Texture texture;
-
-      texture.id = this->mTextureLoader.loadTexture((std::string)this->mDirectory.c_str() + str.C_Str());
-      texture.type = typeName;
-      texture.path = str;
-      textures.push_back(&texture);
-      this->mTexturesLoaded.push_back(&texture);
+  std::vector<TextureArrayLayer> layers = this->mTextureLoader.loadTextureArrays(paths);
+  for(auto& layer : layers) {
+    if(layer.arrayId != 0 &&
+       std::find(this->mTextureArrays.begin(), this->mTextureArrays.end(), layer.arrayId) == this->mTextureArrays.end()) {
+      this->mTextureArrays.push_back(layer.arrayId);
     }
   }
 
-  return textures;
+  for(GLuint i = 0; i < this->mMeshes.size(); i++) {
+    MaterialLayers meshLayers = { 0, 0, -1, -1 };
+
+    const std::string& diffusePath = this->mMeshMaterials[i].diffusePath;
+    if(!diffusePath.empty()) {
+      const TextureArrayLayer& layer = layers[pathIndices[diffusePath]];
+      meshLayers.diffuseArray = layer.arrayId;
+      meshLayers.diffuseLayer = layer.layer;
+    }
+
+    const std::string& specularPath = this->mMeshMaterials[i].specularPath;
+    if(!specularPath.empty()) {
+      const TextureArrayLayer& layer = layers[pathIndices[specularPath]];
+      meshLayers.specularArray = layer.arrayId;
+      meshLayers.specularLayer = layer.layer;
+    }
+
+    this->mMeshes[i]->setMaterialLayers(meshLayers);
+  }
 }
 
+Texture* Model::loadMaterialTexture(const std::string& file, std::string typeName) {
+  // The cache loads each file once no matter how many meshes or models use it
+  TextureHandle handle = TextureCache::instance().acquire(this->mDirectory + '/' + file,
+							  this->mTextureLoader);
+
+  Texture* texture = new Texture();
+  texture->id = handle.id();
+  texture->type = typeName;
+  texture->path = aiString(file);
+  this->mTextureHandles.push_back(handle);
+
+  return texture;
+}
@@ -4,6 +4,12 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
 
 // GLAD
 #include <glad/glad.h>
@@ -14,37 +20,168 @@
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "ModelCache.h"
+#include "MeshOptimizer.h"
 #include "TextureLoader.h"
+#include "TextureCache.h"
+#include "World.h"
+#include "FrameData.h"
+#include "Frustum.h"
+#include "SceneGraph.h"
+#include "InstanceBuffer.h"
 
+// Assimp post processing every model is imported with, part of the cache key
+#define MODEL_IMPORT_FLAGS (aiProcess_Triangulate | aiProcess_FlipUVs)
+
+// Screen space error a LOD may show, in pixels
+#define LOD_PIXEL_ERROR 1.0f
+
+// Marks a node mesh in Model's LOD selection that frustum culling left out
+#define MESH_CULLED (~0u)
+
+// What welding, 16 bit indices and packed vertices saved on a model
+struct GeometryStats {
+  size_t importedVertices;
+  size_t vertices;
+  size_t importedVertexBytes; // As float vertices
+  size_t vertexBytes;
+  size_t importedIndexBytes;  // All 32 bit, as imported
+  size_t indexBytes;          // Every LOD
+  size_t lodTriangles[MESH_MAX_LODS]; // Of the meshes that have the level
+  double conversionMilliseconds; // processMeshes, 0 when the cache had the model
+  VertexCacheStats importedCacheStats; // LOD 0 of all meshes before the index passes
+  VertexCacheStats cacheStats;         // and after them
+};
 
 class Model {
  public:
-  // Constructor, expects a filepath to a 3D model
-  Model(std::string path, TextureLoader& loader);
+  // Constructor, expects a filepath to a 3D model.
+  // With packTextures the material textures are packed into texture
+  // arrays at load time and the model needs a shader that samples
+  // texture_diffuse_array/texture_specular_array (see shaders/modelArray.*)
+  // With VertexFormat::PACKED16 the vertices take half the memory and the
+  // model needs shaders/modelArrayPacked.vert.
+  // The imported meshes are converted on threadCount threads, 0 means
+  // one per core.
+  // All meshes live in one geometry arena and draw with a single VAO bind.
+  // Without an arena the model creates its own, pass one to share it with
+  // other models (it must outlive them).
+  // The file's node hierarchy is kept as a scene graph, each mesh draws
+  // with the world matrix of the node (or nodes) holding it.
+  Model(std::string path, TextureLoader& loader, bool packTextures = false,
+	VertexFormat vertexFormat = VertexFormat::FLOAT32, unsigned int threadCount = 0,
+	GeometryArena* arena = nullptr);
+
+  // Draws the model, and thus all its meshes, at full detail. Sets the
+  // shader's model matrix to transform times each node's world matrix.
+  void draw(Shader* shader, const glm::mat4& transform = glm::mat4(1.0f));
+
+  // Draws every mesh at the coarsest LOD whose error, projected with the
+  // frame's camera and projection onto the world's screen height, stays
+  // within LOD_PIXEL_ERROR. transform is the model matrix, applied like
+  // above. With a frustum (world space) the meshes whose bounds lie
+  // outside it are not drawn, all of them are tested in one Frustum::cull.
+  void draw(Shader* shader, const Game::World& world, const FrameData& frame, const glm::mat4& transform,
+	    const Frustum* frustum = nullptr);
+
+  // Draws every instance with one draw call per mesh. Needs an instanced
+  // shader (shaders/modelArrayInstanced.vert or
+  // shaders/modelArrayPackedInstanced.vert), which applies each instance's
+  // matrix on top of the node matrices. All instances draw at the same
+  // LOD, culling them or sorting them into buffers by distance is up to
+  // the caller.
+  void drawInstanced(Shader* shader, const InstanceBuffer& instances, GLuint lod = 0);
+
+  // The node hierarchy. Changed local transforms take effect on the next
+  // draw, which only recomputes the world matrices below changed nodes.
+  inline SceneGraph& getSceneGraph() { return this->mSceneGraph; }
+
+  // Texture binds, VAO binds, attribute updates, draw calls, triangles
+  // (in all and per LOD), culled meshes and heap allocations of the last draw
+  inline DrawStats getDrawStats() { return this->mDrawStats; }
 
-  // Draws the model, and thus all its meshes
-  void draw(Shader* shader);
+  // Vertex counts and buffer sizes as imported and as uploaded
+  inline GeometryStats getGeometryStats() { return this->mGeometryStats; }
+
+  // Model space bounds of all meshes at their nodes, as of the last draw
+  inline const BoundingBox& getBoundingBox() { return this->mBoundingBox; }
+  inline const BoundingSphere& getBoundingSphere() { return this->mBoundingSphere; }
 
  private:
   TextureLoader mTextureLoader;
   // Model data
   std::vector<Mesh *> mMeshes;
   std::string mDirectory;
-  std::vector<Texture *> mTexturesLoaded;
+  // Keeps the model's textures alive in the shared cache
+  std::vector<TextureHandle> mTextureHandles;
+  // Set when the model was not given an arena to share
+  std::unique_ptr<GeometryArena> mOwnedArena;
+  GeometryArena* mArena;
+  DrawStats mDrawStats;
+  GeometryStats mGeometryStats;
+  // Every mesh at every node that holds it, in node order
+  struct NodeMesh {
+    GLuint node;
+    GLuint mesh;
+  };
+  SceneGraph mSceneGraph;
+  std::vector<NodeMesh> mNodeMeshes;
+  // LOD each node mesh draws with next, or MESH_CULLED
+  std::vector<GLuint> mMeshLods;
+  // The LOD draw's world space node mesh bounds and matrix scales, and the
+  // same spheres laid out for Frustum::cull with the indices it kept.
+  // Sized at load, so drawing doesn't allocate.
+  std::vector<BoundingSphere> mMeshSpheres;
+  std::vector<float> mMeshScales;
+  BoundingSphereList mMeshSphereList;
+  std::vector<GLuint> mVisibleMeshes;
+  BoundingBox mBoundingBox;
+  BoundingSphere mBoundingSphere;
+
+  // Packed textures: the diffuse and specular file of each mesh, in
+  // mesh order, and the arrays they ended up in
+  struct MeshMaterial {
+    std::string diffusePath;
+    std::string specularPath;
+  };
+  bool mPackTextures;
+  VertexFormat mVertexFormat;
+  unsigned int mThreadCount;
+  std::vector<MeshMaterial> mMeshMaterials;
+  std::vector<GLuint> mTextureArrays;
 
   // Loads a model with supported ASSIMP extensions from file and stores
-  // the resulting meshes in the meshes vector.
+  // the resulting meshes in the meshes vector. A current model cache next
+  // to the file is used instead of Assimp, and written when there is none.
   void loadModel(std::string path);
 
-  // Processes a node in a recursive fashion. Processes each individual mesh
-  // located at the node and repeats this process on its children nodes (if any)
-  void processNode(aiNode* node, const aiScene* scene);
-  Mesh* processMesh(aiMesh* mesh, const aiScene* scene);
+  // Walks the nodes in a recursive fashion and appends each one, with its
+  // local transform and the indices of its meshes, in depth first order
+  void processNode(aiNode* node, int parent, std::vector<ModelNodeData>& nodes);
+
+  // Converts the collected meshes on mThreadCount threads. The output
+  // keeps the input order, whichever thread finished first.
+  void processMeshes(const std::vector<aiMesh*>& meshes, const aiScene* scene,
+		     std::vector<ModelMeshData>& meshData);
+
+  // Only reads the scene, so several threads can run it at once
+  ModelMeshData processMesh(aiMesh* mesh, const aiScene* scene);
+
+  // Creates the GL mesh and gets its textures, or notes them for packing
+  Mesh* createMesh(ModelMeshData& meshData);
+
+  // Brings the world matrices, and with them the bounds, up to date
+  void updateTransforms();
+
+  // Draws every node mesh at its entry in mMeshLods, except the culled
+  // ones, once or once per instance
+  void drawMeshes(Shader* shader, const glm::mat4& transform, const InstanceBuffer* instances = nullptr);
+
+  // Builds the texture arrays once every mesh's material is known
+  void packMaterials();
 
-  // Checks all material textures of a given type and loads the textures if they're not loaded yet
+  // Gets a material texture from the texture cache
   // The required info is returned as a Texture struct
-  std::vector<Texture *> loadMaterialTextures(aiMaterial* material,
-					    aiTextureType type,
-					    std::string typeName);
+  Texture* loadMaterialTexture(const std::string& file, std::string typeName);
 };
 
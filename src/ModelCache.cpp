@@ -0,0 +1,350 @@
+#include "ModelCache.h"
+
+// STD
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+namespace {
+  size_t alignOffset(size_t offset) {
+    return (offset + MODEL_CACHE_ALIGNMENT - 1) & ~(size_t)(MODEL_CACHE_ALIGNMENT - 1);
+  }
+
+  // True if count elements of elementSize bytes at offset lie inside the file
+  bool insideFile(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+  }
+}
+
+bool ModelCache::open(const std::string& path, uint64_t sourceHash, uint32_t importFlags) {
+  if (!this->mFile.open(path)) {
+    return false;
+  }
+
+  size_t size = this->mFile.size();
+
+  if (size < sizeof(ModelCacheHeader)) {
+    this->mFile.close();
+    return false;
+  }
+
+  const ModelCacheHeader& header = this->header();
+  if (memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != MODEL_CACHE_VERSION ||
+      header.vertexSize != sizeof(Vertex) ||
+      header.importFlags != importFlags ||
+      header.sourceHash != sourceHash ||
+      !insideFile(sizeof(ModelCacheHeader), header.meshCount, sizeof(ModelCacheMesh), size) ||
+      !insideFile(header.nodeOffset, header.nodeCount, sizeof(ModelCacheNode), size) ||
+      !insideFile(header.nodeMeshOffset, header.nodeMeshCount, sizeof(uint32_t), size)) {
+    this->mFile.close();
+    return false;
+  }
+
+  // Every block has to lie inside the file
+  for (uint32_t i = 0; i < header.meshCount; i++) {
+    const ModelCacheMesh& mesh = this->mesh(i);
+    if (!insideFile(mesh.vertexOffset, mesh.vertexCount, sizeof(Vertex), size) ||
+	!insideFile(mesh.indexOffset, mesh.indexCount, sizeof(GLuint), size) ||
+	!insideFile(mesh.textureOffset, mesh.textureCount, sizeof(ModelCacheTexture), size) ||
+	mesh.lodCount == 0 || mesh.lodCount > MESH_MAX_LODS) {
+      this->mFile.close();
+      return false;
+    }
+
+    for (uint32_t j = 0; j < mesh.lodCount; j++) {
+      if (mesh.lods[j].indexOffset > mesh.indexCount || mesh.lods[j].indexCount > mesh.indexCount - mesh.lods[j].indexOffset) {
+	this->mFile.close();
+	return false;
+      }
+    }
+
+    // The LODs are ranges of these, so one pass covers every draw
+    const GLuint* indices = (const GLuint*)(this->mFile.data() + mesh.indexOffset);
+    if (mesh.indexCount > 0 && *std::max_element(indices, indices + mesh.indexCount) >= mesh.vertexCount) {
+      this->mFile.close();
+      return false;
+    }
+
+    const ModelCacheTexture* textures = (const ModelCacheTexture*)(this->mFile.data() + mesh.textureOffset);
+    for (uint32_t j = 0; j < mesh.textureCount; j++) {
+      if (!insideFile(textures[j].pathOffset, textures[j].pathLength, 1, size)) {
+	this->mFile.close();
+	return false;
+      }
+    }
+  }
+
+  // Parents before children, and meshes that exist
+  const ModelCacheNode* nodes = (const ModelCacheNode*)(this->mFile.data() + header.nodeOffset);
+  const uint32_t* nodeMeshes = (const uint32_t*)(this->mFile.data() + header.nodeMeshOffset);
+  for (uint32_t i = 0; i < header.nodeCount; i++) {
+    const ModelCacheNode& node = nodes[i];
+    if ((node.parent != SCENE_NO_PARENT && (node.parent < 0 || (uint32_t)node.parent >= i)) ||
+	node.meshOffset > header.nodeMeshCount || node.meshCount > header.nodeMeshCount - node.meshOffset ||
+	!insideFile(node.nameOffset, node.nameLength, 1, size)) {
+      this->mFile.close();
+      return false;
+    }
+
+    for (uint32_t j = 0; j < node.meshCount; j++) {
+      if (nodeMeshes[node.meshOffset + j] >= header.meshCount) {
+	this->mFile.close();
+	return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+const ModelCacheHeader& ModelCache::header() const {
+  return *(const ModelCacheHeader*)this->mFile.data();
+}
+
+const ModelCacheMesh& ModelCache::mesh(uint32_t index) const {
+  const ModelCacheMesh* meshes = (const ModelCacheMesh*)(this->mFile.data() + sizeof(ModelCacheHeader));
+  return meshes[index];
+}
+
+ModelMeshData ModelCache::meshData(uint32_t index) const {
+  const ModelCacheMesh& mesh = this->mesh(index);
+  const unsigned char* data = this->mFile.data();
+
+  ModelMeshData meshData;
+  const Vertex* vertices = (const Vertex*)(data + mesh.vertexOffset);
+  meshData.vertices.assign(vertices, vertices + mesh.vertexCount);
+  const GLuint* indices = (const GLuint*)(data + mesh.indexOffset);
+  meshData.indices.assign(indices, indices + mesh.indexCount);
+  for (uint32_t i = 0; i < mesh.lodCount; i++) {
+    meshData.lods.push_back({ mesh.lods[i].indexOffset, mesh.lods[i].indexCount, mesh.lods[i].error });
+  }
+
+  const ModelCacheTexture* textures = (const ModelCacheTexture*)(data + mesh.textureOffset);
+  for (uint32_t i = 0; i < mesh.textureCount; i++) {
+    meshData.textures.push_back({ (aiTextureType)textures[i].type,
+				  std::string((const char*)data + textures[i].pathOffset, textures[i].pathLength) });
+  }
+
+  meshData.importedVertexCount = mesh.importedVertexCount;
+  meshData.importedCacheStats = { mesh.importedAcmr, mesh.importedAtvr };
+  meshData.cacheStats = { mesh.acmr, mesh.atvr };
+  meshData.boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+  meshData.boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+  return meshData;
+}
+
+std::vector<ModelNodeData> ModelCache::nodeData() const {
+  const ModelCacheHeader& header = this->header();
+  const unsigned char* data = this->mFile.data();
+  const ModelCacheNode* nodes = (const ModelCacheNode*)(data + header.nodeOffset);
+  const uint32_t* nodeMeshes = (const uint32_t*)(data + header.nodeMeshOffset);
+
+  std::vector<ModelNodeData> nodeData(header.nodeCount);
+  for (uint32_t i = 0; i < header.nodeCount; i++) {
+    const ModelCacheNode& record = nodes[i];
+    ModelNodeData& node = nodeData[i];
+    node.parent = record.parent;
+    node.name.assign((const char*)data + record.nameOffset, record.nameLength);
+    node.local.translation = glm::vec3(record.translation[0], record.translation[1], record.translation[2]);
+    node.local.rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+    node.local.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+    node.meshes.assign(nodeMeshes + record.meshOffset, nodeMeshes + record.meshOffset + record.meshCount);
+  }
+  return nodeData;
+}
+
+bool writeModelCache(const std::string& path, const std::vector<ModelMeshData>& meshes,
+		     const std::vector<ModelNodeData>& nodes, uint64_t sourceHash, uint32_t importFlags) {
+  // Lay the blocks out first so the file can be filled in one go
+  std::vector<ModelCacheMesh> records(meshes.size());
+  size_t offset = sizeof(ModelCacheHeader) + meshes.size() * sizeof(ModelCacheMesh);
+  size_t pathBytes = 0;
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const ModelMeshData& meshData = meshes[i];
+    ModelCacheMesh& record = records[i];
+    record = {};
+
+    offset = alignOffset(offset);
+    record.vertexOffset = offset;
+    record.vertexCount = (uint32_t)meshData.vertices.size();
+    offset += meshData.vertices.size() * sizeof(Vertex);
+
+    offset = alignOffset(offset);
+    record.indexOffset = offset;
+    record.indexCount = (uint32_t)meshData.indices.size();
+    offset += meshData.indices.size() * sizeof(GLuint);
+
+    offset = alignOffset(offset);
+    record.textureOffset = offset;
+    record.textureCount = (uint32_t)meshData.textures.size();
+    record.importedVertexCount = (uint32_t)meshData.importedVertexCount;
+    record.importedAcmr = meshData.importedCacheStats.acmr;
+    record.importedAtvr = meshData.importedCacheStats.atvr;
+    record.acmr = meshData.cacheStats.acmr;
+    record.atvr = meshData.cacheStats.atvr;
+    offset += meshData.textures.size() * sizeof(ModelCacheTexture);
+
+    for (auto& texture : meshData.textures) {
+      pathBytes += texture.file.size();
+    }
+
+    record.lodCount = (uint32_t)std::min(meshData.lods.size(), (size_t)MESH_MAX_LODS);
+    for (uint32_t j = 0; j < record.lodCount; j++) {
+      record.lods[j] = { meshData.lods[j].indexOffset, meshData.lods[j].indexCount, meshData.lods[j].error };
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+      record.boundsMin[axis] = meshData.boundsMin[axis];
+      record.boundsMax[axis] = meshData.boundsMax[axis];
+    }
+  }
+
+  std::vector<ModelCacheNode> nodeRecords(nodes.size());
+  size_t nodeMeshCount = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const ModelNodeData& node = nodes[i];
+    ModelCacheNode& record = nodeRecords[i];
+    record = {};
+    record.parent = node.parent;
+    record.meshOffset = (uint32_t)nodeMeshCount;
+    record.meshCount = (uint32_t)node.meshes.size();
+    record.nameLength = (uint32_t)node.name.size();
+    for (int axis = 0; axis < 3; axis++) {
+      record.translation[axis] = node.local.translation[axis];
+      record.rotation[axis] = node.local.rotation[axis];
+      record.scale[axis] = node.local.scale[axis];
+    }
+    record.rotation[3] = node.local.rotation.w;
+    nodeMeshCount += node.meshes.size();
+    pathBytes += node.name.size();
+  }
+
+  offset = alignOffset(offset);
+  size_t nodeOffset = offset;
+  offset += nodes.size() * sizeof(ModelCacheNode);
+
+  offset = alignOffset(offset);
+  size_t nodeMeshOffset = offset;
+  offset += nodeMeshCount * sizeof(uint32_t);
+
+  // The file and node names go last
+  offset = alignOffset(offset);
+  size_t pathOffset = offset;
+
+  // Zero filled so padding bytes are deterministic too
+  std::vector<unsigned char> file(offset + pathBytes, 0);
+
+  ModelCacheHeader header = {};
+  std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+  header.version = MODEL_CACHE_VERSION;
+  header.importFlags = importFlags;
+  header.sourceHash = sourceHash;
+  header.meshCount = (uint32_t)meshes.size();
+  header.vertexSize = sizeof(Vertex);
+  header.nodeCount = (uint32_t)nodes.size();
+  header.nodeMeshCount = (uint32_t)nodeMeshCount;
+  header.nodeOffset = nodeOffset;
+  header.nodeMeshOffset = nodeMeshOffset;
+
+  glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+  for (size_t i = 0; i < meshes.size(); i++) {
+    boundsMin = i == 0 ? meshes[i].boundsMin : glm::min(boundsMin, meshes[i].boundsMin);
+    boundsMax = i == 0 ? meshes[i].boundsMax : glm::max(boundsMax, meshes[i].boundsMax);
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    header.boundsMin[axis] = boundsMin[axis];
+    header.boundsMax[axis] = boundsMax[axis];
+  }
+
+  std::memcpy(file.data(), &header, sizeof(header));
+  std::memcpy(file.data() + sizeof(header), records.data(), records.size() * sizeof(ModelCacheMesh));
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const ModelMeshData& meshData = meshes[i];
+    const ModelCacheMesh& record = records[i];
+
+    if (!meshData.vertices.empty()) {
+      std::memcpy(file.data() + record.vertexOffset, meshData.vertices.data(), meshData.vertices.size() * sizeof(Vertex));
+    }
+    if (!meshData.indices.empty()) {
+      std::memcpy(file.data() + record.indexOffset, meshData.indices.data(), meshData.indices.size() * sizeof(GLuint));
+    }
+
+    for (size_t j = 0; j < meshData.textures.size(); j++) {
+      const ModelTextureReference& texture = meshData.textures[j];
+      ModelCacheTexture textureRecord = { (uint32_t)texture.type, (uint32_t)texture.file.size(), pathOffset };
+      std::memcpy(file.data() + record.textureOffset + j * sizeof(ModelCacheTexture), &textureRecord, sizeof(textureRecord));
+      std::memcpy(file.data() + pathOffset, texture.file.data(), texture.file.size());
+      pathOffset += texture.file.size();
+    }
+  }
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const ModelNodeData& node = nodes[i];
+    ModelCacheNode& record = nodeRecords[i];
+
+    if (!node.meshes.empty()) {
+      std::memcpy(file.data() + nodeMeshOffset + record.meshOffset * sizeof(uint32_t), node.meshes.data(),
+		  node.meshes.size() * sizeof(uint32_t));
+    }
+
+    record.nameOffset = pathOffset;
+    std::memcpy(file.data() + pathOffset, node.name.data(), node.name.size());
+    pathOffset += node.name.size();
+  }
+  if (!nodeRecords.empty()) {
+    std::memcpy(file.data() + nodeOffset, nodeRecords.data(), nodeRecords.size() * sizeof(ModelCacheNode));
+  }
+
+  std::string temporaryPath = path + ".tmp";
+  std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+  output.write((const char*)file.data(), file.size());
+  output.close();
+  if (!output) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool hashModelSource(const std::string& sourcePath, uint64_t& hash) {
+  MappedFile source;
+  if (!source.open(sourcePath)) {
+    return false;
+  }
+
+  // FNV-1a over 64 bit words rather than bytes, an eighth of the
+  // multiplies on the longest dependency chain of a warm load
+  const uint64_t prime = 1099511628211ULL;
+  hash = 14695981039346656037ULL ^ source.size();
+
+  const unsigned char* data = source.data();
+  size_t size = source.size();
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ data[i]) * prime;
+  }
+
+  return true;
+}
+
+std::string modelCachePath(const std::string& sourcePath) {
+  return std::filesystem::path(sourcePath).replace_extension(MODEL_CACHE_EXTENSION).string();
+}
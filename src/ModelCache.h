@@ -0,0 +1,149 @@
+#pragma once
+
+// STD
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MappedFile.h"
+#include "SceneGraph.h"
+
+// Processed models are written next to their source after the first
+// import and mapped on later loads, so a warm start skips Assimp. Layout:
+//
+//   ModelCacheHeader
+//   ModelCacheMesh[meshCount]
+//   per mesh: Vertex[vertexCount], GLuint[indexCount] (every LOD),
+//             ModelCacheTexture[textureCount]
+//   ModelCacheNode[nodeCount], depth first
+//   uint32_t[nodeMeshCount], the meshes of every node one after the other
+//   texture file and node names
+//
+// Every block starts on a 16 byte boundary. The cache is only used while
+// the source hash and the import flags match the ones it was written with.
+// Only the model file itself is hashed, so edits to a material library
+// alone need the cache deleted. All fields are little-endian.
+#define MODEL_CACHE_MAGIC "GMDLCACH"
+#define MODEL_CACHE_VERSION 6
+#define MODEL_CACHE_EXTENSION ".mcache"
+#define MODEL_CACHE_ALIGNMENT 16
+
+struct ModelCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t importFlags; // Assimp post processing flags of the import
+  uint64_t sourceHash;
+  uint32_t meshCount;
+  uint32_t vertexSize;  // sizeof(Vertex) when the cache was written
+  float boundsMin[3];   // Of all meshes, without their nodes' transforms
+  float boundsMax[3];
+  uint32_t nodeCount;
+  uint32_t nodeMeshCount;
+  uint64_t nodeOffset;
+  uint64_t nodeMeshOffset;
+};
+
+struct ModelCacheLod {
+  uint32_t indexOffset; // Into the mesh's indices
+  uint32_t indexCount;
+  float error;
+};
+
+struct ModelCacheMesh {
+  uint64_t vertexOffset; // From the start of the file
+  uint64_t indexOffset;
+  uint64_t textureOffset;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t textureCount;
+  uint32_t importedVertexCount; // Before welding
+  float importedAcmr;   // LOD 0 before the index passes
+  float importedAtvr;
+  float acmr;           // LOD 0 as stored
+  float atvr;
+  float boundsMin[3];
+  float boundsMax[3];
+  uint32_t lodCount;
+  ModelCacheLod lods[MESH_MAX_LODS];
+};
+
+struct ModelCacheNode {
+  int32_t parent;       // Index of an earlier node, or SCENE_NO_PARENT
+  uint32_t meshOffset;  // Into the node meshes
+  uint32_t meshCount;
+  uint32_t nameLength;
+  uint64_t nameOffset;
+  float translation[3];
+  float rotation[4];    // Quaternion, x y z w
+  float scale[3];
+};
+
+struct ModelCacheTexture {
+  uint32_t type;        // aiTextureType
+  uint32_t pathLength;
+  uint64_t pathOffset;  // File name relative to the model's directory
+};
+
+// A material texture a mesh uses
+struct ModelTextureReference {
+  aiTextureType type;
+  std::string file; // Relative to the model's directory
+};
+
+// Everything a mesh is built from, whether it came from Assimp or the cache
+struct ModelMeshData {
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices; // Every LOD, one after the other
+  std::vector<MeshLod> lods;
+  std::vector<ModelTextureReference> textures;
+  size_t importedVertexCount; // As Assimp delivered them, before welding
+  VertexCacheStats importedCacheStats; // LOD 0 after welding, in Assimp's order
+  VertexCacheStats cacheStats;         // LOD 0 after the index passes
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+};
+
+// A node of the model's scene graph, whether it came from Assimp or the cache
+struct ModelNodeData {
+  int parent; // Index of an earlier node, or SCENE_NO_PARENT
+  std::string name;
+  NodeTransform local;
+  std::vector<GLuint> meshes; // Indices of the meshes drawn at the node
+};
+
+// A model cache mapped from disk
+class ModelCache {
+ public:
+  // Maps the file, false if it is missing, damaged or out of date
+  bool open(const std::string& path, uint64_t sourceHash, uint32_t importFlags);
+
+  const ModelCacheHeader& header() const;
+  uint32_t meshCount() const { return this->header().meshCount; }
+
+  // Copies one mesh out of the mapping
+  ModelMeshData meshData(uint32_t index) const;
+
+  // Copies the scene graph out of the mapping, in depth first order
+  std::vector<ModelNodeData> nodeData() const;
+
+ private:
+  MappedFile mFile;
+
+  const ModelCacheMesh& mesh(uint32_t index) const;
+};
+
+// Writes the cache through a temporary file, so a crash never leaves a
+// half written cache behind
+bool writeModelCache(const std::string& path, const std::vector<ModelMeshData>& meshes,
+		     const std::vector<ModelNodeData>& nodes, uint64_t sourceHash, uint32_t importFlags);
+
+// Hash of the file contents the cache is checked against
+bool hashModelSource(const std::string& sourcePath, uint64_t& hash);
+
+// Where the cache of a model lives (same name, .mcache extension)
+std::string modelCachePath(const std::string& sourcePath);
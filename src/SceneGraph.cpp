@@ -0,0 +1,86 @@
+#include "SceneGraph.h"
+
+// STD
+#include <iostream>
+
+glm::mat4 NodeTransform::matrix() const {
+  glm::mat4 matrix = glm::mat4_cast(this->rotation);
+  matrix[0] *= this->scale.x;
+  matrix[1] *= this->scale.y;
+  matrix[2] *= this->scale.z;
+  matrix[3] = glm::vec4(this->translation, 1.0f);
+  return matrix;
+}
+
+SceneGraph::SceneGraph() : mAnyDirty(false) {
+}
+
+int SceneGraph::addNode(int parent, const NodeTransform& local, const std::string& name) {
+  int node = (int)this->size();
+
+  // Only the last node and its ancestors still end at the back
+  if (parent != SCENE_NO_PARENT && (parent < 0 || parent >= node || this->mSubtreeEnds[parent] != (GLuint)node)) {
+    std::cout << "Scene node " << name << " is not in depth first order" << std::endl;
+    return SCENE_NO_PARENT;
+  }
+
+  for (int ancestor = parent; ancestor != SCENE_NO_PARENT; ancestor = this->mParents[ancestor]) {
+    this->mSubtreeEnds[ancestor]++;
+  }
+
+  this->mParents.push_back(parent);
+  this->mSubtreeEnds.push_back((GLuint)node + 1);
+  this->mNames.push_back(name);
+  this->mLocalTransforms.push_back(local);
+  this->mLocalMatrices.push_back(local.matrix());
+  this->mWorldMatrices.push_back(glm::mat4(1.0f));
+  this->mDirty.push_back(1);
+  this->mAnyDirty = true;
+
+  return node;
+}
+
+int SceneGraph::findNode(const std::string& name) const {
+  for (GLuint node = 0; node < this->size(); node++) {
+    if (this->mNames[node] == name) {
+      return (int)node;
+    }
+  }
+  return SCENE_NO_PARENT;
+}
+
+void SceneGraph::setLocalTransform(GLuint node, const NodeTransform& local) {
+  this->mLocalTransforms[node] = local;
+  this->mLocalMatrices[node] = local.matrix();
+  this->mDirty[node] = 1;
+  this->mAnyDirty = true;
+}
+
+size_t SceneGraph::updateWorldMatrices() {
+  if (!this->mAnyDirty) {
+    return 0;
+  }
+
+  size_t updated = 0;
+  GLuint count = this->size();
+  for (GLuint node = 0; node < count;) {
+    if (!this->mDirty[node]) {
+      node++;
+      continue;
+    }
+
+    // Parents come first, so theirs is always up to date by now
+    GLuint end = this->mSubtreeEnds[node];
+    for (GLuint i = node; i < end; i++) {
+      int parent = this->mParents[i];
+      this->mWorldMatrices[i] = parent == SCENE_NO_PARENT ? this->mLocalMatrices[i]
+							  : this->mWorldMatrices[parent] * this->mLocalMatrices[i];
+      this->mDirty[i] = 0;
+    }
+    updated += end - node;
+    node = end;
+  }
+
+  this->mAnyDirty = false;
+  return updated;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// STD
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Parent of the nodes at the top of the graph
+#define SCENE_NO_PARENT (-1)
+
+// Local transform of a node: scaled, then rotated, then translated
+struct NodeTransform {
+  glm::vec3 translation;
+  glm::quat rotation;
+  glm::vec3 scale;
+
+  glm::mat4 matrix() const;
+};
+
+// A node hierarchy stored as flat arrays in depth first order, so every
+// parent comes before its children and every subtree is one contiguous
+// range. Each node keeps its local transform and a cached world matrix.
+//
+// Changing a local transform only marks the node dirty. updateWorldMatrices
+// then walks the arrays once, front to back, skips clean subtrees whole and
+// recomputes the dirty ones from their parent's already updated matrix.
+class SceneGraph {
+ public:
+  SceneGraph();
+
+  // Appends a node, in depth first order: the parent has to be the last
+  // node added or one of its ancestors. The index of the node, or
+  // SCENE_NO_PARENT if the parent breaks the order.
+  int addNode(int parent, const NodeTransform& local, const std::string& name = "");
+
+  inline GLuint size() const { return (GLuint)this->mParents.size(); }
+  inline int parent(GLuint node) const { return this->mParents[node]; }
+  inline const std::string& name(GLuint node) const { return this->mNames[node]; }
+
+  // First node with the name, or SCENE_NO_PARENT
+  int findNode(const std::string& name) const;
+
+  inline const NodeTransform& localTransform(GLuint node) const { return this->mLocalTransforms[node]; }
+  void setLocalTransform(GLuint node, const NodeTransform& local);
+
+  // As of the last update
+  inline const glm::mat4& worldMatrix(GLuint node) const { return this->mWorldMatrices[node]; }
+
+  // Recomputes the world matrices below every dirty node, returns how many
+  // were recomputed
+  size_t updateWorldMatrices();
+
+ private:
+  std::vector<int> mParents;
+  std::vector<GLuint> mSubtreeEnds; // One past the node's last descendant
+  std::vector<std::string> mNames;
+  std::vector<NodeTransform> mLocalTransforms;
+  std::vector<glm::mat4> mLocalMatrices;
+  std::vector<glm::mat4> mWorldMatrices;
+  std::vector<uint8_t> mDirty;
+  bool mAnyDirty;
+};
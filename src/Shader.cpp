@@ -1,94 +1,497 @@
 #include "Shader.h"
 
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath) {
-  // Retrive the vertex/fragment source code from filepath
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "FrameData.h"
+#include "LightGrid.h"
+#include "ShaderCache.h"
+#include "ShaderSource.h"
+
+UniformStats Shader::s_UniformStats = { 0, 0 };
+ShaderCacheStats Shader::s_CacheStats = { 0, 0, 0, 0.0, 0.0 };
+std::vector<std::shared_ptr<Shader::Program>> Shader::s_Pending;
+std::shared_ptr<Shader::Program> Shader::s_Fallback;
+uint64_t Shader::s_Frame = 0;
+
+namespace {
+  // Drawn with while a program compiles, positions only. The block is
+  // the start of shaders/frameData.glsl, std140 keeps the offsets.
+  const char* FALLBACK_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (std140) uniform FrameData {\n"
+    "  mat4 view;\n"
+    "  mat4 projection;\n"
+    "  mat4 viewProjection;\n"
+    "};\n"
+    "uniform mat4 model;\n"
+    "void main() {\n"
+    "  gl_Position = viewProjection * model * vec4(position, 1.0f);\n"
+    "}\n";
+
+  const char* FALLBACK_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  color = vec4(0.5f, 0.5f, 0.5f, 1.0f);\n"
+    "}\n";
+
+  // KHR_parallel_shader_compile has no glad flag, so it is looked for by name
+  bool parallelShaderCompile() {
+    static int supported = -1;
+    if (supported == -1) {
+      supported = GLAD_GL_ARB_parallel_shader_compile ? 1 : 0;
+      GLint count = 0;
+      glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+      for (GLint i = 0; i < count && supported == 0; i++) {
+	const GLubyte* name = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+	if (name != nullptr && std::strcmp((const char*)name, "GL_KHR_parallel_shader_compile") == 0) {
+	  supported = 1;
+	}
+      }
+    }
+    return supported == 1;
+  }
+
+  // Bytes of one value of a uniform type
+  uint32_t uniformTypeSize(GLenum type) {
+    switch (type) {
+    case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+      return 8;
+    case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+      return 12;
+    case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2:
+      return 16;
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+      return 24;
+    case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+      return 32;
+    case GL_FLOAT_MAT3:
+      return 36;
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+      return 48;
+    case GL_FLOAT_MAT4:
+      return 64;
+    default:
+      return 4; // Scalars and samplers
+    }
+  }
+
+  // The defines on the line after #version, or first if there is none
+  std::string insertDefines(const std::string& code, const std::string& defines) {
+    if (defines.empty()) {
+      return code;
+    }
+
+    size_t position = 0;
+    size_t version = code.find("#version");
+    if (version != std::string::npos) {
+      size_t lineEnd = code.find('\n', version);
+      position = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+    }
+
+    std::string result = code.substr(0, position);
+    if (position > 0 && result.back() != '\n') {
+      result += '\n';
+    }
+    result += defines;
+    if (result.back() != '\n') {
+      result += '\n';
+    }
+    return result + code.substr(position);
+  }
+}
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines) : m_Program(nullptr) {
+  this->load(vertexPath, fragmentPath, defines);
+
+  // Waits for the driver right away
+  if (this->m_Program->pending) {
+    finishCompile(*this->m_Program);
+  }
+}
+
+Shader Shader::compileAsync(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines) {
+  Shader shader;
+  shader.load(vertexPath, fragmentPath, defines);
+
+  if (shader.m_Program->pending) {
+    if (s_Fallback == nullptr) {
+      createFallback();
+    }
+    s_Pending.push_back(shader.m_Program);
+  }
+  return shader;
+}
+
+void Shader::processCompiles() {
+  s_Frame++;
+
+  for (size_t i = 0; i < s_Pending.size();) {
+    if (compileDone(*s_Pending[i])) {
+      finishCompile(*s_Pending[i]);
+      s_Pending.erase(s_Pending.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void Shader::use() {
+  Program* program = this->activeProgram();
+  glUseProgram(program != nullptr ? program->id : 0);
+}
+
+void Shader::unuse() {
+  glUseProgram(0);
+}
+
+GLuint Shader::getProgram() {
+  Program* program = this->activeProgram();
+  return program != nullptr ? program->id : 0;
+}
+
+bool Shader::isReady() const {
+  return this->m_Program != nullptr && !this->m_Program->pending && this->m_Program->linked;
+}
+
+float Shader::getCompileMilliseconds() const {
+  return this->m_Program != nullptr ? this->m_Program->compileMilliseconds : 0.0f;
+}
+
+void Shader::logCacheStats() {
+  size_t programs = s_CacheStats.hits + s_CacheStats.misses;
+  std::cout << "Shader cache: " << s_CacheStats.hits << "/" << programs << " hits, "
+	    << s_CacheStats.rejected << " rejected by the driver, "
+	    << s_CacheStats.compileMilliseconds << " ms compiling, "
+	    << s_CacheStats.savedMilliseconds << " ms saved" << std::endl;
+}
+
+void Shader::load(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines) {
+  // Retrive the vertex/fragment source code from filepath, includes expanded
   std::string vertexCode;
   std::string fragmentCode;
-  std::ifstream vertexShaderFile;
-  std::ifstream fragmentShaderFile;
+  if (!loadShaderSource(vertexPath, vertexCode) || !loadShaderSource(fragmentPath, fragmentCode)) {
+    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+  }
+
+  // Defines go right after the #version line, which has to come first
+  vertexCode = insertDefines(vertexCode, defines);
+  fragmentCode = insertDefines(fragmentCode, defines);
 
-  // Ensures ifstream objects can throw exceptions
-  vertexShaderFile.exceptions(std::ifstream::badbit);
-  fragmentShaderFile.exceptions(std::ifstream::badbit);
+  this->m_Program = std::make_shared<Program>();
+  Program& program = *this->m_Program;
+  program.id = 0;
+  program.pending = false;
+  program.linked = false;
+  program.vertex = 0;
+  program.fragment = 0;
+  program.queuedFrame = 0;
+  program.compileMilliseconds = 0.0f;
+  program.retrievable = false;
+  program.cacheKey = 0;
 
-  try {
-    // Open files
-    vertexShaderFile.open(vertexPath);
-    fragmentShaderFile.open(fragmentPath);
+  // A binary saved by an earlier run skips compiling and linking
+  if (shaderCacheSupported()) {
+    program.retrievable = true;
+    program.cacheKey = shaderProgramKey(vertexCode, fragmentCode, defines);
+    program.cachePath = shaderCachePath(vertexPath, fragmentPath, defines);
+    if (loadCachedProgram(program, program.cachePath, program.cacheKey)) {
+      reflectUniforms(program);
+      return;
+    }
+  }
 
-    std::stringstream vertexShaderStream, fragmentShaderStream;
+  queueCompile(program, vertexCode, fragmentCode);
+}
 
-    // Read file's buffer contents into streams
-    vertexShaderStream << vertexShaderFile.rdbuf();
-    fragmentShaderStream << fragmentShaderFile.rdbuf();
+bool Shader::loadCachedProgram(Program& program, const std::string& cachePath, uint64_t key) {
+  ShaderCache cache;
+  if (!cache.open(cachePath, key)) {
+    s_CacheStats.misses++;
+    return false;
+  }
 
-    // Close file handlers
-    vertexShaderFile.close();
-    fragmentShaderFile.close();
+  auto start = std::chrono::steady_clock::now();
 
-    // Convert stream into GLchar array
-    vertexCode = vertexShaderStream.str();
-    fragmentCode = fragmentShaderStream.str();
-  } catch(std::ifstream::failure e) {
-    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+  const ShaderCacheHeader& header = cache.header();
+  program.id = glCreateProgram();
+  glProgramBinary(program.id, header.binaryFormat, cache.binary(), (GLsizei)header.binarySize);
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    // The driver changed the format or dislikes the binary, compile from source
+    glDeleteProgram(program.id);
+    program.id = 0;
+    s_CacheStats.misses++;
+    s_CacheStats.rejected++;
+    std::cout << "Shader cache rejected, compiling from source: " << cachePath << std::endl;
+    return false;
   }
 
+  float loadMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  program.linked = true;
+  s_CacheStats.hits++;
+  s_CacheStats.savedMilliseconds += header.compileMilliseconds - loadMilliseconds;
+  return true;
+}
+
+void Shader::queueCompile(Program& program, const std::string& vertexCode, const std::string& fragmentCode) {
   const GLchar* vertexShaderCode = vertexCode.c_str();
   const GLchar* fragmentShaderCode = fragmentCode.c_str();
 
-  // Compile Shaders
-  GLuint vertex, fragment;
-  GLint success;
-  GLchar infoLog[512];
+  auto start = std::chrono::steady_clock::now();
+  program.queuedFrame = s_Frame;
 
   // Vertex Shader
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vertexShaderCode, nullptr);
-  glCompileShader(vertex);
+  program.vertex = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(program.vertex, 1, &vertexShaderCode, nullptr);
+  glCompileShader(program.vertex);
+
+  // Fragment Shader
+  program.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(program.fragment, 1, &fragmentShaderCode, nullptr);
+  glCompileShader(program.fragment);
+
+  // Shader Program, linked without waiting for the compiles, a failed one
+  // fails the link too
+  program.id = glCreateProgram();
+  if (program.retrievable) {
+    glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glAttachShader(program.id, program.vertex);
+  glAttachShader(program.id, program.fragment);
+
+  glLinkProgram(program.id);
+  program.pending = true;
+  program.compileMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Shader::compileDone(const Program& program) {
+  // KHR and ARB_parallel_shader_compile share the enum
+  if (parallelShaderCompile()) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_ARB, &done);
+    return done == GL_TRUE;
+  }
+  return s_Frame - program.queuedFrame >= SHADER_COMPILE_FRAME_DELAY;
+}
+
+void Shader::finishCompile(Program& program) {
+  auto start = std::chrono::steady_clock::now();
+  GLint success;
+  GLchar infoLog[512];
 
   // Print compile errors if any
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+  glGetShaderiv(program.vertex, GL_COMPILE_STATUS, &success);
   if(!success) {
-    glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
+    glGetShaderInfoLog(program.vertex, 512, nullptr, infoLog);
     std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
   }
 
-  // Fragment Shader
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fragmentShaderCode, nullptr);
-  glCompileShader(fragment);
-
-  // Print compile errors if any
-  glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+  glGetShaderiv(program.fragment, GL_COMPILE_STATUS, &success);
   if(!success) {
-    glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
+    glGetShaderInfoLog(program.fragment, 512, nullptr, infoLog);
     std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
   }
 
-  // Shader Program
-  this->m_Program = glCreateProgram();
-  glAttachShader(this->m_Program, vertex);
-  glAttachShader(this->m_Program, fragment);
-
-  glLinkProgram(this->m_Program);
-
   // Print linking errors if any
-  glGetProgramiv(this->m_Program, GL_LINK_STATUS, &success);
+  glGetProgramiv(program.id, GL_LINK_STATUS, &success);
   if(!success) {
-    glGetProgramInfoLog(this->m_Program, 512, nullptr, infoLog);
+    glGetProgramInfoLog(program.id, 512, nullptr, infoLog);
     std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
   }
 
   // Delete the shaders as they're linked into the program and no longer necessary
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+  glDeleteShader(program.vertex);
+  glDeleteShader(program.fragment);
+  program.vertex = 0;
+  program.fragment = 0;
+
+  // Only the driver's work counts, not the frames the compile waited for
+  program.compileMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  s_CacheStats.compileMilliseconds += program.compileMilliseconds;
+  program.linked = success == GL_TRUE;
+  program.pending = false;
+
+  // Not fatal, the next run just compiles again
+  if (program.retrievable && program.linked &&
+      !writeShaderCache(program.cachePath, program.id, program.cacheKey, program.compileMilliseconds)) {
+    std::cout << "Could not write shader cache: " << program.cachePath << std::endl;
+  }
+
+  reflectUniforms(program);
 }
 
-void Shader::use() {
-  glUseProgram(this->m_Program);
+void Shader::createFallback() {
+  s_Fallback = std::make_shared<Program>();
+  Program& program = *s_Fallback;
+  program.id = 0;
+  program.linked = false;
+  program.retrievable = false;
+  program.cacheKey = 0;
+
+  queueCompile(program, FALLBACK_VERTEX_SHADER, FALLBACK_FRAGMENT_SHADER);
+  finishCompile(program);
 }
 
-void Shader::unuse() {
-  glUseProgram(0);
+void Shader::setInt(uint32_t name, GLint value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniform1i(uniform->location, value);
+  }
+}
+
+void Shader::setFloat(uint32_t name, GLfloat value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniform1f(uniform->location, value);
+  }
+}
+
+void Shader::setVec2(uint32_t name, const glm::vec2& value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniform2fv(uniform->location, 1, &value[0]);
+  }
+}
+
+void Shader::setVec3(uint32_t name, const glm::vec3& value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniform3fv(uniform->location, 1, &value[0]);
+  }
+}
+
+void Shader::setVec4(uint32_t name, const glm::vec4& value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniform4fv(uniform->location, 1, &value[0]);
+  }
+}
+
+void Shader::setMat3(uint32_t name, const glm::mat3& value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniformMatrix3fv(uniform->location, 1, GL_FALSE, &value[0][0]);
+  }
 }
 
+void Shader::setMat4(uint32_t name, const glm::mat4& value) {
+  Uniform* uniform = this->findUniform(name);
+  if (uniform != nullptr && this->updateValue(*uniform, &value, sizeof(value))) {
+    glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &value[0][0]);
+  }
+}
+
+GLint Shader::getUniformLocation(uint32_t name) {
+  Uniform* uniform = this->findUniform(name);
+  return uniform != nullptr ? uniform->location : -1;
+}
+
+void Shader::reflectUniforms(Program& program) {
+  // Every program reads the frame's camera and light grid from the same
+  // buffers
+  const struct { const char* name; GLuint binding; } blocks[] = {
+    { FRAME_DATA_BLOCK, FRAME_DATA_BINDING },
+    { CLUSTER_DATA_BLOCK, CLUSTER_DATA_BINDING },
+  };
+  for (const auto& block : blocks) {
+    GLuint index = glGetUniformBlockIndex(program.id, block.name);
+    if (index != GL_INVALID_INDEX) {
+      glUniformBlockBinding(program.id, index, block.binding);
+    }
+  }
+
+  GLint count = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+  std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+  std::vector<std::pair<Uniform, std::string>> uniforms;
+  uint32_t valueBytes = 0;
+
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program.id, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+    std::string name(nameBuffer.data(), length);
+
+    // Uniform block members have no location, they are set through their buffer
+    GLint location = glGetUniformLocation(program.id, name.c_str());
+    if (location == -1) {
+      continue;
+    }
+
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+      name.resize(name.size() - 3);
+    }
+
+    Uniform uniform = { uniformHash(name.c_str()), location, valueBytes, uniformTypeSize(type), false };
+    valueBytes += uniform.valueSize;
+    uniforms.push_back({ uniform, name });
+  }
+
+  std::sort(uniforms.begin(), uniforms.end(), [](const std::pair<Uniform, std::string>& a,
+						 const std::pair<Uniform, std::string>& b) {
+    return a.first.hash < b.first.hash;
+  });
+
+  program.uniforms.clear();
+  program.values.assign(valueBytes, 0);
+  for (size_t i = 0; i < uniforms.size(); i++) {
+    // Only the first of two uniforms with the same hash can be set
+    if (i > 0 && uniforms[i].first.hash == uniforms[i - 1].first.hash) {
+      std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << uniforms[i - 1].second
+		<< " and " << uniforms[i].second << std::endl;
+      continue;
+    }
+    program.uniforms.push_back(uniforms[i].first);
+  }
+}
+
+Shader::Program* Shader::activeProgram() const {
+  if (this->m_Program == nullptr) {
+    return nullptr;
+  }
+  if ((this->m_Program->pending || !this->m_Program->linked) && s_Fallback != nullptr) {
+    return s_Fallback.get();
+  }
+  return this->m_Program.get();
+}
+
+Shader::Uniform* Shader::findUniform(uint32_t name) {
+  Program* program = this->activeProgram();
+  if (program == nullptr) {
+    return nullptr;
+  }
+
+  std::vector<Uniform>& uniforms = program->uniforms;
+  auto uniform = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const Uniform& uniform, uint32_t hash) {
+    return uniform.hash < hash;
+  });
+  return uniform != uniforms.end() && uniform->hash == name ? &*uniform : nullptr;
+}
+
+bool Shader::updateValue(Uniform& uniform, const void* value, size_t size) {
+  unsigned char* lastValue = this->activeProgram()->values.data() + uniform.valueOffset;
+
+  if (uniform.valueKnown && size == uniform.valueSize && std::memcmp(lastValue, value, size) == 0) {
+    s_UniformStats.skipped++;
+    return false;
+  }
+
+  // A value of another size is a type mismatch, GL rejects it and keeps the old one
+  if (size == uniform.valueSize) {
+    std::memcpy(lastValue, value, size);
+    uniform.valueKnown = true;
+  }
+  s_UniformStats.issued++;
+  return true;
+}
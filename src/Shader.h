@@ -4,24 +4,171 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+#include <type_traits>
 
 #include <glad/glad.h>
 
+// GLM
+#include <glm/glm.hpp>
+
+// 32 bit FNV-1a of a uniform name. Array uniforms go by their name
+// without the [0].
+constexpr uint32_t uniformHash(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (; *name != '\0'; name++) {
+    hash = (hash ^ (uint8_t)*name) * 16777619u;
+  }
+  return hash;
+}
+
+// The hash of a uniform name literal, always worked out by the compiler
+#define UNIFORM(name) (std::integral_constant<uint32_t, uniformHash(name)>::value)
+
+// glUniform calls the setters issued, and the ones they skipped because
+// the program already had the value
+struct UniformStats {
+  size_t issued;
+  size_t skipped;
+};
+
+// Programs loaded from the binary cache and compiled from source since
+// the start. Rejected binaries were in the cache but the driver refused
+// them, they count as misses too. Saved is what compiling the hits took
+// when they were cached, less what loading them took now.
+struct ShaderCacheStats {
+  size_t hits;
+  size_t misses;
+  size_t rejected;
+  double compileMilliseconds;
+  double savedMilliseconds;
+};
+
+// Frames a queued compile gets before its status is read, when the
+// driver can't tell whether it is done (no KHR_parallel_shader_compile)
+#define SHADER_COMPILE_FRAME_DELAY 3
+
 class Shader {
  public:
   // Default constructor
-  Shader() {};
-  // Constructor reads and builds the shader
-  Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
+  Shader() : m_Program(nullptr) {};
+  // Constructor reads and builds the shader, or loads the program binary
+  // an earlier run cached for the same sources and driver. The defines,
+  // whole lines like "#define NAME 1", go after the #version line.
+  Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines = "");
+
+  // Like the constructor, but only queues the compile and link and
+  // returns at once. Until processCompiles() sees them done, use() binds
+  // a flat gray fallback program that only has the model, view and
+  // projection uniforms. Copies of the Shader switch over together.
+  static Shader compileAsync(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines = "");
+
+  // Finishes the queued compiles the driver is done with, without waiting
+  // on the others. Call it once per frame from the thread that owns the
+  // GL context.
+  static void processCompiles();
+
+  // Number of programs queued and not finished yet
+  static size_t pendingCompiles() { return s_Pending.size(); }
+
   // Use the program
   void use();
   //Dispose the program
   void unuse();
 
-  GLuint getProgram() { return this->m_Program; } 
+  // The program use() binds, the fallback while compiling
+  GLuint getProgram();
+
+  // False while the compile is queued, or if it failed
+  bool isReady() const;
+  // What queuing the compile and reading its status back took, less the
+  // frames in between. 0 for cached programs.
+  float getCompileMilliseconds() const;
+
+  // Uniform setters, by hashed name (UNIFORM("model")). The active
+  // uniforms are listed once after linking, so a set is a table lookup,
+  // and the glUniform call is left out when the value is the one last set.
+  // The program has to be in use. Uniforms it does not have are ignored.
+  // Copies of a Shader share the last values, so a uniform set through
+  // these should not also be set with glUniform directly.
+  void setInt(uint32_t name, GLint value);
+  void setFloat(uint32_t name, GLfloat value);
+  void setVec2(uint32_t name, const glm::vec2& value);
+  void setVec3(uint32_t name, const glm::vec3& value);
+  void setVec4(uint32_t name, const glm::vec4& value);
+  void setMat3(uint32_t name, const glm::mat3& value);
+  void setMat4(uint32_t name, const glm::mat4& value);
+
+  // -1 for uniforms the program does not have
+  GLint getUniformLocation(uint32_t name);
+
+  // Summed over every shader since the last reset, which the game loop
+  // does at the start of each frame
+  static UniformStats getUniformStats() { return s_UniformStats; }
+  static void resetUniformStats() { s_UniformStats = { 0, 0 }; }
+
+  static ShaderCacheStats getCacheStats() { return s_CacheStats; }
+  // Prints the hit rate and the compile time saved
+  static void logCacheStats();
   
  private:
-  // The program ID
-  GLuint m_Program;
-};
+  struct Uniform {
+    uint32_t hash;
+    GLint location;
+    uint32_t valueOffset; // Of its last value in the table's values
+    uint32_t valueSize;   // In bytes, the first element of arrays
+    bool valueKnown;      // Nothing set through the setters yet otherwise
+  };
+
+  // The program and its uniforms, shared by the copies of a Shader
+  struct Program {
+    GLuint id;
+    bool pending;  // Compile queued, the shaders below still attached
+    bool linked;
+    std::vector<Uniform> uniforms; // Sorted by hash
+    std::vector<unsigned char> values;
+
+    // Of a queued compile
+    GLuint vertex, fragment;
+    uint64_t queuedFrame;
+    float compileMilliseconds;
+    bool retrievable; // Written to the binary cache once linked
+    uint64_t cacheKey;
+    std::string cachePath;
+  };
 
+  std::shared_ptr<Program> m_Program;
+
+  static UniformStats s_UniformStats;
+  static ShaderCacheStats s_CacheStats;
+
+  // Queued compiles, and the program drawn with until they are done
+  static std::vector<std::shared_ptr<Program>> s_Pending;
+  static std::shared_ptr<Program> s_Fallback;
+  static uint64_t s_Frame;
+
+  // Reads the sources and loads the cached binary, or queues the compile
+  void load(const GLchar* vertexPath, const GLchar* fragmentPath, const std::string& defines);
+
+  // Loads the cached binary, false if there is none or the driver rejects it
+  static bool loadCachedProgram(Program& program, const std::string& cachePath, uint64_t key);
+  // Hands the sources to the driver and links, without reading any status
+  // back, so the work can overlap whatever comes next
+  static void queueCompile(Program& program, const std::string& vertexCode, const std::string& fragmentCode);
+  // True once reading the status of a queued compile won't block
+  static bool compileDone(const Program& program);
+  // Reads the status back, reporting errors, and lists the uniforms
+  static void finishCompile(Program& program);
+  static void createFallback();
+
+  // Lists the active uniforms of the linked program
+  static void reflectUniforms(Program& program);
+  // The program draws go to, this one's once ready and the fallback before
+  Program* activeProgram() const;
+  Uniform* findUniform(uint32_t name);
+  // Records the value, false if the program already had it
+  bool updateValue(Uniform& uniform, const void* value, size_t size);
+};
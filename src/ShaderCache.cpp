@@ -0,0 +1,152 @@
+#include "ShaderCache.h"
+
+// STD
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+namespace {
+  const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+  const uint64_t FNV_PRIME = 1099511628211ULL;
+
+  size_t alignOffset(size_t offset) {
+    return (offset + SHADER_CACHE_ALIGNMENT - 1) & ~(size_t)(SHADER_CACHE_ALIGNMENT - 1);
+  }
+
+  // FNV-1a, the length goes in first so "ab" + "c" and "a" + "bc" differ
+  uint64_t hashString(uint64_t hash, const std::string& text) {
+    hash = (hash ^ text.size()) * FNV_PRIME;
+    for (unsigned char c : text) {
+      hash = (hash ^ c) * FNV_PRIME;
+    }
+    return hash;
+  }
+
+  std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value != nullptr ? std::string((const char*)value) : std::string();
+  }
+}
+
+bool ShaderCache::open(const std::string& path, uint64_t key) {
+  if (!this->mFile.open(path)) {
+    return false;
+  }
+
+  size_t size = this->mFile.size();
+
+  if (size < sizeof(ShaderCacheHeader)) {
+    this->mFile.close();
+    return false;
+  }
+
+  const ShaderCacheHeader& header = this->header();
+  if (memcmp(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SHADER_CACHE_VERSION ||
+      header.key != key ||
+      header.binarySize == 0 ||
+      header.binaryOffset > size ||
+      header.binarySize > size - header.binaryOffset) {
+    this->mFile.close();
+    return false;
+  }
+
+  return true;
+}
+
+const ShaderCacheHeader& ShaderCache::header() const {
+  return *(const ShaderCacheHeader*)this->mFile.data();
+}
+
+const unsigned char* ShaderCache::binary() const {
+  return this->mFile.data() + this->header().binaryOffset;
+}
+
+bool shaderCacheSupported() {
+  if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) {
+    return false;
+  }
+
+  // Some drivers expose the entry points but no format to save in
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  return formatCount > 0;
+}
+
+bool writeShaderCache(const std::string& path, GLuint program, uint64_t key, float compileMilliseconds) {
+  GLint binaryLength = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+  if (binaryLength <= 0) {
+    return false;
+  }
+
+  size_t binaryOffset = alignOffset(sizeof(ShaderCacheHeader));
+  std::vector<unsigned char> file(binaryOffset + (size_t)binaryLength, 0);
+
+  GLsizei binarySize = 0;
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(program, binaryLength, &binarySize, &binaryFormat, file.data() + binaryOffset);
+  if (binarySize <= 0) {
+    return false;
+  }
+  file.resize(binaryOffset + (size_t)binarySize);
+
+  ShaderCacheHeader header = {};
+  std::memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic));
+  header.version = SHADER_CACHE_VERSION;
+  header.binaryFormat = binaryFormat;
+  header.key = key;
+  header.binaryOffset = binaryOffset;
+  header.binarySize = (uint32_t)binarySize;
+  header.compileMilliseconds = compileMilliseconds;
+  std::memcpy(file.data(), &header, sizeof(header));
+
+  std::string temporaryPath = path + ".tmp";
+  std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+  output.write((const char*)file.data(), file.size());
+  output.close();
+  if (!output) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t shaderProgramKey(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines) {
+  uint64_t hash = FNV_OFFSET;
+  hash = hashString(hash, vertexCode);
+  hash = hashString(hash, fragmentCode);
+  hash = hashString(hash, defines);
+  hash = hashString(hash, glString(GL_VENDOR));
+  hash = hashString(hash, glString(GL_RENDERER));
+  hash = hashString(hash, glString(GL_VERSION));
+  return hash;
+}
+
+std::string shaderCachePath(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+  std::filesystem::path vertex(vertexPath);
+  std::string name = vertex.stem().string();
+
+  std::string fragmentName = std::filesystem::path(fragmentPath).stem().string();
+  if (fragmentName != name) {
+    name += "." + fragmentName;
+  }
+
+  // Each set of defines is a program of its own, they must not evict each other
+  if (!defines.empty()) {
+    char definesHash[17];
+    std::snprintf(definesHash, sizeof(definesHash), "%016llx", (unsigned long long)hashString(FNV_OFFSET, defines));
+    name += std::string(".") + definesHash;
+  }
+
+  return (vertex.parent_path() / (name + SHADER_CACHE_EXTENSION)).string();
+}
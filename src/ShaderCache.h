@@ -0,0 +1,69 @@
+#pragma once
+
+// STD
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "MappedFile.h"
+
+// Linked programs are written next to their vertex shader with
+// glGetProgramBinary and handed back to glProgramBinary on later runs, so
+// a warm start skips compiling and linking. Layout:
+//
+//   ShaderCacheHeader
+//   the program binary, binarySize bytes
+//
+// The cache is only used while its key matches. The key covers both
+// sources, the defines and the GL vendor, renderer and version strings,
+// so an edit or a driver update compiles from source again. The driver
+// may still reject a binary with a matching key, the program is then
+// compiled from source and the cache rewritten. All fields are
+// little-endian.
+#define SHADER_CACHE_MAGIC "GPRGCACH"
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_EXTENSION ".pcache"
+#define SHADER_CACHE_ALIGNMENT 16
+
+struct ShaderCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t binaryFormat;      // As glGetProgramBinary reported it
+  uint64_t key;
+  uint64_t binaryOffset;      // From the start of the file
+  uint32_t binarySize;
+  float compileMilliseconds;  // Compiling and linking the sources took
+};
+
+// A program binary cache mapped from disk
+class ShaderCache {
+ public:
+  // Maps the file, false if it is missing, damaged or has another key
+  bool open(const std::string& path, uint64_t key);
+
+  const ShaderCacheHeader& header() const;
+  const unsigned char* binary() const;
+
+ private:
+  MappedFile mFile;
+};
+
+// True if the context can save and load program binaries
+bool shaderCacheSupported();
+
+// Reads the program's binary back and writes the cache through a
+// temporary file, so a crash never leaves a half written cache behind.
+// The program has to have been linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+bool writeShaderCache(const std::string& path, GLuint program, uint64_t key, float compileMilliseconds);
+
+// Key of a program built from these sources on the current context
+uint64_t shaderProgramKey(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines);
+
+// Where the cache of a program lives: the vertex shader's directory and
+// name, followed by the fragment shader's name when it differs and a
+// hash of the defines when there are any, with the .pcache extension
+std::string shaderCachePath(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines);
@@ -0,0 +1,82 @@
+#include "ShaderPermutations.h"
+
+// STD
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+uint32_t ShaderFeatures::key() const {
+  uint32_t pointLights = std::min(this->pointLights, (uint32_t)SHADER_MAX_POINT_LIGHTS);
+  return (this->directionLight ? 1u : 0u) |
+    (pointLights << 1) |
+    (this->spotLight ? 1u << 5 : 0u) |
+    (this->specularMap ? 1u << 6 : 0u) |
+    (this->normalMap ? 1u << 7 : 0u) |
+    (this->clusteredLights ? 1u << 8 : 0u);
+}
+
+std::string ShaderFeatures::defines() const {
+  uint32_t pointLights = std::min(this->pointLights, (uint32_t)SHADER_MAX_POINT_LIGHTS);
+
+  std::string defines;
+  if (this->directionLight) {
+    defines += "#define DIRECTION_LIGHT\n";
+  }
+  defines += "#define NUMBER_POINT_LIGHTS " + std::to_string(pointLights) + "\n";
+  if (this->spotLight) {
+    defines += "#define SPOT_LIGHT\n";
+  }
+  if (this->specularMap) {
+    defines += "#define SPECULAR_MAP\n";
+  }
+  if (this->normalMap) {
+    defines += "#define NORMAL_MAP\n";
+  }
+  if (this->clusteredLights) {
+    defines += "#define CLUSTERED_LIGHTS\n";
+  }
+  return defines;
+}
+
+ShaderPermutations::ShaderPermutations(std::string vertexPath, std::string fragmentPath) : mVertexPath(std::move(vertexPath)),
+											  mFragmentPath(std::move(fragmentPath)),
+											  mVariants(),
+											  mRequests(0) {
+}
+
+Shader& ShaderPermutations::get(const ShaderFeatures& features) {
+  this->mRequests++;
+
+  uint32_t key = features.key();
+  auto variant = this->mVariants.find(key);
+  if (variant != this->mVariants.end()) {
+    return variant->second;
+  }
+
+  Shader shader = Shader::compileAsync(this->mVertexPath.c_str(), this->mFragmentPath.c_str(), features.defines());
+  return this->mVariants.emplace(key, shader).first->second;
+}
+
+ShaderPermutationStats ShaderPermutations::getStats() const {
+  ShaderPermutationStats stats = { this->mVariants.size(), 0, this->mRequests, 0.0 };
+  for (const auto& variant : this->mVariants) {
+    stats.compileMilliseconds += variant.second.getCompileMilliseconds();
+    if (!variant.second.isReady()) {
+      stats.pending++;
+    }
+  }
+  return stats;
+}
+
+void ShaderPermutations::logStats() const {
+  ShaderPermutationStats stats = this->getStats();
+  std::cout << "Shader variants: " << this->mFragmentPath << std::endl
+	    << "Variants: " << stats.variants << " for " << stats.requests << " requests, "
+	    << stats.pending << " not ready" << std::endl
+	    << "Compile ms: " << stats.compileMilliseconds << std::endl;
+
+  for (const auto& variant : this->mVariants) {
+    std::cout << " key 0x" << std::hex << variant.first << std::dec << ": "
+	      << variant.second.getCompileMilliseconds() << " ms" << std::endl;
+  }
+}
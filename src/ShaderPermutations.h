@@ -0,0 +1,64 @@
+#pragma once
+
+// STD
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Shader.h"
+
+// Most point lights a variant can be built for, four bits of the key
+#define SHADER_MAX_POINT_LIGHTS 15
+
+// What a scene and a material need from a lighting shader. Each
+// combination is a variant of its own, compiled with only the code it
+// uses: a scene with no spotlight never pays for the spotlight term.
+struct ShaderFeatures {
+  bool directionLight;
+  uint32_t pointLights; // Up to SHADER_MAX_POINT_LIGHTS
+  bool spotLight;
+  bool specularMap;     // Otherwise a constant material.specularColor
+  bool normalMap;
+  bool clusteredLights; // Shades the lights a LightGrid binds
+
+  // Packs the features into the bits of a permutation key:
+  // 0 direction light, 1-4 point lights, 5 spotlight, 6 specular map,
+  // 7 normal map, 8 clustered lights
+  uint32_t key() const;
+
+  // The #define lines of the variant, DIRECTION_LIGHT,
+  // NUMBER_POINT_LIGHTS, SPOT_LIGHT, SPECULAR_MAP, NORMAL_MAP and
+  // CLUSTERED_LIGHTS
+  std::string defines() const;
+};
+
+// Variants built so far and what building them took
+struct ShaderPermutationStats {
+  size_t variants;
+  size_t pending;             // Still compiling, drawn with the fallback
+  size_t requests;
+  double compileMilliseconds; // Driver time, see Shader::getCompileMilliseconds
+};
+
+// The variants of one vertex and fragment shader pair. A variant is
+// queued for compiling the first time it is asked for (see
+// Shader::compileAsync) and kept, so features that come out at the same
+// key share one program. A scene meeting new features draws with the
+// fallback for a few frames instead of stalling on the compile.
+class ShaderPermutations {
+ public:
+  ShaderPermutations(std::string vertexPath, std::string fragmentPath);
+
+  // The variant for the features, valid as long as the permutations are
+  Shader& get(const ShaderFeatures& features);
+
+  ShaderPermutationStats getStats() const;
+  // Prints the variant count and compile times
+  void logStats() const;
+
+ private:
+  std::string mVertexPath;
+  std::string mFragmentPath;
+  std::unordered_map<uint32_t, Shader> mVariants; // By key
+  size_t mRequests;
+};
@@ -0,0 +1,95 @@
+#include "ShaderSource.h"
+
+// STD
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+
+namespace {
+  bool readFile(const std::filesystem::path& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return !file.bad();
+  }
+
+  // The quoted file name of an #include line, empty if the line is not one
+  std::string includeName(const std::string& line) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+      return std::string();
+    }
+
+    size_t open = line.find('"', start + 8);
+    size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+    if (close == std::string::npos) {
+      return std::string();
+    }
+    return line.substr(open + 1, close - open - 1);
+  }
+
+  bool expand(const std::filesystem::path& path, std::string& code, std::vector<std::string>& included) {
+    std::string text;
+    if (!readFile(path, text)) {
+      std::cout << "ERROR::SHADER::INCLUDE_NOT_SUCCESSFULLY_READ\n" << path.string() << std::endl;
+      return false;
+    }
+
+    bool inComment = false;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+      size_t lineEnd = text.find('\n', lineStart);
+      lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+      std::string line = text.substr(lineStart, lineEnd - lineStart);
+      lineStart = lineEnd;
+
+      std::string name = inComment ? std::string() : includeName(line);
+
+      // Block comments only matter for telling whether the next line is real
+      for (size_t i = 0; i + 1 < line.size(); i++) {
+	if (!inComment && line[i] == '/' && line[i + 1] == '/') {
+	  break;
+	}
+	if (line[i] == (inComment ? '*' : '/') && line[i + 1] == (inComment ? '/' : '*')) {
+	  inComment = !inComment;
+	  i++;
+	}
+      }
+
+      if (name.empty()) {
+	code += line;
+	continue;
+      }
+
+      std::filesystem::path includePath = (path.parent_path() / name).lexically_normal();
+      if (std::find(included.begin(), included.end(), includePath.string()) != included.end()) {
+	continue;
+      }
+      included.push_back(includePath.string());
+
+      if (!expand(includePath, code, included)) {
+	return false;
+      }
+      if (!code.empty() && code.back() != '\n') {
+	code += '\n';
+      }
+    }
+
+    return true;
+  }
+}
+
+bool loadShaderSource(const std::string& path, std::string& code) {
+  code.clear();
+  std::filesystem::path sourcePath = std::filesystem::path(path).lexically_normal();
+  std::vector<std::string> included = { sourcePath.string() };
+  return expand(sourcePath, code, included);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// STD
+#include <string>
+
+// Reads a GLSL file and expands its #include "file" lines, with the path
+// relative to the file that has the line. Each file is pasted in once, the
+// first time it is included, so shared headers need no guards and cycles
+// end on their own. Lines inside comments are not looked at.
+// Returns false if the file or one it includes can't be read.
+bool loadShaderSource(const std::string& path, std::string& code);
@@ -0,0 +1,209 @@
+#include "TextureCache.h"
+
+#include <chrono>
+#include <filesystem>
+
+namespace {
+  bool isReady(const std::shared_future<bool>& ready) {
+    return ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  // Whether the texture finished uploading, false while it is pending or
+  // if its load failed or was abandoned
+  bool isUploaded(const std::shared_future<bool>& ready) {
+    if (!isReady(ready)) {
+      return false;
+    }
+    try {
+      return ready.get();
+    } catch (const std::future_error&) {
+      return false;
+    }
+  }
+
+  // GPU memory of every level the texture has, read back from GL so
+  // block compressed textures count at their real size
+  size_t textureBytes(GLuint id) {
+    glBindTexture(GL_TEXTURE_2D, id);
+    GLint maxLevel = 0, compressed = GL_FALSE;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+    size_t bytes = 0;
+    for (GLint level = 0; level <= maxLevel; level++) {
+      GLint width = 0, height = 0;
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+      if (width == 0 || height == 0) {
+	break;
+      }
+
+      if (compressed) {
+	GLint size = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+	bytes += size;
+      } else {
+	GLint red = 0, green = 0, blue = 0, alpha = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_RED_SIZE, &red);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_GREEN_SIZE, &green);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_BLUE_SIZE, &blue);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_ALPHA_SIZE, &alpha);
+	bytes += (size_t)width * height * (red + green + blue + alpha) / 8;
+      }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return bytes;
+  }
+}
+
+
+// Texture handle
+// ==============
+TextureHandle::TextureHandle() : mEntry(nullptr) {
+}
+
+TextureHandle::TextureHandle(Entry* entry) : mEntry(entry) {
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other) : mEntry(other.mEntry) {
+  if (this->mEntry != nullptr) {
+    TextureCache::instance().retain(this->mEntry);
+  }
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other) {
+  if (this->mEntry == other.mEntry) {
+    return *this;
+  }
+
+  this->reset();
+  this->mEntry = other.mEntry;
+  if (this->mEntry != nullptr) {
+    TextureCache::instance().retain(this->mEntry);
+  }
+  return *this;
+}
+
+TextureHandle::~TextureHandle() {
+  this->reset();
+}
+
+GLuint TextureHandle::id() const {
+  return this->mEntry != nullptr ? this->mEntry->id : 0;
+}
+
+void TextureHandle::reset() {
+  if (this->mEntry != nullptr) {
+    TextureCache::instance().release(this->mEntry);
+    this->mEntry = nullptr;
+  }
+}
+
+
+// Texture cache
+// =============
+TextureCache::TextureCache() : mHits(0), mMisses(0), mReleased(0) {
+}
+
+TextureCache& TextureCache::instance() {
+  static TextureCache cache;
+  return cache;
+}
+
+TextureHandle TextureCache::acquire(const std::string& imagePath, TextureLoader& loader) {
+  std::string key = canonicalPath(imagePath);
+
+  std::lock_guard<std::mutex> lock(this->mMutex);
+  this->deleteFinishedUploads();
+
+  auto found = this->mEntries.find(key);
+  if (found != this->mEntries.end()) {
+    this->mHits++;
+    found->second.refCount++;
+    return TextureHandle(&found->second);
+  }
+
+  this->mMisses++;
+  AsyncTexture texture = loader.loadTextureAsync(imagePath);
+
+  // Node addresses in an unordered_map survive rehashing, so handles can point at them
+  TextureHandle::Entry& entry = this->mEntries[key];
+  entry = { key, texture.id, texture.ready, 1, 0 };
+  return TextureHandle(&entry);
+}
+
+TextureCache::Stats TextureCache::stats() {
+  std::lock_guard<std::mutex> lock(this->mMutex);
+  this->deleteFinishedUploads();
+
+  Stats stats = { this->mHits, this->mMisses, this->mReleased, this->mEntries.size(), 0 };
+
+  for (auto& item : this->mEntries) {
+    TextureHandle::Entry& entry = item.second;
+    if (entry.bytes == 0 && isUploaded(entry.ready)) {
+      entry.bytes = textureBytes(entry.id);
+    }
+    stats.residentBytes += entry.bytes;
+  }
+
+  return stats;
+}
+
+void TextureCache::dump(std::ostream& out) {
+  Stats stats = this->stats();
+  size_t lookups = stats.hits + stats.misses;
+
+  out << "Texture cache: " << stats.textures << " textures, "
+      << stats.residentBytes / 1024 << " KiB resident" << std::endl
+      << "= Hits: " << stats.hits << " / " << lookups << " lookups" << std::endl
+      << "= Misses: " << stats.misses << std::endl
+      << "= Released: " << stats.released << std::endl;
+}
+
+void TextureCache::retain(TextureHandle::Entry* entry) {
+  std::lock_guard<std::mutex> lock(this->mMutex);
+  entry->refCount++;
+}
+
+void TextureCache::release(TextureHandle::Entry* entry) {
+  std::lock_guard<std::mutex> lock(this->mMutex);
+  if (--entry->refCount > 0) {
+    return;
+  }
+
+  // Deleting the name while a worker is still decoding would make the
+  // upload target a dead texture, so wait for the upload to land first
+  if (isReady(entry->ready)) {
+    glDeleteTextures(1, &entry->id);
+  } else {
+    this->mPendingDeletes.push_back({ entry->id, entry->ready });
+  }
+
+  this->mReleased++;
+  std::string key = entry->key;
+  this->mEntries.erase(key);
+  this->deleteFinishedUploads();
+}
+
+void TextureCache::deleteFinishedUploads() {
+  for (size_t i = 0; i < this->mPendingDeletes.size();) {
+    if (isReady(this->mPendingDeletes[i].ready)) {
+      glDeleteTextures(1, &this->mPendingDeletes[i].id);
+      this->mPendingDeletes[i] = this->mPendingDeletes.back();
+      this->mPendingDeletes.pop_back();
+    } else {
+      i++;
+    }
+  }
+}
+
+std::string TextureCache::canonicalPath(const std::string& imagePath) {
+  // Files that don't exist keep their plain path, the loader reports the error
+  std::error_code error;
+  std::filesystem::path path = std::filesystem::weakly_canonical(imagePath, error);
+  if (error) {
+    return imagePath;
+  }
+  return path.string();
+}
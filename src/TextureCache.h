@@ -0,0 +1,95 @@
+#pragma once
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "TextureLoader.h"
+
+class TextureCache;
+
+// Reference to a texture owned by the cache. Copies share the texture,
+// the GL name is deleted when the last handle goes away.
+class TextureHandle {
+ public:
+  TextureHandle();
+  TextureHandle(const TextureHandle& other);
+  TextureHandle& operator=(const TextureHandle& other);
+  ~TextureHandle();
+
+  GLuint id() const;
+  bool valid() const { return this->mEntry != nullptr; }
+
+  // Drops this reference early, e.g. before the GL context goes away
+  void reset();
+
+ private:
+  friend class TextureCache;
+
+  struct Entry;
+  explicit TextureHandle(Entry* entry);
+
+  Entry* mEntry;
+};
+
+struct TextureHandle::Entry {
+  std::string key;
+  GLuint id;
+  std::shared_future<bool> ready;
+  size_t refCount;
+  size_t bytes; // Zero until the upload finishes and the size is read back
+};
+
+// Process-wide texture cache keyed by canonical file path, so every model
+// and primitive that uses the same image shares one decode and one upload.
+// Handles must be released on the thread that owns the GL context.
+class TextureCache {
+ public:
+  struct Stats {
+    size_t hits;
+    size_t misses;
+    size_t released;      // Textures deleted after their last handle went away
+    size_t textures;      // Textures currently in the cache
+    size_t residentBytes; // GPU memory of the uploaded textures, all levels
+  };
+
+  static TextureCache& instance();
+
+  // Returns the cached texture for the path, loading it through the
+  // loader's worker pool on a miss.
+  TextureHandle acquire(const std::string& imagePath, TextureLoader& loader);
+
+  Stats stats();
+  void dump(std::ostream& out);
+
+ private:
+  friend class TextureHandle;
+
+  // A texture released while its image was still being decoded
+  struct PendingDelete {
+    GLuint id;
+    std::shared_future<bool> ready;
+  };
+
+  std::unordered_map<std::string, TextureHandle::Entry> mEntries;
+  std::vector<PendingDelete> mPendingDeletes;
+  std::mutex mMutex;
+  size_t mHits, mMisses, mReleased;
+
+  TextureCache();
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  void retain(TextureHandle::Entry* entry);
+  void release(TextureHandle::Entry* entry);
+  void deleteFinishedUploads();
+
+  static std::string canonicalPath(const std::string& imagePath);
+};
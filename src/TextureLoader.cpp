@@ -1,10 +1,268 @@
 #include "TextureLoader.h"
 
-TextureLoader::TextureLoader() {
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+// FreeImage keeps pixels in the platform colour order, BGRA on little-endian
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+#define FREEIMAGE_GL_FORMAT GL_BGRA
+#else
+#define FREEIMAGE_GL_FORMAT GL_RGBA
+#endif
+
+TextureLoader::TextureLoader() : mAsync(std::make_shared<AsyncState>()) {
   FreeImage_Initialise(true);
 }
 
 GLuint TextureLoader::loadTexture(const std::string imagePath) {
+  std::shared_ptr<CookedTexture> cooked = this->openCookedTexture(imagePath);
+  if (cooked) {
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    return this->setupCookedTexture(textureId, *cooked, cooked->levelData(0), imagePath);
+  }
+
+  DecodedImage image = this->decodeImage(imagePath);
+  if (image.bitmap == nullptr) {
+    return -1;
+  }
+
+  //Generate texture ID and load texture data
+  GLuint textureId;
+  glGenTextures(1, &textureId);
+
+  textureId = this->setupGLTexture(textureId, FreeImage_GetBits(image.bitmap),
+				   image.name, image.width, image.height);
+
+  // Unload the 32-bit colour bitmap
+  FreeImage_Unload(image.bitmap);
+
+  return textureId;
+}
+
+AsyncTexture TextureLoader::loadTextureAsync(const std::string imagePath) {
+  std::shared_ptr<std::promise<bool>> ready = std::make_shared<std::promise<bool>>();
+  AsyncTexture texture = { this->createPlaceholderTexture(), ready->get_future().share() };
+
+  AsyncState* async = this->mAsync.get();
+  GLuint textureId = texture.id;
+
+  // The worker only decodes, GL calls stay on the thread that owns the context
+  std::function<void()> decode = [async, imagePath, textureId, ready]() {
+    // Cooked textures skip the decode, the worker only pages the file in
+    std::shared_ptr<CookedTexture> cooked = TextureLoader::openCookedTexture(imagePath);
+    if (cooked) {
+      cooked->prefault();
+
+      std::lock_guard<std::mutex> lock(async->mutex);
+      async->uploads.push_back({ textureId, { imagePath, nullptr, 0, 0 }, cooked, ready });
+      return;
+    }
+
+    DecodedImage image = TextureLoader::decodeImage(imagePath);
+
+    std::lock_guard<std::mutex> lock(async->mutex);
+    if (image.bitmap == nullptr) {
+      async->inFlight--;
+      ready->set_value(false);
+      return;
+    }
+    async->uploads.push_back({ textureId, image, nullptr, ready });
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(async->mutex);
+    async->jobs.push_back({ decode, [ready]() { ready->set_value(false); } });
+    async->inFlight++;
+  }
+  async->jobAvailable.notify_one();
+
+  return texture;
+}
+
+void TextureLoader::processUploads(double budgetMilliseconds) {
+  auto start = std::chrono::steady_clock::now();
+
+  TextureUploadRing& ring = this->mAsync->ring;
+  if (!this->mAsync->ringInitialised) {
+    this->mAsync->ringInitialised = true;
+    if (!ring.init(TEXTURE_UPLOAD_RING_BYTES)) {
+      std::cout << "Could not create the texture upload ring, uploading directly" << std::endl;
+    }
+  }
+
+  // Always upload at least one texture so a small budget still makes progress
+  for (;;) {
+    PendingUpload upload;
+    {
+      std::lock_guard<std::mutex> lock(this->mAsync->mutex);
+      if (this->mAsync->uploads.empty()) {
+	return;
+      }
+      upload = this->mAsync->uploads.front();
+      this->mAsync->uploads.pop_front();
+    }
+
+    const GLubyte* pixels;
+    size_t size;
+    if (upload.cooked) {
+      pixels = upload.cooked->levelData(0);
+      size = upload.cooked->dataSize();
+    } else {
+      pixels = FreeImage_GetBits(upload.image.bitmap);
+      size = (size_t)upload.image.width * upload.image.height * 4;
+    }
+
+    // Stage the pixels in the ring. When it is full the rest waits for a
+    // later frame, blocking here would stall the frame on the GPU. If the
+    // range can't be mapped the texture is uploaded straight from memory.
+    bool staged = false;
+    if (ring.fits(size)) {
+      bool full;
+      unsigned char* staging = ring.reserve(size, full);
+      if (full) {
+	std::lock_guard<std::mutex> lock(this->mAsync->mutex);
+	this->mAsync->uploads.push_front(upload);
+	return;
+      }
+
+      if (staging != nullptr) {
+	std::memcpy(staging, pixels, size);
+	pixels = ring.beginUpload();
+	staged = true;
+      }
+    }
+
+    GLuint textureId;
+    if (upload.cooked) {
+      textureId = this->setupCookedTexture(upload.textureId, *upload.cooked, pixels, upload.image.name);
+    } else {
+      textureId = this->setupGLTexture(upload.textureId, pixels,
+				       upload.image.name, upload.image.width, upload.image.height);
+    }
+
+    if (staged) {
+      ring.endUpload();
+    }
+    if (upload.image.bitmap != nullptr) {
+      FreeImage_Unload(upload.image.bitmap);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->mAsync->mutex);
+      this->mAsync->inFlight--;
+    }
+    upload.ready->set_value(textureId != (GLuint)-1);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed.count() >= budgetMilliseconds) {
+      return;
+    }
+  }
+}
+
+TextureUploadRing::Stats TextureLoader::uploadStats() {
+  return this->mAsync->ring.stats();
+}
+
+void TextureLoader::releaseUploadRing() {
+  this->mAsync->ring.release();
+}
+
+size_t TextureLoader::pendingUploads() {
+  std::lock_guard<std::mutex> lock(this->mAsync->mutex);
+  return this->mAsync->inFlight;
+}
+
+std::vector<TextureArrayLayer> TextureLoader::loadTextureArrays(const std::vector<std::string>& imagePaths) {
+  std::vector<TextureArrayLayer> layers(imagePaths.size(), { 0, -1 });
+  std::vector<DecodedImage> images(imagePaths.size());
+
+  // Decode everything on the workers and wait for it
+  std::vector<std::future<void>> decoded;
+  for (size_t i = 0; i < imagePaths.size(); i++) {
+    std::shared_ptr<std::promise<void>> done = std::make_shared<std::promise<void>>();
+    decoded.push_back(done->get_future());
+
+    std::string imagePath = imagePaths[i];
+    DecodedImage* image = &images[i];
+    std::lock_guard<std::mutex> lock(this->mAsync->mutex);
+    this->mAsync->jobs.push_back({ [imagePath, image, done]() {
+	*image = TextureLoader::decodeImage(imagePath);
+	done->set_value();
+      }, [done]() { done->set_value(); } });
+  }
+  this->mAsync->jobAvailable.notify_all();
+
+  for (auto& done : decoded) {
+    done.wait();
+  }
+
+  // Images of the same size share an array, up to the layer limit
+  std::map<std::pair<int, int>, std::vector<size_t>> groups;
+  for (size_t i = 0; i < images.size(); i++) {
+    if (images[i].bitmap != nullptr) {
+      groups[{ images[i].width, images[i].height }].push_back(i);
+    }
+  }
+
+  GLint maxLayers;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+  for (auto& group : groups) {
+    int width = group.first.first;
+    int height = group.first.second;
+    std::vector<size_t>& members = group.second;
+
+    for (size_t first = 0; first < members.size(); first += maxLayers) {
+      GLsizei layerCount = (GLsizei)std::min(members.size() - first, (size_t)maxLayers);
+
+      GLuint arrayId;
+      glGenTextures(1, &arrayId);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0,
+		   FREEIMAGE_GL_FORMAT, GL_UNSIGNED_BYTE, nullptr);
+
+      for (GLsizei layer = 0; layer < layerCount; layer++) {
+	DecodedImage& image = images[members[first + layer]];
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1,
+			FREEIMAGE_GL_FORMAT, GL_UNSIGNED_BYTE, FreeImage_GetBits(image.bitmap));
+	layers[members[first + layer]] = { arrayId, layer };
+      }
+      glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+      // Parameters
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      GLenum glError = glGetError();
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+      if (!this->validateGLTexture(glError, imagePaths[members[first]])) {
+	glDeleteTextures(1, &arrayId);
+	for (GLsizei layer = 0; layer < layerCount; layer++) {
+	  layers[members[first + layer]] = { 0, -1 };
+	}
+      }
+    }
+  }
+
+  for (auto& image : images) {
+    if (image.bitmap != nullptr) {
+      FreeImage_Unload(image.bitmap);
+    }
+  }
+
+  return layers;
+}
+
+TextureLoader::DecodedImage TextureLoader::decodeImage(const std::string& imagePath) {
+  DecodedImage image = { imagePath, nullptr, 0, 0 };
+
   // Get the filename as a pointer to a const char array
   // to play nice with FreeImage
   const char* filename = imagePath.c_str();
@@ -17,7 +275,7 @@ GLuint TextureLoader::loadTexture(const std::string imagePath) {
   // Check if the image was not found
   if (format == -1) {
     std::cout << "Could not found image: " << filename << "!!" << std::endl;
-    return -1;
+    return image;
   }
 
   // Image found, check its format
@@ -33,7 +291,7 @@ GLuint TextureLoader::loadTexture(const std::string imagePath) {
 
     if (!FreeImage_FIFSupportsReading(format)) {
       std::cout << "Detected image format cannot be read!!" << std::endl;
-      return -1;
+      return image;
     }
   }
 
@@ -83,32 +341,87 @@ GLuint TextureLoader::loadTexture(const std::string imagePath) {
   std::cout << "Image: " << imagePath << std::endl
 	    << "Size: " << imageWidth << "x" << imageHeight << std::endl;
 
-  // Get a pointer to the texture data as an array of unsigned bytes.
-  std::unique_ptr<GLubyte> textureData(FreeImage_GetBits(bitmap32));
+  if (bitsPerPixel != 32) {
+    FreeImage_Unload(bitmap);
+  }
 
-  GLuint textureId = this->setupGLTexture(std::move(textureData), filename, imageWidth, imageHeight);
+  image.bitmap = bitmap32;
+  image.width = imageWidth;
+  image.height = imageHeight;
 
-  // Unload the 32-bit colour bitmap
-  FreeImage_Unload(bitmap32);
+  return image;
+}
 
-  if (bitsPerPixel != 32) {
-    FreeImage_Unload(bitmap);
+std::shared_ptr<CookedTexture> TextureLoader::openCookedTexture(const std::string& imagePath) {
+  std::string cookedPath = cookedTexturePath(imagePath);
+  if (!isCookedTextureCurrent(imagePath, cookedPath)) {
+    return nullptr;
+  }
+
+  std::shared_ptr<CookedTexture> cooked = std::make_shared<CookedTexture>();
+  if (!cooked->open(cookedPath)) {
+    std::cout << "Invalid cooked texture: " << cookedPath << std::endl;
+    return nullptr;
   }
 
-  if (textureId == -1) {
+  // BC1/BC3 need S3TC, without it the source image is decoded instead
+  GLenum internalFormat = cooked->header().internalFormat;
+  if ((internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+       internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) &&
+      !GLAD_GL_EXT_texture_compression_s3tc) {
+    std::cout << "S3TC is not supported, ignoring cooked texture: " << cookedPath << std::endl;
+    return nullptr;
+  }
+
+  return cooked;
+}
+
+GLuint TextureLoader::setupCookedTexture(GLuint textureId, const CookedTexture& cooked,
+					const GLubyte* levelData, std::string textureName) {
+  const CookedTextureHeader& header = cooked.header();
+
+  // Every level comes from the file, GL doesn't have to build any
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+    const CookedTextureLevel& level = cooked.level(i);
+    const GLubyte* data = levelData + (level.offset - cooked.level(0).offset);
+    if (header.format == 0) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, header.internalFormat, level.width, level.height, 0,
+			     (GLsizei)level.size, data);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, i, header.internalFormat, level.width, level.height, 0,
+		   header.format, header.type, data);
+    }
+  }
+
+  // BC4 only stores red, spread it so single channel maps like specular
+  // sample as grey instead of red
+  if (header.internalFormat == GL_COMPRESSED_RED_RGTC1) {
+    const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+
+  // Parameters
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levelCount - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  GLenum glError = glGetError();
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  if (!this->validateGLTexture(glError, textureName)) {
     return -1;
   }
 
   return textureId;
 }
 
-GLuint TextureLoader::setupGLTexture(std::unique_ptr<GLubyte> textureData,
+GLuint TextureLoader::setupGLTexture(GLuint textureId,
+				     const GLubyte* textureData,
 				     std::string textureName,
 				     int width, int height) {
-  //Generate texture ID and load texture data
-  GLuint textureId;
-  glGenTextures(1, &textureId);
-
   // Assign texture to ID
   glBindTexture(GL_TEXTURE_2D, textureId);
   glTexImage2D(GL_TEXTURE_2D, // Type of texture
@@ -117,9 +430,9 @@ GLuint TextureLoader::setupGLTexture(std::unique_ptr<GLubyte> textureData,
 		width, // Width of the texture
 		height, // Height of the texture
 		0, // Border in pixels
-		GL_RGBA, // Data format
+		FREEIMAGE_GL_FORMAT, // Data format
 		GL_UNSIGNED_BYTE, // Type of texture data
-	       (const void*)textureData.release()); // The image data
+	       (const void*)textureData); // The image data
   glGenerateMipmap(GL_TEXTURE_2D);
   
   // Parameters
@@ -138,6 +451,23 @@ GLuint TextureLoader::setupGLTexture(std::unique_ptr<GLubyte> textureData,
   return textureId;
 }
 
+GLuint TextureLoader::createPlaceholderTexture() {
+  // A single opaque white texel, complete without mipmaps
+  const GLubyte texel[4] = { 255, 255, 255, 255 };
+
+  GLuint textureId;
+  glGenTextures(1, &textureId);
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureId;
+}
+
 bool TextureLoader::validateGLTexture(GLenum error, std::string textureName) {
   if (error) {
     std::cout << "There was an error loading the texture: "
@@ -163,3 +493,56 @@ bool TextureLoader::validateGLTexture(GLenum error, std::string textureName) {
   return true;
 }
 
+
+// Async state
+// ===========
+TextureLoader::AsyncState::AsyncState() : inFlight(0), stopping(false), ringInitialised(false) {
+  // Leave one core to the render thread
+  unsigned int workerCount = std::thread::hardware_concurrency();
+  workerCount = workerCount > 1 ? workerCount - 1 : 1;
+
+  for (unsigned int i = 0; i < workerCount; i++) {
+    this->workers.push_back(std::thread(&AsyncState::workerLoop, this));
+  }
+}
+
+TextureLoader::AsyncState::~AsyncState() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->jobAvailable.notify_all();
+
+  for (auto& worker : this->workers) {
+    worker.join();
+  }
+
+  // Jobs no worker started, their textures fail rather than never finishing
+  for (auto& job : this->jobs) {
+    job.cancel();
+  }
+
+  // Decoded images that never made it to GL
+  for (auto& upload : this->uploads) {
+    if (upload.image.bitmap != nullptr) {
+      FreeImage_Unload(upload.image.bitmap);
+    }
+    upload.ready->set_value(false);
+  }
+}
+
+void TextureLoader::AsyncState::workerLoop() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->jobAvailable.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+      if (this->stopping) {
+	return;
+      }
+      job = this->jobs.front();
+      this->jobs.pop_front();
+    }
+    job.run();
+  }
+}
@@ -3,21 +3,132 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <glad/glad.h>
 #include <FreeImagePlus.h>
 
+#include "CookedTexture.h"
+#include "TextureUploadRing.h"
+
+// Staging memory for streamed uploads, larger images go straight to GL
+#define TEXTURE_UPLOAD_RING_BYTES (32 * 1024 * 1024)
+
+// A texture whose image is still being decoded on a worker thread.
+// The id is valid right away and samples as a 1x1 placeholder until
+// the upload queue replaces its contents with the real image.
+struct AsyncTexture {
+  GLuint id;
+  // True once the image is on the GPU, false if it couldn't be loaded
+  std::shared_future<bool> ready;
+};
+
+// One image of a texture array built by TextureLoader::loadTextureArrays
+struct TextureArrayLayer {
+  GLuint arrayId; // 0 if the image couldn't be loaded
+  GLint layer;
+};
+
 class TextureLoader {
  public:
   TextureLoader();
 
+  // Both loaders prefer a current cooked .ctex next to the image (see texcook)
   GLuint loadTexture(const std::string imagePath);
 
+  // Queues the image for decoding on the worker pool and returns at once
+  AsyncTexture loadTextureAsync(const std::string imagePath);
+
+  // Uploads decoded images to GL until the time budget is spent, or
+  // until the staging ring is full. Pixels go through the ring's unpack
+  // buffer, so the driver doesn't copy them synchronously.
+  // Call it once per frame from the thread that owns the GL context.
+  void processUploads(double budgetMilliseconds);
+
+  // Bytes in flight, stalls and totals of the staging ring
+  TextureUploadRing::Stats uploadStats();
+
+  // Deletes the staging ring's buffer, call it before the GL context goes
+  // away. A later processUploads uploads directly.
+  void releaseUploadRing();
+
+  // Number of textures queued or decoded but not uploaded yet
+  size_t pendingUploads();
+
+  // Decodes the images on the worker pool and packs same-size images into
+  // GL_TEXTURE_2D_ARRAY textures, one layer each. Blocks until all are on
+  // the GPU, so it is meant for load time. Returns a layer per path.
+  std::vector<TextureArrayLayer> loadTextureArrays(const std::vector<std::string>& imagePaths);
+
  private:
-  GLuint setupGLTexture(std::unique_ptr<GLubyte>  textureData,
+  // Pixels decoded by FreeImage that still need to go to GL
+  struct DecodedImage {
+    std::string name;
+    FIBITMAP* bitmap; // 32-bit image, owned until it is uploaded
+    int width, height;
+  };
+
+  struct PendingUpload {
+    GLuint textureId;
+    DecodedImage image;
+    std::shared_ptr<CookedTexture> cooked; // Uploaded instead of the image when set
+    std::shared_ptr<std::promise<bool>> ready;
+  };
+
+  // A decode for the worker pool. cancel settles the job's promise
+  // instead when the loader goes away before a worker gets to it.
+  struct Job {
+    std::function<void()> run;
+    std::function<void()> cancel;
+  };
+
+  // Decoding workers and the upload queue. It is shared between the
+  // copies of a loader, so every copy feeds the same queue.
+  struct AsyncState {
+    AsyncState();
+    ~AsyncState();
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::deque<PendingUpload> uploads;
+    size_t inFlight; // Queued jobs plus decoded images not uploaded yet
+    bool stopping;
+
+    // Only touched by the GL thread, set up on the first upload
+    TextureUploadRing ring;
+    bool ringInitialised;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+
+    void workerLoop();
+  };
+
+  std::shared_ptr<AsyncState> mAsync;
+
+  // Decodes an image file to 32 bits per pixel, the bitmap is null on failure.
+  // Safe to call from the worker threads.
+  static DecodedImage decodeImage(const std::string& imagePath);
+
+  // Maps the cooked version of the image, null if there is no current one
+  static std::shared_ptr<CookedTexture> openCookedTexture(const std::string& imagePath);
+
+  // Levels are read from levelData, laid out like the cooked file from
+  // its first level on. It may be an offset into a bound unpack buffer.
+  GLuint setupCookedTexture(GLuint textureId, const CookedTexture& cooked,
+			    const GLubyte* levelData, std::string textureName);
+
+  GLuint setupGLTexture(GLuint textureId,
+			const GLubyte* textureData,
 			std::string textureName,
 			int witdh, int height);
-  
+
+  GLuint createPlaceholderTexture();
+
   bool validateGLTexture(GLenum error, std::string textureName);
 };
-
@@ -0,0 +1,171 @@
+#include "TextureUploadRing.h"
+
+// STD
+#include <cstdint>
+
+// Start of every reservation, keeps row data aligned for any unpack alignment
+#define UPLOAD_RING_ALIGNMENT 256
+
+TextureUploadRing::TextureUploadRing() : mBuffer(0),
+					 mCapacity(0),
+					 mHead(0),
+					 mPersistent(nullptr),
+					 mReservedOffset(0),
+					 mReservedSize(0),
+					 mReservedMemory(nullptr),
+					 mBytesInFlight(0),
+					 mStalls(0),
+					 mMapFailures(0),
+					 mUploads(0),
+					 mBytesUploaded(0) {
+}
+
+TextureUploadRing::~TextureUploadRing() {
+  this->release();
+}
+
+bool TextureUploadRing::init(size_t capacity) {
+  glGenBuffers(1, &this->mBuffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->mBuffer);
+
+  if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+    this->mPersistent = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags);
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+  }
+
+  GLenum glError = glGetError();
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (glError != GL_NO_ERROR || ((GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) && this->mPersistent == nullptr)) {
+    glDeleteBuffers(1, &this->mBuffer);
+    this->mBuffer = 0;
+    this->mPersistent = nullptr;
+    return false;
+  }
+
+  this->mCapacity = capacity;
+  return true;
+}
+
+void TextureUploadRing::release() {
+  if (this->mBuffer == 0) {
+    return;
+  }
+
+  for (Region& region : this->mInFlight) {
+    glDeleteSync(region.fence);
+  }
+  this->mInFlight.clear();
+  this->mBytesInFlight = 0;
+
+  // Deleting a buffer unmaps it, persistent mapping or not
+  glDeleteBuffers(1, &this->mBuffer);
+  this->mBuffer = 0;
+  this->mCapacity = 0;
+  this->mHead = 0;
+  this->mPersistent = nullptr;
+  this->mReservedMemory = nullptr;
+}
+
+bool TextureUploadRing::fits(size_t size) const {
+  return this->isReady() && size > 0 && size <= this->mCapacity;
+}
+
+unsigned char* TextureUploadRing::reserve(size_t size, bool& full) {
+  full = false;
+  if (!this->fits(size)) {
+    return nullptr;
+  }
+
+  this->retire();
+
+  size_t alignedSize = (size + UPLOAD_RING_ALIGNMENT - 1) & ~(size_t)(UPLOAD_RING_ALIGNMENT - 1);
+  size_t offset;
+
+  if (this->mInFlight.empty()) {
+    offset = 0;
+  } else {
+    // Regions in use run from the oldest one (tail) up to the head,
+    // possibly wrapping around the end of the buffer
+    size_t tail = this->mInFlight.front().offset;
+    if (this->mHead > tail && this->mHead + alignedSize <= this->mCapacity) {
+      offset = this->mHead;
+    } else if (this->mHead > tail && alignedSize <= tail) {
+      offset = 0;
+    } else if (this->mHead < tail && this->mHead + alignedSize <= tail) {
+      offset = this->mHead;
+    } else {
+      // The GPU still reads the space we'd need, try again next frame
+      this->mStalls++;
+      full = true;
+      return nullptr;
+    }
+  }
+
+  if (this->mPersistent != nullptr) {
+    this->mReservedMemory = this->mPersistent + offset;
+  } else {
+    // The fences guarantee the GPU is done with this range
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->mBuffer);
+    this->mReservedMemory = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, alignedSize,
+							      GL_MAP_WRITE_BIT |
+							      GL_MAP_INVALIDATE_RANGE_BIT |
+							      GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (this->mReservedMemory == nullptr) {
+      // Clear the error so the caller's own upload doesn't report it
+      glGetError();
+      this->mMapFailures++;
+      return nullptr;
+    }
+  }
+
+  this->mReservedOffset = offset;
+  this->mReservedSize = alignedSize;
+  this->mBytesUploaded += size;
+  return this->mReservedMemory;
+}
+
+const GLubyte* TextureUploadRing::beginUpload() {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->mBuffer);
+  if (this->mPersistent == nullptr) {
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  // With an unpack buffer bound, GL reads the pointer as an offset into it
+  return (const GLubyte*)(uintptr_t)this->mReservedOffset;
+}
+
+void TextureUploadRing::endUpload() {
+  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  this->mInFlight.push_back({ this->mReservedOffset, this->mReservedSize, fence });
+  this->mHead = this->mReservedOffset + this->mReservedSize;
+  this->mBytesInFlight += this->mReservedSize;
+  this->mUploads++;
+  this->mReservedMemory = nullptr;
+}
+
+TextureUploadRing::Stats TextureUploadRing::stats() {
+  this->retire();
+  return { this->mBytesInFlight, this->mStalls, this->mMapFailures, this->mUploads, this->mBytesUploaded };
+}
+
+void TextureUploadRing::retire() {
+  while (!this->mInFlight.empty()) {
+    Region& region = this->mInFlight.front();
+    GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+
+    glDeleteSync(region.fence);
+    this->mBytesInFlight -= region.size;
+    this->mInFlight.pop_front();
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// STD
+#include <deque>
+#include <cstddef>
+
+// GLAD
+#include <glad/glad.h>
+
+// Staging ring for texture uploads through a pixel unpack buffer.
+//
+// Pixels are copied into mapped buffer memory and glTexImage2D reads them
+// from the buffer, so the driver can return before the copy to the texture
+// is done. Every upload is fenced and its space is reused only once the
+// GPU has passed the fence. When buffer storage is available the ring is
+// mapped once, persistently; otherwise each reservation maps its own range
+// unsynchronized, which the fences make safe.
+//
+// Only use it from the thread that owns the GL context.
+class TextureUploadRing {
+ public:
+  struct Stats {
+    size_t bytesInFlight; // Staged bytes the GPU may still be reading
+    size_t stalls;        // Reservations refused because the ring was full
+    size_t mapFailures;   // Reservations whose range could not be mapped
+    size_t uploads;
+    size_t bytesUploaded;
+  };
+
+  TextureUploadRing();
+  ~TextureUploadRing();
+
+  // Creates and maps the buffer, false if GL refused
+  bool init(size_t capacity);
+
+  // Deletes the buffer and the fences. Call it while the GL context is
+  // still current, the destructor does it too if nobody did.
+  void release();
+  bool isReady() const { return this->mBuffer != 0; }
+
+  // True if a reservation of this size can ever succeed
+  bool fits(size_t size) const;
+
+  // Space for size bytes that is not in use by the GPU any more. Null if
+  // the ring is full right now, full is then set and a later frame can
+  // try again, or if the range could not be mapped. Never waits on the GPU.
+  unsigned char* reserve(size_t size, bool& full);
+
+  // Binds the buffer and returns the reserved space as the pointer GL
+  // expects while a pixel unpack buffer is bound
+  const GLubyte* beginUpload();
+
+  // Fences the GL commands issued since beginUpload and unbinds the buffer
+  void endUpload();
+
+  Stats stats();
+
+ private:
+  struct Region {
+    size_t offset;
+    size_t size;
+    GLsync fence;
+  };
+
+  GLuint mBuffer;
+  size_t mCapacity;
+  size_t mHead;
+  unsigned char* mPersistent; // Mapped for the ring's lifetime, or null
+
+  // The current reservation
+  size_t mReservedOffset;
+  size_t mReservedSize;
+  unsigned char* mReservedMemory;
+
+  std::deque<Region> mInFlight; // Oldest first
+  size_t mBytesInFlight;
+  size_t mStalls;
+  size_t mMapFailures;
+  size_t mUploads;
+  size_t mBytesUploaded;
+
+  // Frees the regions whose fences have signalled
+  void retire();
+};
@@ -0,0 +1,101 @@
+#include "VertexLayout.h"
+#include "Mesh.h"
+
+// STD
+#include <cmath>
+#include <cstddef>
+
+namespace {
+  glm::vec2 octahedralEncode(const glm::vec3& normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) {
+      return glm::vec2(0.0f);
+    }
+
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+    if (normal.z < 0.0f) {
+      // Fold the lower hemisphere over the diagonals
+      glm::vec2 folded = 1.0f - glm::abs(glm::vec2(encoded.y, encoded.x));
+      encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+      encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return encoded;
+  }
+
+  // Same maths as the vertex shader
+  glm::vec3 octahedralDecode(const glm::vec2& encoded) {
+    glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    float fold = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return glm::normalize(normal);
+  }
+
+  glm::vec2 snormToFloat(const GLshort* snorm) {
+    return glm::max(glm::vec2(snorm[0], snorm[1]) / 32767.0f, -1.0f);
+  }
+}
+
+const VertexLayout& vertexLayout(VertexFormat format) {
+  static const VertexLayout float32 = {
+    sizeof(Vertex),
+    {
+      { VERTEX_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, (GLuint)offsetof(Vertex, position) },
+      { NORMAL_ATTRIB_INDEX, 3, GL_FLOAT, GL_FALSE, (GLuint)offsetof(Vertex, normal) },
+      { TEXTURE_ATTRIB_INDEX, 2, GL_FLOAT, GL_FALSE, (GLuint)offsetof(Vertex, texCoords) }
+    }
+  };
+
+  static const VertexLayout packed16 = {
+    sizeof(PackedVertex),
+    {
+      { VERTEX_ATTRIB_INDEX, 3, GL_UNSIGNED_SHORT, GL_TRUE, (GLuint)offsetof(PackedVertex, position) },
+      { NORMAL_ATTRIB_INDEX, 2, GL_SHORT, GL_TRUE, (GLuint)offsetof(PackedVertex, normal) },
+      { TEXTURE_ATTRIB_INDEX, 2, GL_HALF_FLOAT, GL_FALSE, (GLuint)offsetof(PackedVertex, texCoords) }
+    }
+  };
+
+  return format == VertexFormat::PACKED16 ? packed16 : float32;
+}
+
+PackedVertex packVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords,
+			const glm::vec3& positionOffset, const glm::vec3& positionScale) {
+  PackedVertex packed = {};
+
+  for (int axis = 0; axis < 3; axis++) {
+    float scale = positionScale[axis] > 0.0f ? positionScale[axis] : 1.0f;
+    float unorm = glm::clamp((position[axis] - positionOffset[axis]) / scale, 0.0f, 1.0f);
+    packed.position[axis] = (GLushort)std::lround(unorm * 65535.0f);
+  }
+
+  // Rounding each component on its own is not always closest, so try the
+  // four neighbouring grid points and keep the best one
+  glm::vec2 encoded = octahedralEncode(normal) * 32767.0f;
+  float bestDot = -2.0f;
+  for (int corner = 0; corner < 4; corner++) {
+    GLshort candidate[2] = {
+      (GLshort)((corner & 1) ? std::ceil(encoded.x) : std::floor(encoded.x)),
+      (GLshort)((corner & 2) ? std::ceil(encoded.y) : std::floor(encoded.y))
+    };
+    float dot = glm::dot(octahedralDecode(snormToFloat(candidate)), normal);
+    if (dot > bestDot) {
+      bestDot = dot;
+      packed.normal[0] = candidate[0];
+      packed.normal[1] = candidate[1];
+    }
+  }
+
+  GLuint halves = glm::packHalf2x16(texCoords);
+  packed.texCoords[0] = (GLushort)(halves & 0xFFFF);
+  packed.texCoords[1] = (GLushort)(halves >> 16);
+
+  return packed;
+}
+
+void unpackVertex(const PackedVertex& packed, const glm::vec3& positionOffset, const glm::vec3& positionScale,
+		  glm::vec3& position, glm::vec3& normal, glm::vec2& texCoords) {
+  glm::vec3 unorm(packed.position[0], packed.position[1], packed.position[2]);
+  position = positionOffset + unorm / 65535.0f * positionScale;
+  normal = octahedralDecode(snormToFloat(packed.normal));
+  texCoords = glm::unpackHalf2x16(packed.texCoords[0] | ((GLuint)packed.texCoords[1] << 16));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// STD
+#include <vector>
+#include <cstdint>
+
+// GLAD
+#include <glad/glad.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "Constants.h"
+
+// One vertex attribute as glVertexAttribPointer takes it
+struct VertexAttribute {
+  GLuint index;
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  GLuint offset;
+};
+
+// How a vertex format lays out its attributes in the vertex buffer
+struct VertexLayout {
+  GLsizei stride;
+  std::vector<VertexAttribute> attributes;
+};
+
+// VertexFormat::PACKED16, 16 bytes instead of 32. The vertex shader
+// dequantizes it (see shaders/modelArrayPacked.vert):
+//   position  = positionOffset + position * positionScale
+//   normal    = octahedral decode of the two snorm16 values
+//   texCoords = read as is, GL converts the half floats
+struct PackedVertex {
+  GLushort position[4];  // Unorm16 within the mesh's bounding box, w unused
+  GLshort normal[2];     // Octahedral, snorm16
+  GLushort texCoords[2]; // Half floats
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has padding");
+
+const VertexLayout& vertexLayout(VertexFormat format);
+
+// Quantizes one vertex against its mesh's bounding box, given as the
+// minimum corner and the box size (the dequantization offset and scale)
+PackedVertex packVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords,
+			const glm::vec3& positionOffset, const glm::vec3& positionScale);
+
+// What the vertex shader reconstructs from a packed vertex
+void unpackVertex(const PackedVertex& packed, const glm::vec3& positionOffset, const glm::vec3& positionScale,
+		  glm::vec3& position, glm::vec3& normal, glm::vec2& texCoords);
@@ -2,6 +2,9 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
+#include <functional>
+#include <cmath>
 
 // GLAD
 #include <glad/glad.h>
@@ -13,13 +16,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include "Shader.h"
 #include "TextureLoader.h"
+#include "TextureCache.h"
 #include "Texture.h"
 #include "World.h"
+#include "FrameData.h"
+#include "Frustum.h"
 #include "Cube.h"
 #include "Plane.h"
+#include "InstanceBuffer.h"
 #include "Constants.h"
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
@@ -39,6 +47,9 @@ static bool firstMouseInput = true;
 static GLfloat lastX = WIDTH / 2;
 static GLfloat lastY = HEIGHT / 2;
 
+// Time per frame spent uploading textures that finished loading
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+
 // Delta Time
 static GLfloat deltaTime = 0.0f;  // Time between current frame and last frame
 static GLfloat lastFrame = 0.0f;  // Time of last frame
@@ -59,21 +70,29 @@ int main() {
   world.screenHeight = HEIGHT;
   world.camera = Camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
+  // Camera matrices, uploaded once per frame for every program
+  FrameUniforms frameUniforms;
+
   // Setup texture loader
   TextureLoader textureLoader;
 
   // Set up shaders
   Shader shader("../shaders/advanced.vert", "../shaders/advanced.frag");
+  Shader instancedShader("../shaders/advancedInstanced.vert", "../shaders/advancedInstanced.frag");
+  Shader::logCacheStats();
+
+  // Load textures, they show a placeholder until the upload queue gets to them
+  TextureHandle metalHandle = TextureCache::instance().acquire("../assets/metal.png", textureLoader);
+  TextureHandle marbleHandle = TextureCache::instance().acquire("../assets/marble.jpg", textureLoader);
 
-  // Load textures
   Graphics::Texture metal = {
-    textureLoader.loadTexture("../assets/metal.png"),
+    metalHandle.id(),
     "metal",
     TextureType::DIFFUSE
   };
 
   Graphics::Texture marble = {
-    textureLoader.loadTexture("../assets/marble.jpg"),
+    marbleHandle.id(),
     "marble",
     TextureType::DIFFUSE
   };
@@ -92,6 +111,34 @@ int main() {
   std::unique_ptr<Graphics::Plane> plane = std::make_unique<Graphics::Plane>();
   plane->setUp(shader);
   plane->setTexture(metal);
+
+  // A ring of tinted cubes around the scene, all in one draw call
+  std::unique_ptr<Graphics::Cube> ringCube = std::make_unique<Graphics::Cube>();
+  ringCube->setUp(instancedShader);
+  ringCube->setTexture(marble);
+  std::vector<InstanceData> ring;
+  for(int i = 0; i < 16; i++) {
+    float angle = i * glm::two_pi<float>() / 16.0f;
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(angle) * 6.0f, 0.0f, std::sin(angle) * 6.0f));
+    ring.push_back({ glm::scale(model, glm::vec3(0.5f)),
+		     glm::vec4(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle), 1.0f, 1.0f) });
+  }
+  InstanceBuffer ringInstances;
+  ringInstances.update(ring);
+
+  // The shapes don't move, their bounds are gathered once and culled
+  // against the camera every frame
+  BoundingSphereList shapeBounds;
+  shapeBounds.add(cube->getBoundingSphere());
+  shapeBounds.add(cube2->getBoundingSphere());
+  shapeBounds.add(plane->getBoundingSphere());
+  std::vector<std::function<void()>> shapeRenders = {
+    [&cube]() { cube->render(); },
+    [&cube2]() { cube2->render(); },
+    [&plane]() { plane->render(); }
+  };
+  std::vector<GLuint> visibleShapes;
+  visibleShapes.reserve(shapeRenders.size());
   
   // Game loop
   while(!glfwWindowShouldClose(world.window)) {
@@ -99,11 +146,18 @@ int main() {
     GLfloat currentFrame = glfwGetTime();
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
+    Shader::resetUniformStats();
     
     // Check and call events
     glfwPollEvents();
     doMovement();
 
+    // Upload the textures the loader threads finished decoding
+    textureLoader.processUploads(TEXTURE_UPLOAD_BUDGET_MS);
+
+    // Switch the shaders whose compiles finished over from the fallback
+    Shader::processCompiles();
+
     // Render
     // Clear the color buffer
     glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -111,20 +165,23 @@ int main() {
 
 
     // Render Graphics
-    cube->update(world);
-    cube->render();
-
-    cube2->update(world);
-    cube2->render();
+    frameUniforms.update(world, currentFrame);
 
-    plane->update(world);
-    plane->render();
+    visibleShapes.clear();
+    Frustum(frameUniforms.data().viewProjection).cull(shapeBounds, visibleShapes);
+    for(GLuint shape : visibleShapes) {
+      shapeRenders[shape]();
+    }
+    ringCube->renderInstanced(ringInstances);
     
     // Swap the buffers
     glfwSwapBuffers(world.window);
   }
 
   // Properly de-allocate all resources once they've outlived their purpose    
+  metalHandle.reset();
+  marbleHandle.reset();
+  textureLoader.releaseUploadRing();
   glfwTerminate();
   return 0;
 }
@@ -208,6 +265,11 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
     glfwSetWindowShouldClose(window, GL_TRUE);
   }
 
+  // Print the texture cache counters
+  if(key == GLFW_KEY_T && action == GLFW_PRESS) {
+    TextureCache::instance().dump(std::cout);
+  }
+
   if(key >= 0 && key <= 1024) {
     if(action == GLFW_PRESS) {
       keys[key] = true;
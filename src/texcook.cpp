@@ -0,0 +1,175 @@
+// texcook - turns PNG/JPG textures into cooked .ctex containers that
+// TextureLoader maps and uploads without decoding.
+//
+// Usage: texcook [--format auto|rgba8|bc1|bc3|bc4|bc5] <image>...
+//
+// Each image is written next to its source with the .ctex extension.
+// With --format auto (the default) normal maps (_ddn) get BC5, specular
+// maps BC4, images with alpha BC3 and everything else BC1.
+// Every image reports its encode time and throughput.
+// tests/test_cooked_texture checks cooked files against the loader's own
+// decode of their sources.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <FreeImagePlus.h>
+
+#include "CookedTexture.h"
+#include "BlockCompression.h"
+
+bool parseEncoding(const std::string& name, TextureEncoding& encoding, bool& automatic) {
+  automatic = name == "auto";
+  if (automatic || name == "rgba8") {
+    encoding = TextureEncoding::RGBA8;
+  } else if (name == "bc1") {
+    encoding = TextureEncoding::BC1;
+  } else if (name == "bc3") {
+    encoding = TextureEncoding::BC3;
+  } else if (name == "bc4") {
+    encoding = TextureEncoding::BC4;
+  } else if (name == "bc5") {
+    encoding = TextureEncoding::BC5;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Picks the encoding from the file name and the alpha channel
+TextureEncoding chooseEncoding(const std::string& imagePath, const std::vector<unsigned char>& pixels) {
+  std::string name = imagePath.substr(imagePath.find_last_of("/\\") + 1);
+  std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+  if (name.find("_ddn") != std::string::npos) {
+    return TextureEncoding::BC5;
+  }
+  if (name.find("spec") != std::string::npos) {
+    return TextureEncoding::BC4;
+  }
+  for (size_t i = 3; i < pixels.size(); i += 4) {
+    if (pixels[i] != 255) {
+      return TextureEncoding::BC3;
+    }
+  }
+  return TextureEncoding::BC1;
+}
+
+// Decodes an image with FreeImage and swizzles it to RGBA8, rows bottom to top
+bool decodeImage(const std::string& imagePath, std::vector<unsigned char>& pixels,
+		 int& width, int& height) {
+  const char* filename = imagePath.c_str();
+
+  FREE_IMAGE_FORMAT format = FreeImage_GetFileType(filename, 0);
+  if (format == FIF_UNKNOWN) {
+    format = FreeImage_GetFIFFromFilename(filename);
+  }
+  if (format == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(format)) {
+    std::cout << "Could not read image: " << imagePath << std::endl;
+    return false;
+  }
+
+  FIBITMAP* bitmap = FreeImage_Load(format, filename);
+  if (bitmap == nullptr) {
+    std::cout << "Could not load image: " << imagePath << std::endl;
+    return false;
+  }
+
+  FIBITMAP* bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
+  FreeImage_Unload(bitmap);
+  if (bitmap32 == nullptr) {
+    std::cout << "Could not convert image to 32 bits: " << imagePath << std::endl;
+    return false;
+  }
+
+  width = FreeImage_GetWidth(bitmap32);
+  height = FreeImage_GetHeight(bitmap32);
+  unsigned int pitch = FreeImage_GetPitch(bitmap32);
+  const BYTE* bits = FreeImage_GetBits(bitmap32);
+
+  // FreeImage keeps the platform colour order, GL gets plain RGBA
+  pixels.resize((size_t)width * height * 4);
+  for (int y = 0; y < height; y++) {
+    const BYTE* source = bits + (size_t)y * pitch;
+    unsigned char* destination = pixels.data() + (size_t)y * width * 4;
+    for (int x = 0; x < width; x++) {
+      destination[x * 4 + 0] = source[x * 4 + FI_RGBA_RED];
+      destination[x * 4 + 1] = source[x * 4 + FI_RGBA_GREEN];
+      destination[x * 4 + 2] = source[x * 4 + FI_RGBA_BLUE];
+      destination[x * 4 + 3] = source[x * 4 + FI_RGBA_ALPHA];
+    }
+  }
+
+  FreeImage_Unload(bitmap32);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool automatic = true;
+  TextureEncoding requestedEncoding = TextureEncoding::RGBA8;
+  std::vector<std::string> sources;
+  bool validArguments = true;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      validArguments = validArguments && parseEncoding(argv[++i], requestedEncoding, automatic);
+    } else {
+      sources.push_back(argv[i]);
+    }
+  }
+
+  if (sources.empty() || !validArguments) {
+    std::cout << "Usage: texcook [--format auto|rgba8|bc1|bc3|bc4|bc5] <image>..." << std::endl;
+    return -1;
+  }
+
+  unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  FreeImage_Initialise(true);
+
+  int failures = 0;
+  for (const std::string& source : sources) {
+    std::vector<unsigned char> pixels;
+    int width, height;
+    if (!decodeImage(source, pixels, width, height)) {
+      failures++;
+      continue;
+    }
+
+    TextureEncoding encoding = automatic ? chooseEncoding(source, pixels) : requestedEncoding;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> cookedBytes = cookTexture(pixels.data(), width, height, encoding, threadCount);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::string cookedPath = cookedTexturePath(source);
+
+    std::ofstream output(cookedPath, std::ios::binary | std::ios::trunc);
+    output.write((const char*)cookedBytes.data(), cookedBytes.size());
+    output.close();
+    if (!output) {
+      std::cout << "Could not write " << cookedPath << std::endl;
+      failures++;
+      continue;
+    }
+
+    const char* encodingNames[] = { "RGBA8", "BC1", "BC3", "BC4", "BC5" };
+    std::cout << source << " -> " << cookedPath << " ("
+	      << width << "x" << height << " " << encodingNames[(int)encoding] << ", "
+	      << cookedBytes.size() << " bytes, "
+	      << elapsed.count() << " ms, "
+	      << (double)width * height / 1000.0 / elapsed.count() << " MPix/s)" << std::endl;
+  }
+
+  FreeImage_DeInitialise();
+  return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,179 @@
+#include "HeadlessContext.h"
+
+// STD
+#include <iostream>
+
+// GLAD
+#include <glad/glad.h>
+
+#ifdef GAME_HEADLESS_EGL
+
+// EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// STD
+#include <cstring>
+
+static EGLDisplay s_Display = EGL_NO_DISPLAY;
+static EGLSurface s_Surface = EGL_NO_SURFACE;
+static EGLContext s_Context = EGL_NO_CONTEXT;
+
+namespace {
+  bool hasExtension(const char* extensions, const char* name) {
+    if (extensions == nullptr) {
+      return false;
+    }
+    size_t length = std::strlen(name);
+    for (const char* found = std::strstr(extensions, name); found != nullptr; found = std::strstr(found + length, name)) {
+      if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  // Mesa's surfaceless platform first, it needs no display server at all
+  EGLDisplay openDisplay() {
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+      PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+	(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+      if (getPlatformDisplay != nullptr) {
+	EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+	  return display;
+	}
+      }
+    }
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+      return display;
+    }
+    return EGL_NO_DISPLAY;
+  }
+}
+
+bool createHeadlessContext() {
+  s_Display = openDisplay();
+  if (s_Display == EGL_NO_DISPLAY || !eglBindAPI(EGL_OPENGL_API)) {
+    std::cout << "Failed to initialize EGL" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config = nullptr;
+  EGLint configCount = 0;
+  eglChooseConfig(s_Display, configAttributes, &config, 1, &configCount);
+
+  // Without surfaceless contexts a small pbuffer has to be current instead
+  bool surfaceless = hasExtension(eglQueryString(s_Display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+  if (configCount == 0 && !surfaceless) {
+    std::cout << "Failed to find an EGL config" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  s_Context = eglCreateContext(s_Display, configCount > 0 ? config : (EGLConfig)nullptr, EGL_NO_CONTEXT, contextAttributes);
+  if (s_Context == EGL_NO_CONTEXT) {
+    std::cout << "Failed to create an EGL context" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  if (!surfaceless) {
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, 64, EGL_HEIGHT, 64, EGL_NONE };
+    s_Surface = eglCreatePbufferSurface(s_Display, config, surfaceAttributes);
+  }
+  if (!eglMakeCurrent(s_Display, s_Surface, s_Surface, s_Context)) {
+    std::cout << "Failed to make the EGL context current" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc) eglGetProcAddress)) {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  std::cout << "GL " << glGetString(GL_VERSION) << " / " << glGetString(GL_RENDERER) << std::endl;
+  return true;
+}
+
+void destroyHeadlessContext() {
+  if (s_Display == EGL_NO_DISPLAY) {
+    return;
+  }
+
+  eglMakeCurrent(s_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (s_Surface != EGL_NO_SURFACE) {
+    eglDestroySurface(s_Display, s_Surface);
+    s_Surface = EGL_NO_SURFACE;
+  }
+  if (s_Context != EGL_NO_CONTEXT) {
+    eglDestroyContext(s_Display, s_Context);
+    s_Context = EGL_NO_CONTEXT;
+  }
+  eglTerminate(s_Display);
+  s_Display = EGL_NO_DISPLAY;
+}
+
+#else
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+static GLFWwindow* s_Window = nullptr;
+
+bool createHeadlessContext() {
+  if (!glfwInit()) {
+    std::cout << "Failed to initialize GLFW" << std::endl;
+    return false;
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+  s_Window = glfwCreateWindow(64, 64, "Test", nullptr, nullptr);
+  if (s_Window == nullptr) {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return false;
+  }
+  glfwMakeContextCurrent(s_Window);
+
+  if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    destroyHeadlessContext();
+    return false;
+  }
+
+  std::cout << "GL " << glGetString(GL_VERSION) << " / " << glGetString(GL_RENDERER) << std::endl;
+  return true;
+}
+
+void destroyHeadlessContext() {
+  if (s_Window != nullptr) {
+    glfwDestroyWindow(s_Window);
+    s_Window = nullptr;
+  }
+  glfwTerminate();
+}
+
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+
+// Creates a GL 3.3 core context with nothing on screen and makes it
+// current, for the tests and benchmarks that need GL. Built with
+// GAME_HEADLESS_EGL it is a surfaceless EGL context, Mesa's
+// EGL_MESA_platform_surfaceless or a pbuffer on the default display, which
+// needs no X or Wayland display. Otherwise it is a hidden GLFW window.
+// Draws should go to a framebuffer of their own.
+bool createHeadlessContext();
+
+void destroyHeadlessContext();
+
+// What a test returns when it got no context, ctest counts it as skipped
+// rather than failed (SKIP_RETURN_CODE in tests/CMakeLists.txt)
+#define HEADLESS_CONTEXT_SKIP 77
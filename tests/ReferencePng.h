@@ -0,0 +1,11 @@
+#pragma once
+
+// STD
+#include <vector>
+#include <cstddef>
+
+// The PNG decoder Texture2D had before its table-driven inflate and SIMD
+// unfiltering, picoPNG 20101224 as it was. bench_png checks the current
+// decoder against it byte for byte.
+int referenceDecodePNG(std::vector<unsigned char>& out_image, int& image_width, int& image_height,
+		       const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true);
@@ -0,0 +1,45 @@
+#include "TestSupport.h"
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+static int s_Failures = 0;
+
+void check(bool condition, const std::string& what) {
+  if (!condition) {
+    std::cout << "FAILED: " << what << std::endl;
+    s_Failures++;
+  }
+}
+
+int checksResult() {
+  if (s_Failures > 0) {
+    std::cout << s_Failures << " checks failed" << std::endl;
+    return 1;
+  }
+  std::cout << "All checks passed" << std::endl;
+  return 0;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<unsigned char> readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write((const char*)bytes.data(), bytes.size());
+  return (bool)file;
+}
+
+bool writeFile(const std::string& path, const std::string& text) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << text;
+  return (bool)file;
+}
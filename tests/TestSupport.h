@@ -0,0 +1,26 @@
+#pragma once
+
+// STD
+#include <string>
+#include <vector>
+#include <chrono>
+
+// What the tests and benchmarks share. A failed check prints what failed
+// and is counted, checksResult() reports them once main is done:
+//
+//   check(image == expected, "the image matches");
+//   return checksResult();
+void check(bool condition, const std::string& what);
+
+// Prints how many checks failed, or that all passed, and returns the
+// exit code for main
+int checksResult();
+
+double millisecondsSince(std::chrono::steady_clock::time_point start);
+
+// Empty if the file can't be read
+std::vector<unsigned char> readFile(const std::string& path);
+
+// Replace the file's contents, false if it can't be written
+bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes);
+bool writeFile(const std::string& path, const std::string& text);
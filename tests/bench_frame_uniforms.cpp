@@ -0,0 +1,219 @@
+// bench_frame_uniforms - camera matrices once per frame in FrameData
+// against once per object, by object count.
+//
+// Usage: bench_frame_uniforms [runs]
+//
+// Draws 10, 100, 1,000 and 10,000 cubes both ways, best of runs frames
+// (10 by default):
+//   per object     every cube works out the view and projection matrices
+//                  and sets them as uniforms, like Cube::update did
+//   frame data     FrameUniforms::update once, each cube only sets its
+//                  model matrix
+// The matrix work (for frame data with its upload), the glUniform calls
+// and the frame time are printed. Rasterization is scissored to one pixel
+// so the frame time is the submission. Both ways have to draw the same
+// image.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Cube.h"
+#include "FrameData.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+#define SCREEN_SIZE 256
+
+const std::string DIRECTORY = "bench_frame_uniforms.tmp";
+
+// shaders/advanced.vert as it was before FrameData
+const char* PER_OBJECT_VERTEX_SHADER =
+  "#version 330 core\n"
+  "layout (location = 0) in vec3 position;\n"
+  "layout (location = 1) in vec2 texCoords;\n"
+  "out vec2 fTexCoords;\n"
+  "uniform mat4 model;\n"
+  "uniform mat4 view;\n"
+  "uniform mat4 projection;\n"
+  "void main() {\n"
+  "  gl_Position = projection * view * model * vec4(position, 1.0f);\n"
+  "  fTexCoords = texCoords;\n"
+  "}\n";
+
+struct FrameCost {
+  double matrixMilliseconds; // Working out the camera matrices
+  double frameMilliseconds;  // Up to glFinish
+  size_t uniformCalls;
+};
+
+std::vector<std::unique_ptr<Graphics::Cube>> makeCubes(int count, Shader& shader, Graphics::Texture& texture) {
+  std::vector<std::unique_ptr<Graphics::Cube>> cubes;
+  for (int i = 0; i < count; i++) {
+    cubes.push_back(std::make_unique<Graphics::Cube>());
+    cubes.back()->setUp(shader);
+    cubes.back()->setTexture(texture);
+    cubes.back()->translate(glm::vec3((i % 100) * 0.3f - 15.0f, (i / 100) * 0.3f - 15.0f, -(i % 7) * 1.0f));
+    cubes.back()->rotate(glm::vec3(1.0f, 1.0f, 0.0f), i * 0.3f);
+  }
+  return cubes;
+}
+
+int main(int argc, char** argv) {
+  int runs = argc > 1 ? std::atoi(argv[1]) : 10;
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  glViewport(0, 0, SCREEN_SIZE, SCREEN_SIZE);
+  glEnable(GL_DEPTH_TEST);
+
+  Game::World world;
+  world.screenWidth = SCREEN_SIZE;
+  world.screenHeight = SCREEN_SIZE;
+  world.camera = Camera(glm::vec3(0.0f, 0.0f, 30.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+  FrameUniforms frameUniforms;
+
+  std::filesystem::remove_all(DIRECTORY);
+  std::filesystem::create_directory(DIRECTORY);
+  std::string perObjectPath = DIRECTORY + "/perObject.vert";
+  {
+    std::ofstream file(perObjectPath, std::ios::trunc);
+    file << PER_OBJECT_VERTEX_SHADER;
+  }
+  Shader perObjectShader(perObjectPath.c_str(), GAME_SOURCE_DIR "/shaders/advanced.frag");
+  Shader frameShader(GAME_SOURCE_DIR "/shaders/advanced.vert", GAME_SOURCE_DIR "/shaders/advanced.frag");
+  GLuint perObjectProgram = perObjectShader.getProgram();
+  GLint viewLocation = glGetUniformLocation(perObjectProgram, "view");
+  GLint projectionLocation = glGetUniformLocation(perObjectProgram, "projection");
+
+  GLuint white;
+  unsigned char texel[] = { 255, 255, 255, 255 };
+  glGenTextures(1, &white);
+  glBindTexture(GL_TEXTURE_2D, white);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  Graphics::Texture texture = { white, "white", TextureType::DIFFUSE };
+
+  // Camera matrices per object, as the update() every shape had
+  std::vector<glm::mat4> views, projections;
+  auto perObjectFrame = [&](std::vector<std::unique_ptr<Graphics::Cube>>& cubes, FrameCost& cost) {
+    views.resize(cubes.size());
+    projections.resize(cubes.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < cubes.size(); i++) {
+      views[i] = world.camera.getViewMatrix();
+      projections[i] = glm::perspective(world.camera.zoom, (float)world.screenWidth / (float)world.screenHeight,
+					FRAME_NEAR_PLANE, FRAME_FAR_PLANE);
+    }
+    cost.matrixMilliseconds = millisecondsSince(start);
+
+    for (size_t i = 0; i < cubes.size(); i++) {
+      glUseProgram(perObjectProgram);
+      glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &views[i][0][0]);
+      glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, &projections[i][0][0]);
+      cubes[i]->render();
+    }
+    cost.uniformCalls = 2 * cubes.size() + Shader::getUniformStats().issued;
+  };
+
+  auto frameDataFrame = [&](std::vector<std::unique_ptr<Graphics::Cube>>& cubes, FrameCost& cost) {
+    auto start = std::chrono::steady_clock::now();
+    frameUniforms.update(world, 0.0f);
+    cost.matrixMilliseconds = millisecondsSince(start);
+    for (auto& cube : cubes) {
+      cube->render();
+    }
+    cost.uniformCalls = Shader::getUniformStats().issued;
+  };
+
+  // Best of runs, the first frame warms up
+  auto measure = [&](std::vector<std::unique_ptr<Graphics::Cube>>& cubes,
+		     const std::function<void(std::vector<std::unique_ptr<Graphics::Cube>>&, FrameCost&)>& frame) {
+    FrameCost best = { 1e9, 1e9, 0 };
+    for (int run = 0; run <= runs; run++) {
+      FrameCost cost = { 0.0, 0.0, 0 };
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glFinish();
+      Shader::resetUniformStats();
+      auto start = std::chrono::steady_clock::now();
+      frame(cubes, cost);
+      glFinish();
+      cost.frameMilliseconds = millisecondsSince(start);
+      if (run > 0) {
+	best.matrixMilliseconds = std::min(best.matrixMilliseconds, cost.matrixMilliseconds);
+	best.frameMilliseconds = std::min(best.frameMilliseconds, cost.frameMilliseconds);
+	best.uniformCalls = cost.uniformCalls;
+      }
+    }
+    return best;
+  };
+
+  std::printf("objects   per object: matrices  uniforms     frame   frame data: matrices  uniforms     frame\n");
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(0, 0, 1, 1);
+  for (int count : { 10, 100, 1000, 10000 }) {
+    auto perObjectCubes = makeCubes(count, perObjectShader, texture);
+    auto frameCubes = makeCubes(count, frameShader, texture);
+    FrameCost perObject = measure(perObjectCubes, perObjectFrame);
+    FrameCost frameData = measure(frameCubes, frameDataFrame);
+
+    std::printf("%7d %20.3f ms %9zu %6.2f ms %20.3f ms %9zu %6.2f ms\n", count, perObject.matrixMilliseconds,
+		perObject.uniformCalls, perObject.frameMilliseconds, frameData.matrixMilliseconds, frameData.uniformCalls,
+		frameData.frameMilliseconds);
+    check(frameData.uniformCalls <= (size_t)count, std::to_string(count) + " objects: at most one uniform call each");
+    check(perObject.uniformCalls >= 3 * (size_t)count, std::to_string(count) + " objects: per object costs three");
+  }
+  glDisable(GL_SCISSOR_TEST);
+
+  // The same picture both ways
+  std::vector<unsigned char> perObjectImage(SCREEN_SIZE * SCREEN_SIZE * 4), frameImage(perObjectImage.size());
+  auto perObjectCubes = makeCubes(50, perObjectShader, texture);
+  auto frameCubes = makeCubes(50, frameShader, texture);
+  measure(perObjectCubes, perObjectFrame);
+  glReadPixels(0, 0, SCREEN_SIZE, SCREEN_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, perObjectImage.data());
+  measure(frameCubes, frameDataFrame);
+  glReadPixels(0, 0, SCREEN_SIZE, SCREEN_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, frameImage.data());
+  size_t covered = 0, different = 0;
+  for (size_t pixel = 0; pixel < frameImage.size(); pixel += 4) {
+    covered += frameImage[pixel] != 0;
+    different += !std::equal(frameImage.begin() + pixel, frameImage.begin() + pixel + 4, perObjectImage.begin() + pixel);
+  }
+  check(covered > 0, "the cubes are in view");
+  check(different <= frameImage.size() / 4 / 500, std::to_string(different) + " pixels differ between the two ways");
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glDeleteTextures(1, &white);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteFramebuffers(1, &framebuffer);
+  std::filesystem::remove_all(DIRECTORY);
+  destroyHeadlessContext();
+
+  return checksResult();
+}
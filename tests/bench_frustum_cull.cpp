@@ -0,0 +1,128 @@
+// bench_frustum_cull - Frustum::cull against one intersects call per
+// object.
+//
+// Usage: bench_frustum_cull [objects] [runs]
+//
+// Scatters unit cubes' bounding spheres (100,000 by default) around a
+// camera with the game's projection, then culls them with the scalar test
+// and with the SIMD one, best of runs (20 by default). Both have to keep
+// the same objects. Moving objects are timed too, their spheres are set
+// again before every cull.
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Frustum.h"
+#include "FrameData.h"
+#include "TestSupport.h"
+
+int main(int argc, char** argv) {
+  int objects = argc > 1 ? std::atoi(argv[1]) : 100000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  // The unit cube's sphere, moved and scaled like Cube::getBoundingSphere
+  BoundingBox cubeBox;
+  BoundingSphere cubeSphere;
+  glm::vec3 corners[2] = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+  computeBounds(corners, 2, sizeof(glm::vec3), cubeBox, cubeSphere);
+
+  std::mt19937 random(16);
+  std::uniform_real_distribution<float> position(-FRAME_FAR_PLANE, FRAME_FAR_PLANE);
+  std::uniform_real_distribution<float> size(0.2f, 3.0f);
+  std::vector<BoundingSphere> spheres;
+  std::vector<glm::mat4> models;
+  for (int i = 0; i < objects; i++) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+    models.push_back(glm::scale(model, glm::vec3(size(random))));
+    spheres.push_back(transformBoundingSphere(cubeSphere, models.back()));
+  }
+
+  BoundingSphereList list;
+  for (auto& sphere : spheres) {
+    list.add(sphere);
+  }
+
+  // Like FrameUniforms, zoom 45 goes to glm::perspective as it is
+  glm::mat4 projection = glm::perspective(45.0f, 1024.0f / 768.0f, FRAME_NEAR_PLANE, FRAME_FAR_PLANE);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum(projection * view);
+
+  std::vector<GLuint> scalarVisible, simdVisible;
+  scalarVisible.reserve(objects);
+  simdVisible.reserve(objects);
+  double scalarBest = 1e9, simdBest = 1e9, movingScalarBest = 1e9, movingSimdBest = 1e9;
+
+  for (int run = 0; run < runs; run++) {
+    auto start = std::chrono::steady_clock::now();
+    scalarVisible.clear();
+    for (int i = 0; i < objects; i++) {
+      if (frustum.intersects(spheres[i])) {
+	scalarVisible.push_back(i);
+      }
+    }
+    scalarBest = std::min(scalarBest, millisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    simdVisible.clear();
+    frustum.cull(list, simdVisible);
+    simdBest = std::min(simdBest, millisecondsSince(start));
+
+    // Every object moved: the sphere follows its model matrix first
+    start = std::chrono::steady_clock::now();
+    scalarVisible.clear();
+    for (int i = 0; i < objects; i++) {
+      if (frustum.intersects(transformBoundingSphere(cubeSphere, models[i]))) {
+	scalarVisible.push_back(i);
+      }
+    }
+    movingScalarBest = std::min(movingScalarBest, millisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    simdVisible.clear();
+    for (int i = 0; i < objects; i++) {
+      list.set(i, transformBoundingSphere(cubeSphere, models[i]));
+    }
+    frustum.cull(list, simdVisible);
+    movingSimdBest = std::min(movingSimdBest, millisecondsSince(start));
+  }
+
+  std::printf("%d objects, %zu in the frustum, best of %d\n", objects, simdVisible.size(), runs);
+  std::printf("                 intersects       cull  speedup\n");
+  std::printf("static     %12.3f ms %7.3f ms %7.2fx\n", scalarBest, simdBest, scalarBest / simdBest);
+  std::printf("moving     %12.3f ms %7.3f ms %7.2fx\n", movingScalarBest, movingSimdBest, movingScalarBest / movingSimdBest);
+
+  // The lanes add the plane terms in another order, a sphere just touching
+  // a plane may come out either way
+  std::vector<GLuint> difference;
+  std::set_symmetric_difference(scalarVisible.begin(), scalarVisible.end(), simdVisible.begin(), simdVisible.end(),
+				std::back_inserter(difference));
+  for (GLuint i : difference) {
+    float closest = 1e9f;
+    glm::mat4 viewProjection = projection * view;
+    for (int axis = 0; axis < 3; axis++) {
+      for (float sign : { 1.0f, -1.0f }) {
+	glm::vec4 plane;
+	for (int column = 0; column < 4; column++) {
+	  plane[column] = viewProjection[column][3] + sign * viewProjection[column][axis];
+	}
+	plane /= glm::length(glm::vec3(plane));
+	closest = std::min(closest, std::abs(glm::dot(glm::vec3(plane), spheres[i].center) + plane.w + spheres[i].radius));
+      }
+    }
+    check(closest < 1e-4f, "object " + std::to_string(i) + " is kept by only one of the tests");
+  }
+  check(!simdVisible.empty() && simdVisible.size() < (size_t)objects, "the frustum keeps some objects and drops others");
+
+  return checksResult();
+}
@@ -0,0 +1,207 @@
+// bench_instancing - one instanced draw against one draw per object, for
+// cubes and for models.
+//
+// Usage: bench_instancing [objects] [runs]
+//
+// Draws a grid of textured cubes (10,000 by default) once with a Cube per
+// object and Cube::render, and once with a single Cube and
+// Cube::renderInstanced. Then the same for a small model with Model::draw
+// per object against Model::drawInstanced. The frame time (submission up
+// to glFinish) is the best of runs (5 by default). Both ways have to
+// render the same image.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Cube.h"
+#include "Model.h"
+#include "FrameData.h"
+#include "InstanceBuffer.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+#define SCREEN_SIZE 256
+
+// Times draw over runs frames and returns the best, the last frame's
+// pixels are left in image
+double timeFrames(int runs, const std::function<void()>& draw, std::vector<unsigned char>& image) {
+  double best = 1e9;
+  for (int run = 0; run < runs; run++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    draw();
+    glFinish();
+    best = std::min(best, millisecondsSince(start));
+  }
+  image.resize(SCREEN_SIZE * SCREEN_SIZE * 4);
+  glReadPixels(0, 0, SCREEN_SIZE, SCREEN_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+  return best;
+}
+
+// Rasterization may round a shared edge differently, a few pixels can
+void compareImages(const std::string& name, const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+  size_t different = 0, covered = 0;
+  for (size_t pixel = 0; pixel < a.size(); pixel += 4) {
+    different += !std::equal(a.begin() + pixel, a.begin() + pixel + 4, b.begin() + pixel);
+    covered += a[pixel] != 0 || a[pixel + 1] != 0 || a[pixel + 2] != 0;
+  }
+  check(covered > a.size() / 4 / 8, name + ": the objects cover the image");
+  check(different <= a.size() / 4 / 500, name + ": " + std::to_string(different) + " pixels differ");
+}
+
+bool writeQuadObj(const std::string& path) {
+  std::ofstream file(path, std::ios::trunc);
+  file << "v -0.5 -0.5 0\nv 0.5 -0.5 0\nv 0.5 0.5 0\nv -0.5 0.5 0\n"
+       << "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n"
+       << "f 1/1/1 2/2/1 3/3/1 4/4/1\n";
+  return (bool)file;
+}
+
+int main(int argc, char** argv) {
+  int objects = argc > 1 ? std::atoi(argv[1]) : 10000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  glViewport(0, 0, SCREEN_SIZE, SCREEN_SIZE);
+  glEnable(GL_DEPTH_TEST);
+
+  // A square grid of objects filling the view
+  int side = 1;
+  while (side * side < objects) {
+    side++;
+  }
+  float spacing = 0.5f;
+  std::vector<InstanceData> instances;
+  for (int i = 0; i < objects; i++) {
+    glm::vec3 position(((i % side) - side * 0.5f) * spacing, ((i / side) - side * 0.5f) * spacing, 0.0f);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    instances.push_back({ glm::scale(glm::rotate(model, 0.3f * i, glm::vec3(1.0f, 1.0f, 0.0f)), glm::vec3(0.4f)),
+			  glm::vec4(1.0f) });
+  }
+
+  Game::World world;
+  world.screenWidth = SCREEN_SIZE;
+  world.screenHeight = SCREEN_SIZE;
+  world.camera = Camera(glm::vec3(0.0f, 0.0f, side * spacing * 1.25f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+  FrameUniforms frameUniforms;
+  frameUniforms.update(world, 0.0f);
+
+  InstanceBuffer instanceBuffer;
+  instanceBuffer.update(instances);
+
+  // A 2x2 checker, so the texture coordinates show in the images
+  GLuint checker;
+  unsigned char texels[] = { 255, 64, 64, 255, 64, 255, 64, 255, 64, 64, 255, 255, 255, 255, 64, 255 };
+  glGenTextures(1, &checker);
+  glBindTexture(GL_TEXTURE_2D, checker);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  Graphics::Texture texture = { checker, "checker", TextureType::DIFFUSE };
+
+  // Cubes
+  Shader cubeShader(GAME_SOURCE_DIR "/shaders/advanced.vert", GAME_SOURCE_DIR "/shaders/advanced.frag");
+  Shader cubeInstancedShader(GAME_SOURCE_DIR "/shaders/advancedInstanced.vert", GAME_SOURCE_DIR "/shaders/advancedInstanced.frag");
+
+  std::vector<std::unique_ptr<Graphics::Cube>> cubes;
+  for (int i = 0; i < objects; i++) {
+    cubes.push_back(std::make_unique<Graphics::Cube>());
+    cubes.back()->setUp(cubeShader);
+    cubes.back()->setTexture(texture);
+    // The cube's own matrix is the instance's
+    glm::mat4 model = instances[i].model;
+    cubes.back()->translate(glm::vec3(model[3]));
+    cubes.back()->rotate(glm::vec3(1.0f, 1.0f, 0.0f), 0.3f * i);
+    cubes.back()->scale(glm::vec3(0.4f));
+  }
+  Graphics::Cube instancedCube;
+  instancedCube.setUp(cubeInstancedShader);
+  instancedCube.setTexture(texture);
+
+  std::vector<unsigned char> separateImage, instancedImage;
+  double cubeSeparate = timeFrames(runs, [&]() {
+      for (auto& cube : cubes) {
+	cube->render();
+      }
+    }, separateImage);
+  double cubeInstanced = timeFrames(runs, [&]() { instancedCube.renderInstanced(instanceBuffer); }, instancedImage);
+  compareImages("cubes", separateImage, instancedImage);
+
+  // Models, a quad whose material packs into arrays
+  std::string path = "bench_instancing.obj";
+  std::string cachePath = modelCachePath(path);
+  std::remove(cachePath.c_str());
+  check(writeQuadObj(path), "the model is written");
+  TextureLoader loader;
+  Model model(path, loader, true);
+  Shader modelShader(GAME_SOURCE_DIR "/shaders/modelArray.vert", GAME_SOURCE_DIR "/shaders/modelArray.frag");
+  Shader modelInstancedShader(GAME_SOURCE_DIR "/shaders/modelArrayInstanced.vert",
+			      GAME_SOURCE_DIR "/shaders/modelArrayInstanced.frag");
+
+  size_t separateDrawCalls = 0, instancedDrawCalls = 0;
+  double modelSeparate = timeFrames(runs, [&]() {
+      separateDrawCalls = 0;
+      modelShader.use();
+      for (auto& instance : instances) {
+	model.draw(&modelShader, instance.model);
+	separateDrawCalls += model.getDrawStats().drawCalls;
+      }
+      modelShader.unuse();
+    }, separateImage);
+  double modelInstanced = timeFrames(runs, [&]() {
+      modelInstancedShader.use();
+      model.drawInstanced(&modelInstancedShader, instanceBuffer);
+      instancedDrawCalls = model.getDrawStats().drawCalls;
+      modelInstancedShader.unuse();
+    }, instancedImage);
+  compareImages("models", separateImage, instancedImage);
+
+  std::printf("%d objects, %dx%d, best of %d\n", objects, SCREEN_SIZE, SCREEN_SIZE, runs);
+  std::printf("           separate   draws    instanced   draws  speedup\n");
+  std::printf("cubes  %9.2f ms %7d %9.2f ms %7d %7.2fx\n", cubeSeparate, objects, cubeInstanced, 1,
+	      cubeSeparate / cubeInstanced);
+  std::printf("models %9.2f ms %7zu %9.2f ms %7zu %7.2fx\n", modelSeparate, separateDrawCalls, modelInstanced,
+	      instancedDrawCalls, modelSeparate / modelInstanced);
+
+  check(instancedDrawCalls == 1 && separateDrawCalls == (size_t)objects, "one draw call for every model instance");
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glDeleteTextures(1, &checker);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteFramebuffers(1, &framebuffer);
+  std::remove(cachePath.c_str());
+  std::remove(path.c_str());
+  loader.releaseUploadRing();
+  destroyHeadlessContext();
+
+  return checksResult();
+}
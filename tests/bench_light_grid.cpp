@@ -0,0 +1,281 @@
+// bench_light_grid - LightGrid binning and clustered shading at 4, 256 and
+// 4,096 lights.
+//
+// Usage: bench_light_grid [runs]
+//
+// Lights are scattered over a floor in front of the camera. For each
+// count the grid is binned (best of runs, 30 by default) and the floor is
+// drawn with the CLUSTERED_LIGHTS variant of Shaders/lightShader, built
+// through ShaderPermutations like a scene would. The binning has to be
+// conservative: every light that reaches a point has to be listed in the
+// point's cluster. With 4 lights the clustered variant has to draw what
+// the variant with 4 point light uniforms draws, less what falls below
+// LIGHT_CUTOFF_INTENSITY.
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "LightGrid.h"
+#include "ShaderPermutations.h"
+#include "FrameData.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 180
+
+// Lights just above the floor, a quarter of them spotlights pointing down
+std::vector<Light> makeLights(int count, unsigned int seed, bool spotLights = true) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Light> lights(count);
+  for (Light& light : lights) {
+    light.color = glm::vec3(unit(random), unit(random), unit(random)) * 0.8f + 0.2f;
+    light.constant = 1.0f;
+    light.linear = 0.7f;
+    light.quadratic = 20.0f;
+    light.type = spotLights && unit(random) < 0.25f ? LightType::SPOT : LightType::POINT;
+    light.position = glm::vec3(unit(random) * 40.0f - 20.0f, unit(random) + 0.2f, 5.0f - unit(random) * 60.0f);
+    light.direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f));
+    light.cutOff = std::cos(glm::radians(20.0f));
+    light.outerCutOff = std::cos(glm::radians(30.0f));
+  }
+  return lights;
+}
+
+// Samples points in view and looks for lights in range that their
+// cluster does not list. Returns the light and point pairs checked.
+size_t checkConservative(const LightGrid& grid, const std::vector<Light>& lights, const FrameData& frame) {
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float depthScale = LIGHT_GRID_Z / std::log(FRAME_FAR_PLANE / FRAME_NEAR_PLANE);
+  float depthBias = -depthScale * std::log(FRAME_NEAR_PLANE);
+  size_t checked = 0, missing = 0;
+
+  for (int sample = 0; sample < 200000; sample++) {
+    glm::vec3 point(unit(random) * 50.0f - 25.0f, unit(random) * 4.0f - 1.0f, 8.0f - unit(random) * 70.0f);
+    glm::vec4 clip = frame.viewProjection * glm::vec4(point, 1.0f);
+    if (clip.w <= 0.0f) {
+      continue;
+    }
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    if (std::abs(ndc.x) >= 1.0f || std::abs(ndc.y) >= 1.0f || std::abs(ndc.z) >= 1.0f) {
+      continue;
+    }
+
+    float depth = -(frame.view * glm::vec4(point, 1.0f)).z;
+    int x = std::min((int)((ndc.x * 0.5f + 0.5f) * LIGHT_GRID_X), LIGHT_GRID_X - 1);
+    int y = std::min((int)((ndc.y * 0.5f + 0.5f) * LIGHT_GRID_Y), LIGHT_GRID_Y - 1);
+    int z = std::max(0, std::min((int)std::floor(std::log(depth) * depthScale + depthBias), LIGHT_GRID_Z - 1));
+    size_t cell = ((size_t)z * LIGHT_GRID_Y + y) * LIGHT_GRID_X + x;
+    auto first = grid.indices().begin() + grid.cells()[cell * 2];
+    auto last = first + grid.cells()[cell * 2 + 1];
+
+    for (size_t light = 0; light < lights.size(); light++) {
+      if (glm::length(lights[light].position - point) >= lightRange(lights[light])) {
+	continue;
+      }
+      checked++;
+      if (std::find(first, last, (GLuint)light) == last) {
+	missing++;
+      }
+    }
+  }
+
+  check(missing == 0, std::to_string(missing) + " lights in range are missing from their cluster");
+  return checked;
+}
+
+int main(int argc, char** argv) {
+  int runs = argc > 1 ? std::atoi(argv[1]) : 30;
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glEnable(GL_DEPTH_TEST);
+
+  // Looking down the floor
+  Game::World world;
+  world.screenWidth = SCREEN_WIDTH;
+  world.screenHeight = SCREEN_HEIGHT;
+  world.camera = Camera(glm::vec3(0.0f, 3.0f, 8.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -15.0f);
+  FrameUniforms frameUniforms;
+  frameUniforms.update(world, 0.0f);
+  const FrameData& frame = frameUniforms.data();
+
+  // The floor: position, normal, texture coordinates
+  float floor[] = {
+    -30.0f, 0.0f, -80.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+    30.0f, 0.0f, -80.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+    30.0f, 0.0f, 10.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
+    -30.0f, 0.0f, -80.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+    30.0f, 0.0f, 10.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
+    -30.0f, 0.0f, 10.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f
+  };
+  GLuint vertexArray, vertexBuffer;
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+  glGenBuffers(1, &vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(floor), floor, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+
+  GLuint white;
+  unsigned char texel[] = { 255, 255, 255, 255 };
+  glGenTextures(1, &white);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, white);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+  // The variants a scene with these lights would ask for
+  ShaderPermutations permutations(GAME_SOURCE_DIR "/Shaders/lightShader.vert", GAME_SOURCE_DIR "/Shaders/lightShader.frag");
+  Shader& pointShader = permutations.get({ false, 4, false, false, false, false });
+  Shader& clusteredShader = permutations.get({ false, 0, false, false, false, true });
+  for (int wait = 0; wait < 100 && Shader::pendingCompiles() > 0; wait++) {
+    Shader::processCompiles();
+  }
+  check(pointShader.isReady() && clusteredShader.isReady(), "the variants compile");
+
+  LightGrid grid;
+  auto draw = [&](Shader& shader, const std::vector<Light>* clusteredLights, const std::vector<Light>& pointLights,
+		  std::vector<unsigned char>& image) {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    shader.use();
+    shader.setMat4(UNIFORM("model"), glm::mat4(1.0f));
+    shader.setInt(UNIFORM("material.diffuse"), 0);
+    shader.setVec3(UNIFORM("material.specularColor"), glm::vec3(0.5f));
+    shader.setFloat(UNIFORM("material.shininess"), 32.0f);
+    if (clusteredLights != nullptr) {
+      grid.update(*clusteredLights, frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+      grid.bind(shader);
+    }
+    for (size_t i = 0; i < pointLights.size(); i++) {
+      std::string name = "pointLights[" + std::to_string(i) + "].";
+      shader.setVec3(uniformHash((name + "position").c_str()), pointLights[i].position);
+      shader.setFloat(uniformHash((name + "constant").c_str()), pointLights[i].constant);
+      shader.setFloat(uniformHash((name + "linear").c_str()), pointLights[i].linear);
+      shader.setFloat(uniformHash((name + "quadratic").c_str()), pointLights[i].quadratic);
+      shader.setVec3(uniformHash((name + "ambient").c_str()), glm::vec3(0.0f));
+      shader.setVec3(uniformHash((name + "diffuse").c_str()), pointLights[i].color);
+      shader.setVec3(uniformHash((name + "specular").c_str()), pointLights[i].color);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    shader.unuse();
+    image.resize(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+    glReadPixels(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+  };
+
+  // Conservative binning, checked on the densest grid
+  std::vector<Light> dense = makeLights(4096, 7);
+  grid.update(dense, frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+  size_t checked = checkConservative(grid, dense, frame);
+  std::printf("%zu light and point pairs in range checked against their clusters\n\n", checked);
+
+  std::printf("lights  visible   bin        indices  per cluster  max   clustered frame\n");
+  std::vector<unsigned char> image;
+  for (int count : { 4, 256, 4096 }) {
+    std::vector<Light> lights = makeLights(count, 11);
+    double binBest = 1e9;
+    for (int run = 0; run < runs; run++) {
+      grid.update(lights, frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+      binBest = std::min(binBest, grid.getStats().binMilliseconds);
+    }
+    LightGridStats stats = grid.getStats();
+    size_t occupied = 0;
+    for (size_t cell = 0; cell < grid.cells().size() / 2; cell++) {
+      occupied += grid.cells()[cell * 2 + 1] > 0;
+    }
+
+    double frameBest = 1e9;
+    for (int run = 0; run < 5; run++) {
+      glFinish();
+      auto start = std::chrono::steady_clock::now();
+      draw(clusteredShader, &lights, {}, image);
+      frameBest = std::min(frameBest, millisecondsSince(start));
+    }
+
+    std::printf("%6d %8zu %6.3f ms %10zu %12.1f %4zu %12.2f ms\n", count, stats.visible, binBest, stats.indices,
+		occupied > 0 ? (double)stats.indices / occupied : 0.0, stats.maxPerCluster, frameBest);
+    check(stats.lights == (size_t)count && stats.visible > 0 && stats.visible <= stats.lights,
+	  std::to_string(count) + " lights: some are in view");
+  }
+
+  // The same 4 point lights through uniforms and through the grid
+  // near the camera and reaching far enough to light a good part of the floor
+  std::vector<Light> four = makeLights(4, 5, false);
+  glm::vec3 positions[] = { glm::vec3(-4.0f, 1.0f, -4.0f), glm::vec3(4.0f, 0.5f, -8.0f),
+			    glm::vec3(-1.0f, 1.5f, -14.0f), glm::vec3(2.0f, 0.5f, 0.0f) };
+  for (size_t i = 0; i < four.size(); i++) {
+    four[i].position = positions[i];
+    four[i].linear = 0.35f;
+    four[i].quadratic = 0.44f;
+  }
+  std::vector<unsigned char> pointImage, clusteredImage;
+  double pointMilliseconds = 1e9, clusteredMilliseconds = 1e9;
+  for (int run = 0; run < 5; run++) {
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    draw(pointShader, nullptr, four, pointImage);
+    pointMilliseconds = std::min(pointMilliseconds, millisecondsSince(start));
+    start = std::chrono::steady_clock::now();
+    draw(clusteredShader, &four, {}, clusteredImage);
+    clusteredMilliseconds = std::min(clusteredMilliseconds, millisecondsSince(start));
+  }
+
+  size_t lit = 0;
+  int maxDifference = 0;
+  for (size_t pixel = 0; pixel < pointImage.size(); pixel += 4) {
+    lit += pointImage[pixel] + pointImage[pixel + 1] + pointImage[pixel + 2] > 0;
+    for (int channel = 0; channel < 3; channel++) {
+      maxDifference = std::max(maxDifference, std::abs(pointImage[pixel + channel] - clusteredImage[pixel + channel]));
+    }
+  }
+  std::printf("\n4 point lights: uniforms %.2f ms, clustered %.2f ms, %zu lit pixels, %d apart at most\n",
+	      pointMilliseconds, clusteredMilliseconds, lit, maxDifference);
+  check(lit > SCREEN_WIDTH * SCREEN_HEIGHT / 10, "the point lights light the floor");
+  check(maxDifference <= 2, "the clustered variant draws what the uniforms draw");
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glDeleteTextures(1, &white);
+  glBindVertexArray(0);
+  glDeleteBuffers(1, &vertexBuffer);
+  glDeleteVertexArrays(1, &vertexArray);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteFramebuffers(1, &framebuffer);
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,119 @@
+// bench_model_threads - mesh conversion time from 1 to N threads.
+//
+// Usage: bench_model_threads [meshes] [grid] [runs]
+//
+// Writes a synthetic OBJ of meshes separate grid x grid quad patches
+// (512 and 24 by default), then loads it with Model at 1, 2, 4, ... threads
+// up to twice the core count and reports the best conversion time of
+// runs loads (3 by default). The model cache is deleted before every load
+// so Assimp always imports. The caches written at every thread count have
+// to be byte for byte the same as the one thread cache.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include "Model.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+// Each mesh is a wavy patch of its own, so the welding and LOD passes
+// have real work to do
+bool writeSyntheticObj(const std::string& path, int meshes, int grid) {
+  std::ofstream file(path, std::ios::trunc);
+  int vertexBase = 1;
+  int side = grid + 1;
+
+  for (int mesh = 0; mesh < meshes; mesh++) {
+    file << "o patch_" << mesh << "\n";
+    float originX = (float)(mesh % 32) * grid;
+    float originZ = (float)(mesh / 32) * grid;
+
+    for (int z = 0; z < side; z++) {
+      for (int x = 0; x < side; x++) {
+	float height = 0.25f * std::sin((originX + x) * 0.3f) * std::cos((originZ + z) * 0.2f);
+	file << "v " << originX + x << " " << height << " " << originZ + z << "\n"
+	     << "vt " << (float)x / grid << " " << (float)z / grid << "\n"
+	     << "vn 0 1 0\n";
+      }
+    }
+
+    for (int z = 0; z < grid; z++) {
+      for (int x = 0; x < grid; x++) {
+	int a = vertexBase + z * side + x;
+	int b = a + 1;
+	int c = a + side;
+	int d = c + 1;
+	file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " "
+	     << d << "/" << d << "/" << d << " " << b << "/" << b << "/" << b << "\n";
+      }
+    }
+    vertexBase += side * side;
+  }
+
+  return (bool)file;
+}
+
+int main(int argc, char** argv) {
+  int meshes = argc > 1 ? std::atoi(argv[1]) : 512;
+  int grid = argc > 2 ? std::atoi(argv[2]) : 24;
+  int runs = argc > 3 ? std::atoi(argv[3]) : 3;
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  std::string path = "bench_model_threads.obj";
+  std::string cachePath = modelCachePath(path);
+  if (!writeSyntheticObj(path, meshes, grid)) {
+    std::cout << "Could not write " << path << std::endl;
+    return 1;
+  }
+
+  unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int threads = 1; threads <= std::max(2 * cores, 8u); threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+
+  TextureLoader loader;
+  std::vector<unsigned char> serialCache;
+  std::vector<double> best(threadCounts.size(), 1e9);
+  size_t vertices = 0;
+
+  for (size_t i = 0; i < threadCounts.size(); i++) {
+    for (int run = 0; run < runs; run++) {
+      std::remove(cachePath.c_str());
+      Model model(path, loader, false, VertexFormat::FLOAT32, threadCounts[i]);
+      best[i] = std::min(best[i], model.getGeometryStats().conversionMilliseconds);
+      vertices = model.getGeometryStats().importedVertices;
+
+      std::vector<unsigned char> cache = readFile(cachePath);
+      if (i == 0 && run == 0) {
+	serialCache = cache;
+      } else {
+	check(cache == serialCache && !cache.empty(), std::to_string(threadCounts[i]) + " threads write the same cache");
+      }
+    }
+  }
+
+  std::printf("\n%d meshes, %zu imported vertices, best of %d, %u cores\n", meshes, vertices, runs, cores);
+  std::printf("threads   conversion   speedup\n");
+  for (size_t i = 0; i < threadCounts.size(); i++) {
+    std::printf("%7u %9.1f ms %8.2fx\n", threadCounts[i], best[i], best[0] / best[i]);
+  }
+
+  std::remove(cachePath.c_str());
+  std::remove(path.c_str());
+  loader.releaseUploadRing();
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,265 @@
+// test_block_compression - BC1/BC3/BC4/BC5 quality, encode speed and how
+// the cooked formats sample.
+//
+// Usage: test_block_compression
+//
+// The Nanosuit maps are encoded with the format texcook picks for them and
+// have to stay above a PSNR floor. Normal maps also have to keep their
+// direction once z is rebuilt from the two BC5 channels, the way
+// lightShader.frag does it. A cooked BC4 texture has to sample as grey
+// with full alpha, not as red. Encode throughput is printed per image.
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "BlockCompression.h"
+#include "CookedTexture.h"
+#include "TextureLoader.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+const char* encodingName(TextureEncoding encoding) {
+  switch (encoding) {
+  case TextureEncoding::BC1: return "BC1";
+  case TextureEncoding::BC3: return "BC3";
+  case TextureEncoding::BC4: return "BC4";
+  case TextureEncoding::BC5: return "BC5";
+  default: return "RGBA8";
+  }
+}
+
+// The image as the FreeImage path uploads it, read back as RGBA8
+bool decodeImage(TextureLoader& loader, const std::string& path,
+		 std::vector<unsigned char>& pixels, int& width, int& height) {
+  GLuint textureId = loader.loadTexture(path);
+  if (textureId == (GLuint)-1) {
+    return false;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  pixels.resize((size_t)width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDeleteTextures(1, &textureId);
+  return true;
+}
+
+// z of a normal rebuilt from its red and green channels, as lightShader.frag does
+void rebuildNormal(const unsigned char* texel, double normal[3]) {
+  normal[0] = texel[0] / 255.0 * 2.0 - 1.0;
+  normal[1] = texel[1] / 255.0 * 2.0 - 1.0;
+  normal[2] = std::sqrt(std::max(1.0 - normal[0] * normal[0] - normal[1] * normal[1], 0.0));
+}
+
+// Mean angle in degrees between the normals the shader rebuilds from the
+// source and from the decoded blocks. The Nanosuit maps aren't unit
+// length, so the stored z can't be the reference.
+double normalError(const std::vector<unsigned char>& original, const std::vector<unsigned char>& decoded) {
+  double total = 0.0;
+  size_t count = original.size() / 4;
+
+  for (size_t i = 0; i < count; i++) {
+    double source[3], rebuilt[3];
+    rebuildNormal(&original[i * 4], source);
+    rebuildNormal(&decoded[i * 4], rebuilt);
+
+    double dot = 0.0, sourceLength = 0.0, rebuiltLength = 0.0;
+    for (int axis = 0; axis < 3; axis++) {
+      dot += source[axis] * rebuilt[axis];
+      sourceLength += source[axis] * source[axis];
+      rebuiltLength += rebuilt[axis] * rebuilt[axis];
+    }
+
+    double cosine = dot / std::sqrt(sourceLength * rebuiltLength);
+    total += std::acos(std::min(std::max(cosine, -1.0), 1.0)) * 180.0 / M_PI;
+  }
+
+  return total / count;
+}
+
+void testQuality(TextureLoader& loader, const std::string& name, TextureEncoding encoding, double minPSNR) {
+  std::string prefix = name + " " + encodingName(encoding) + ": ";
+  std::vector<unsigned char> pixels;
+  int width = 0, height = 0;
+  bool decoded = decodeImage(loader, GAME_SOURCE_DIR "/Assets/Models/Nanosuit/" + name, pixels, width, height);
+  check(decoded, prefix + "the source decodes");
+  if (!decoded) {
+    return;
+  }
+
+  unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned char> blocks(compressedImageBytes(encoding, width, height));
+
+  // Best of three, the first run also pages the buffers in
+  double seconds = 1e9;
+  for (int run = 0; run < 3; run++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    compressImage(encoding, pixels.data(), width, height, blocks.data(), threadCount);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    seconds = std::min(seconds, elapsed.count());
+  }
+
+  std::vector<unsigned char> roundTrip(pixels.size());
+  decompressImage(encoding, blocks.data(), width, height, roundTrip.data());
+  double psnr = compressionPSNR(encoding, pixels.data(), roundTrip.data(), width, height);
+
+  std::printf("%-24s %s %5dx%-5d %6.2f dB %8.1f MPixel/s (%u threads)\n", name.c_str(), encodingName(encoding),
+	      width, height, psnr, width * height / seconds / 1e6, threadCount);
+  check(psnr >= minPSNR, prefix + "PSNR " + std::to_string(psnr) + " below " + std::to_string(minPSNR));
+
+  if (encoding == TextureEncoding::BC5) {
+    double degrees = normalError(pixels, roundTrip);
+    std::printf("%-24s %s mean normal error %.2f degrees\n", name.c_str(), encodingName(encoding), degrees);
+    check(degrees < 1.0, prefix + "rebuilt normals are " + std::to_string(degrees) + " degrees off");
+  }
+}
+
+// Where level 0 starts in a cooked file
+size_t cookedLevel0(const std::vector<unsigned char>& file) {
+  return (size_t)((const CookedTextureLevel*)(file.data() + sizeof(CookedTextureHeader)))[0].offset;
+}
+
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource) {
+  GLuint program = glCreateProgram();
+  const char* sources[2] = { vertexSource, fragmentSource };
+  const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+
+  for (int i = 0; i < 2; i++) {
+    GLuint shader = glCreateShader(types[i]);
+    glShaderSource(shader, 1, &sources[i], nullptr);
+    glCompileShader(shader);
+    glAttachShader(program, shader);
+    glDeleteShader(shader);
+  }
+
+  glLinkProgram(program);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  check(linked == GL_TRUE, "the sampling program links");
+  return program;
+}
+
+// Draws every texel of level 0 into a framebuffer and reads the result
+std::vector<unsigned char> sampleTexture(GLuint textureId, int width, int height) {
+  const char* vertexSource =
+    "#version 330 core\n"
+    "void main() {\n"
+    "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;\n"
+    "  gl_Position = vec4(corner, 0.0, 1.0);\n"
+    "}\n";
+  const char* fragmentSource =
+    "#version 330 core\n"
+    "uniform sampler2D image;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  color = texelFetch(image, ivec2(gl_FragCoord.xy), 0);\n"
+    "}\n";
+  GLuint program = compileProgram(vertexSource, fragmentSource);
+
+  GLuint target, framebuffer, vertexArray;
+  glGenTextures(1, &target);
+  glBindTexture(GL_TEXTURE_2D, target);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+
+  glViewport(0, 0, width, height);
+  glUseProgram(program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glUniform1i(glGetUniformLocation(program, "image"), 0);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 3);
+
+  std::vector<unsigned char> texels((size_t)width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteTextures(1, &target);
+  glDeleteProgram(program);
+  return texels;
+}
+
+void testSpecularSampling(TextureLoader& loader) {
+  // Only the cooked file exists, so the loader takes it as is
+  std::string imagePath = "test_block_compression_spec.png";
+  std::string cookedPath = cookedTexturePath(imagePath);
+
+  const int width = 32, height = 32;
+  std::vector<unsigned char> pixels((size_t)width * height * 4);
+  for (int i = 0; i < width * height; i++) {
+    pixels[i * 4 + 0] = (unsigned char)(i * 5);
+    pixels[i * 4 + 1] = 17;
+    pixels[i * 4 + 2] = 230;
+    pixels[i * 4 + 3] = 90;
+  }
+
+  std::vector<unsigned char> file = cookTexture(pixels.data(), width, height, TextureEncoding::BC4);
+  FILE* out = std::fopen(cookedPath.c_str(), "wb");
+  check(out != nullptr && std::fwrite(file.data(), 1, file.size(), out) == file.size(), "the BC4 file is written");
+  if (out != nullptr) {
+    std::fclose(out);
+  }
+
+  GLuint textureId = loader.loadTexture(imagePath);
+  check(textureId != (GLuint)-1, "the BC4 file uploads");
+  if (textureId != (GLuint)-1) {
+    std::vector<unsigned char> expected(pixels.size());
+    decompressImage(TextureEncoding::BC4, file.data() + cookedLevel0(file), width, height, expected.data());
+    std::vector<unsigned char> sampled = sampleTexture(textureId, width, height);
+
+    // GPUs interpolate the BC4 palette at their own precision, one step off is fine
+    bool grey = true;
+    for (int i = 0; i < width * height; i++) {
+      const unsigned char* texel = &sampled[i * 4];
+      grey = grey && std::abs(texel[0] - expected[i * 4]) <= 1 &&
+	texel[1] == texel[0] && texel[2] == texel[0] && texel[3] == 255;
+    }
+    check(grey, "BC4 samples as (r, r, r, 1)");
+    glDeleteTextures(1, &textureId);
+  }
+
+  std::remove(cookedPath.c_str());
+}
+
+int main() {
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  TextureLoader loader;
+
+  // The formats texcook picks for these maps
+  testQuality(loader, "body_dif.png", TextureEncoding::BC1, 30.0);
+  testQuality(loader, "helmet_diff.png", TextureEncoding::BC1, 30.0);
+  testQuality(loader, "glass_dif.png", TextureEncoding::BC3, 30.0);
+  testQuality(loader, "body_showroom_spec.png", TextureEncoding::BC4, 35.0);
+  testQuality(loader, "helmet_showroom_spec.png", TextureEncoding::BC4, 35.0);
+  testQuality(loader, "body_showroom_ddn.png", TextureEncoding::BC5, 35.0);
+  testQuality(loader, "helmet_showroom_ddn.png", TextureEncoding::BC5, 35.0);
+
+  testSpecularSampling(loader);
+
+  destroyHeadlessContext();
+
+  return checksResult();
+}
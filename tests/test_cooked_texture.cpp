@@ -0,0 +1,175 @@
+// test_cooked_texture - cooked textures against the images they come from.
+//
+// Usage: test_cooked_texture <texcook>
+//
+// Each source image is loaded through TextureLoader's FreeImage path,
+// cooked to RGBA8 by running texcook, then mapped with CookedTexture and
+// loaded again through the cooked path. The cooked file and both uploads
+// have to hold the same texels. CookedTexture::open also has to turn down
+// damaged files before any of their levels reach GL.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <functional>
+#include <cstdio>
+
+#include <filesystem>
+#include <cstdlib>
+
+// GLAD
+#include <glad/glad.h>
+
+#include "CookedTexture.h"
+#include "TextureLoader.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+bool opens(const std::string& path, const std::vector<unsigned char>& bytes) {
+  CookedTexture cooked;
+  return writeFile(path, bytes) && cooked.open(path);
+}
+
+CookedTextureHeader& headerOf(std::vector<unsigned char>& bytes) {
+  return *(CookedTextureHeader*)bytes.data();
+}
+
+CookedTextureLevel& levelOf(std::vector<unsigned char>& bytes, uint32_t index) {
+  return ((CookedTextureLevel*)(bytes.data() + sizeof(CookedTextureHeader)))[index];
+}
+
+// Texels of a texture level as GL stores them, rows bottom to top
+std::vector<unsigned char> readLevel(GLuint textureId, GLint level) {
+  GLint width = 0, height = 0;
+  glBindTexture(GL_TEXTURE_2D, textureId);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+
+  std::vector<unsigned char> texels((size_t)width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texels;
+}
+
+void testRoundTrip(const std::string& texcook, const std::string& sourcePath) {
+  // Worked on as a copy, so the cooked file doesn't land next to the asset
+  std::string name = std::filesystem::path(sourcePath).filename().string();
+  std::string imagePath = "test_cooked_texture_" + name;
+  std::string cookedPath = cookedTexturePath(imagePath);
+  std::filesystem::copy_file(sourcePath, imagePath, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::remove(cookedPath);
+  std::string prefix = name + ": ";
+
+  TextureLoader loader;
+
+  // What the FreeImage path uploads, BGRA bits read back as RGBA
+  GLuint decodedId = loader.loadTexture(imagePath);
+  check(decodedId != (GLuint)-1, prefix + "the source decodes");
+  if (decodedId == (GLuint)-1) {
+    return;
+  }
+  std::vector<unsigned char> decoded = readLevel(decodedId, 0);
+  glDeleteTextures(1, &decodedId);
+
+  std::string command = "\"" + texcook + "\" --format rgba8 \"" + imagePath + "\"";
+  check(std::system(command.c_str()) == 0, prefix + "texcook succeeds");
+
+  // A second cook of the same image gives the same bytes
+  std::vector<unsigned char> firstCook = readFile(cookedPath);
+  check(std::system(command.c_str()) == 0 && readFile(cookedPath) == firstCook && !firstCook.empty(),
+	prefix + "cooking is deterministic");
+
+  CookedTexture cooked;
+  check(isCookedTextureCurrent(imagePath, cookedPath), prefix + "the cooked file is current");
+  bool opened = cooked.open(cookedPath);
+  check(opened, prefix + "the cooked file opens");
+  if (!opened) {
+    return;
+  }
+  check(cooked.level(0).size == decoded.size() &&
+	std::memcmp(cooked.levelData(0), decoded.data(), decoded.size()) == 0,
+	prefix + "cooked level 0 matches the FreeImage upload");
+
+  // The cooked path uploads every level exactly as the file has it
+  GLuint cookedId = loader.loadTexture(imagePath);
+  check(cookedId != (GLuint)-1, prefix + "the cooked file uploads");
+  if (cookedId == (GLuint)-1) {
+    return;
+  }
+  for (uint32_t i = 0; i < cooked.header().levelCount; i++) {
+    std::vector<unsigned char> level = readLevel(cookedId, i);
+    check(cooked.level(i).size == level.size() &&
+	  std::memcmp(cooked.levelData(i), level.data(), level.size()) == 0,
+	  prefix + "uploaded level " + std::to_string(i) + " matches the file");
+  }
+  glDeleteTextures(1, &cookedId);
+
+  std::filesystem::remove(imagePath);
+  std::filesystem::remove(cookedPath);
+}
+
+void testDamagedFiles(const std::string& path, TextureEncoding encoding, const char* name) {
+  // 37x20 so the chain has odd sizes and the blocks partial ones
+  const int width = 37, height = 20;
+  std::vector<unsigned char> pixels((size_t)width * height * 4);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = (unsigned char)(i * 7 + i / 13);
+  }
+  const std::vector<unsigned char> good = cookTexture(pixels.data(), width, height, encoding);
+  std::string prefix = std::string(name) + ": ";
+
+  check(opens(path, good), prefix + "a fresh cook opens");
+
+  std::vector<std::pair<std::string, std::function<void(std::vector<unsigned char>&)>>> damages = {
+    { "truncated by one byte", [](std::vector<unsigned char>& bytes) { bytes.pop_back(); } },
+    { "truncated into the index", [](std::vector<unsigned char>& bytes) {
+	bytes.resize(sizeof(CookedTextureHeader) + sizeof(CookedTextureLevel)); } },
+    { "level 0 size too small", [](std::vector<unsigned char>& bytes) { levelOf(bytes, 0).size -= 4; } },
+    { "level 1 size too large", [](std::vector<unsigned char>& bytes) { levelOf(bytes, 1).size += 16; } },
+    { "level 0 wider than its data", [](std::vector<unsigned char>& bytes) { levelOf(bytes, 0).width *= 2; } },
+    { "level 2 not half of level 1", [](std::vector<unsigned char>& bytes) { levelOf(bytes, 2).height += 1; } },
+    { "header larger than level 0", [](std::vector<unsigned char>& bytes) { headerOf(bytes).width += 4; } },
+    { "zero width", [](std::vector<unsigned char>& bytes) { headerOf(bytes).width = 0; } },
+    { "extra level past 1x1", [](std::vector<unsigned char>& bytes) { headerOf(bytes).levelCount += 1; } },
+    { "unknown internal format", [](std::vector<unsigned char>& bytes) { headerOf(bytes).internalFormat = GL_RGB16F; } },
+    { "pixel format on blocks or none on RGBA8", [](std::vector<unsigned char>& bytes) {
+	headerOf(bytes).format = headerOf(bytes).format == 0 ? GL_RGBA : 0; } },
+    { "level past the end of the file", [](std::vector<unsigned char>& bytes) {
+	levelOf(bytes, headerOf(bytes).levelCount - 1).offset = bytes.size(); } },
+  };
+
+  for (auto& damage : damages) {
+    std::vector<unsigned char> bytes = good;
+    damage.second(bytes);
+    check(!opens(path, bytes), prefix + damage.first + " is rejected");
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cout << "Usage: test_cooked_texture <texcook>" << std::endl;
+    return 1;
+  }
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  testRoundTrip(argv[1], GAME_SOURCE_DIR "/Assets/Models/Nanosuit/glass_dif.png");
+  testRoundTrip(argv[1], GAME_SOURCE_DIR "/Assets/Models/Nanosuit/helmet_diff.png");
+  testRoundTrip(argv[1], GAME_SOURCE_DIR "/Assets/container2.png");
+
+  std::string path = "test_cooked_texture.ctex";
+
+  testDamagedFiles(path, TextureEncoding::RGBA8, "RGBA8");
+  testDamagedFiles(path, TextureEncoding::BC1, "BC1");
+  testDamagedFiles(path, TextureEncoding::BC5, "BC5");
+
+  std::remove(path.c_str());
+  destroyHeadlessContext();
+
+  return checksResult();
+}
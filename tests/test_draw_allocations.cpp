@@ -0,0 +1,160 @@
+// test_draw_allocations - the Model draw paths make no heap allocations.
+//
+// Usage: test_draw_allocations
+//
+// Built with GAME_COUNT_ALLOCATIONS. Loads the Nanosuit once with its
+// textures bound through Material and once packed into texture arrays,
+// waits for the texture uploads, then draws each model once to warm up.
+// After that every draw (full detail, LOD with a frustum, instanced) has
+// to report 0 heap allocations in its DrawStats. The counter itself has
+// to see plain and over-aligned allocations.
+
+// STD
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <new>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Model.h"
+#include "FrameData.h"
+#include "InstanceBuffer.h"
+#include "AllocationCounter.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+#define SCREEN_SIZE 128
+
+const std::string MODEL_PATH = GAME_SOURCE_DIR "/Assets/Models/Nanosuit/nanosuit.obj";
+
+struct alignas(64) CacheLine {
+  unsigned char bytes[64];
+};
+
+// Decoding workers allocate too, and the counter sees every thread
+void waitForUploads(TextureLoader& loader) {
+  while (loader.pendingUploads() > 0) {
+    loader.processUploads(10.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Read back through a volatile, so the compiler can't drop the new and
+// delete pairs below as unused
+static void* volatile s_Allocation = nullptr;
+
+void checkCounter() {
+  // Counted before check() builds its message, which allocates too
+  size_t before = heapAllocationCount();
+  s_Allocation = ::operator new(16);
+  ::operator delete(s_Allocation);
+  size_t plain = heapAllocationCount() - before;
+  check(plain == 1, "operator new is counted");
+
+  before = heapAllocationCount();
+  s_Allocation = new CacheLine();
+  bool aligned = ((uintptr_t)s_Allocation & 63) == 0;
+  delete (CacheLine*)s_Allocation;
+  size_t overAligned = heapAllocationCount() - before;
+  check(aligned, "an over-aligned new is aligned");
+  check(overAligned == 1, "an over-aligned new is counted");
+}
+
+void checkDraws(const std::string& name, Model& model, Shader& shader, Shader& instancedShader,
+		Game::World& world, const FrameData& frame, const Frustum& frustum, const InstanceBuffer& instances) {
+  glm::mat4 transform = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+
+  // The first draw of each kind may still set things up
+  shader.use();
+  model.draw(&shader, transform);
+  model.draw(&shader, world, frame, transform, &frustum);
+  instancedShader.use();
+  model.drawInstanced(&instancedShader, instances);
+
+  shader.use();
+  model.draw(&shader, transform);
+  check(model.getDrawStats().drawCalls > 0, name + ": the full draw draws");
+  check(model.getDrawStats().heapAllocations == 0,
+	name + ": the full draw made " + std::to_string(model.getDrawStats().heapAllocations) + " allocations");
+
+  model.draw(&shader, world, frame, transform, &frustum);
+  check(model.getDrawStats().drawCalls > 0, name + ": the LOD draw draws");
+  check(model.getDrawStats().heapAllocations == 0,
+	name + ": the LOD draw made " + std::to_string(model.getDrawStats().heapAllocations) + " allocations");
+
+  instancedShader.use();
+  model.drawInstanced(&instancedShader, instances);
+  check(model.getDrawStats().heapAllocations == 0,
+	name + ": the instanced draw made " + std::to_string(model.getDrawStats().heapAllocations) + " allocations");
+  instancedShader.unuse();
+}
+
+int main() {
+  checkCounter();
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_SIZE, SCREEN_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  glViewport(0, 0, SCREEN_SIZE, SCREEN_SIZE);
+  glEnable(GL_DEPTH_TEST);
+
+  Game::World world;
+  world.screenWidth = SCREEN_SIZE;
+  world.screenHeight = SCREEN_SIZE;
+  world.camera = Camera(glm::vec3(0.0f, 1.5f, 6.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+  FrameUniforms frameUniforms;
+  frameUniforms.update(world, 0.0f);
+  const FrameData& frame = frameUniforms.data();
+  Frustum frustum(frame.viewProjection);
+
+  InstanceBuffer instances;
+  std::vector<InstanceData> instanceData;
+  for (int i = 0; i < 4; i++) {
+    instanceData.push_back({ glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(i - 1.5f, 0.0f, 0.0f)), glm::vec3(0.1f)),
+			     glm::vec4(1.0f) });
+  }
+  instances.update(instanceData);
+
+  TextureLoader loader;
+  {
+    Model model(MODEL_PATH, loader);
+    Shader shader(GAME_SOURCE_DIR "/Shaders/modelLoading.vert", GAME_SOURCE_DIR "/Shaders/modelLoading.frag");
+    Shader instancedShader(GAME_SOURCE_DIR "/shaders/modelArrayInstanced.vert",
+			   GAME_SOURCE_DIR "/shaders/modelArrayInstanced.frag");
+    waitForUploads(loader);
+    checkDraws("material textures", model, shader, instancedShader, world, frame, frustum, instances);
+  }
+  {
+    Model model(MODEL_PATH, loader, true);
+    Shader shader(GAME_SOURCE_DIR "/shaders/modelArray.vert", GAME_SOURCE_DIR "/shaders/modelArray.frag");
+    Shader instancedShader(GAME_SOURCE_DIR "/shaders/modelArrayInstanced.vert",
+			   GAME_SOURCE_DIR "/shaders/modelArrayInstanced.frag");
+    waitForUploads(loader);
+    checkDraws("texture arrays", model, shader, instancedShader, world, frame, frustum, instances);
+  }
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteFramebuffers(1, &framebuffer);
+  loader.releaseUploadRing();
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,81 @@
+// test_model_cache - model caches that ModelCache::open has to turn down.
+//
+// Usage: test_model_cache
+//
+// A small two mesh cache is written with writeModelCache and damaged one
+// field at a time. open has to accept the fresh file and reject every
+// damaged one, so no draw reads past its vertices.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdio>
+
+#include "ModelCache.h"
+#include "TestSupport.h"
+
+const uint64_t SOURCE_HASH = 0x1234;
+const uint32_t IMPORT_FLAGS = 7;
+
+bool opens(const std::string& path, const std::vector<unsigned char>& bytes) {
+  ModelCache cache;
+  return writeFile(path, bytes) && cache.open(path, SOURCE_HASH, IMPORT_FLAGS);
+}
+
+ModelCacheMesh& meshOf(std::vector<unsigned char>& bytes, uint32_t index) {
+  return ((ModelCacheMesh*)(bytes.data() + sizeof(ModelCacheHeader)))[index];
+}
+
+GLuint& indexOf(std::vector<unsigned char>& bytes, uint32_t mesh, uint32_t index) {
+  return ((GLuint*)(bytes.data() + meshOf(bytes, mesh).indexOffset))[index];
+}
+
+// A quad with a one triangle LOD after its two triangles
+ModelMeshData quad() {
+  ModelMeshData mesh;
+  for (int i = 0; i < 4; i++) {
+    Vertex vertex = {};
+    vertex.position = glm::vec3((float)(i & 1), (float)(i >> 1), 0.0f);
+    mesh.vertices.push_back(vertex);
+  }
+  mesh.indices = { 0, 1, 2, 2, 1, 3, 0, 1, 3 };
+  mesh.lods = { { 0, 6, 0.0f }, { 6, 3, 0.5f } };
+  mesh.importedVertexCount = 6;
+  mesh.boundsMin = glm::vec3(0.0f);
+  mesh.boundsMax = glm::vec3(1.0f, 1.0f, 0.0f);
+  return mesh;
+}
+
+int main() {
+  std::string path = "test_model_cache.mcache";
+
+  ModelNodeData root = { SCENE_NO_PARENT, "root", { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) }, { 0, 1 } };
+  bool written = writeModelCache(path, { quad(), quad() }, { root }, SOURCE_HASH, IMPORT_FLAGS);
+  check(written, "the cache is written");
+  const std::vector<unsigned char> good = readFile(path);
+
+  check(opens(path, good), "a fresh cache opens");
+
+  std::vector<std::pair<std::string, std::function<void(std::vector<unsigned char>&)>>> damages = {
+    { "index one past the vertices", [](std::vector<unsigned char>& bytes) { indexOf(bytes, 0, 4) = 4; } },
+    { "index far past the vertices", [](std::vector<unsigned char>& bytes) { indexOf(bytes, 1, 0) = 0xffffffff; } },
+    { "bad index only in the last LOD", [](std::vector<unsigned char>& bytes) { indexOf(bytes, 1, 8) = 5; } },
+    { "vertex count below the indices", [](std::vector<unsigned char>& bytes) { meshOf(bytes, 0).vertexCount = 3; } },
+    { "LOD past the indices", [](std::vector<unsigned char>& bytes) { meshOf(bytes, 1).lods[1].indexCount = 4; } },
+    { "indices past the end of the file", [](std::vector<unsigned char>& bytes) {
+	meshOf(bytes, 1).indexOffset = bytes.size() - 8; } },
+  };
+
+  for (auto& damage : damages) {
+    std::vector<unsigned char> bytes = good;
+    damage.second(bytes);
+    check(!opens(path, bytes), damage.first + " is rejected");
+  }
+
+  std::remove(path.c_str());
+
+  return checksResult();
+}
@@ -0,0 +1,229 @@
+// test_model_lod - LOD selection of 1,000 model instances against the
+// projection the frame draws with.
+//
+// Usage: test_model_lod [instances] [grid]
+//
+// Writes a wavy grid x grid quad patch (64 by default) as an OBJ, loads it
+// with Model and draws instances of it (1,000 by default) from 1 to 95
+// units in front of the camera with the LOD draw. Each instance has to
+// draw at the coarsest LOD whose error, projected with the FrameUniforms
+// projection, stays within LOD_PIXEL_ERROR. The triangles per LOD and the
+// frame time are printed next to drawing every instance at full detail.
+// A frustum has to drop the patch once it is behind the camera.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// GLM
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Model.h"
+#include "FrameData.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 360
+
+bool writePatchObj(const std::string& path, int grid) {
+  std::ofstream file(path, std::ios::trunc);
+  int side = grid + 1;
+  for (int z = 0; z < side; z++) {
+    for (int x = 0; x < side; x++) {
+      float height = 0.3f * std::sin(x * 0.4f) * std::cos(z * 0.3f);
+      file << "v " << (float)x / grid - 0.5f << " " << height / grid * 8.0f << " " << (float)z / grid - 0.5f << "\n"
+	   << "vt " << (float)x / grid << " " << (float)z / grid << "\n"
+	   << "vn 0 1 0\n";
+    }
+  }
+  for (int z = 0; z < grid; z++) {
+    for (int x = 0; x < grid; x++) {
+      int a = 1 + z * side + x;
+      int b = a + 1;
+      int c = a + side;
+      int d = c + 1;
+      file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " "
+	   << d << "/" << d << "/" << d << " " << b << "/" << b << "/" << b << "\n";
+    }
+  }
+  return (bool)file;
+}
+
+// The LOD Model::draw has to pick for a sphere at distance, in the same order
+GLuint expectedLod(const std::vector<MeshLod>& lods, float distance, float pixelsPerUnit) {
+  GLuint lod = 0;
+  while (distance > 0.0f && lod + 1 < lods.size() && lods[lod + 1].error / distance * pixelsPerUnit <= LOD_PIXEL_ERROR) {
+    lod++;
+  }
+  return lod;
+}
+
+int main(int argc, char** argv) {
+  int instances = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int grid = argc > 2 ? std::atoi(argv[2]) : 64;
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glEnable(GL_DEPTH_TEST);
+
+  std::string path = "test_model_lod.obj";
+  std::string cachePath = modelCachePath(path);
+  std::remove(cachePath.c_str());
+  check(writePatchObj(path, grid), "the patch is written");
+
+  TextureLoader loader;
+  Model model(path, loader);
+  Shader shader(GAME_SOURCE_DIR "/Shaders/modelLoading.vert", GAME_SOURCE_DIR "/Shaders/modelLoading.frag");
+
+  // The levels and bounds the model drew with, from the cache it wrote
+  uint64_t sourceHash = 0;
+  ModelCache cache;
+  bool cached = hashModelSource(path, sourceHash) && cache.open(cachePath, sourceHash, MODEL_IMPORT_FLAGS);
+  check(cached && cache.meshCount() == 1, "the model cache holds the patch");
+  if (!cached || cache.meshCount() != 1) {
+    return checksResult();
+  }
+  ModelMeshData mesh = cache.meshData(0);
+  BoundingBox box;
+  BoundingSphere sphere;
+  computeBounds(&mesh.vertices[0].position, mesh.vertices.size(), sizeof(Vertex), box, sphere);
+  check(mesh.lods.size() > 2, "the patch has LODs to pick from");
+
+  Game::World world;
+  world.screenWidth = SCREEN_WIDTH;
+  world.screenHeight = SCREEN_HEIGHT;
+  world.camera = Camera(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+  FrameUniforms frameUniforms;
+  frameUniforms.update(world, 0.0f);
+  const FrameData& frame = frameUniforms.data();
+
+  // What the projection really gives, and what treating zoom as degrees gave
+  float pixelsPerUnit = world.screenHeight * 0.5f * frame.projection[1][1];
+  float degreesPixelsPerUnit = world.screenHeight / (2.0f * std::tan(glm::radians(world.camera.zoom) * 0.5f));
+
+  // Facing the camera, spread from near to far along its view
+  std::vector<glm::mat4> transforms;
+  std::vector<float> distances;
+  for (int i = 0; i < instances; i++) {
+    float distance = 1.0f + 94.0f * i / std::max(1, instances - 1);
+    float side = ((i % 9) - 4) * 0.05f * distance;
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(side, 0.0f, -distance));
+    transform = glm::rotate(transform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    transforms.push_back(glm::translate(transform, -sphere.center));
+    distances.push_back(std::max(std::sqrt(distance * distance + side * side) - sphere.radius, 0.0f));
+  }
+
+  shader.use();
+  shader.setMat4(UNIFORM("view"), frame.view);
+  shader.setMat4(UNIFORM("projection"), frame.projection);
+
+  size_t lodTriangles[MESH_MAX_LODS] = {};
+  size_t lodInstances[MESH_MAX_LODS] = {};
+  size_t lodTotal = 0, fullTotal = 0;
+  int mismatches = 0, degreesDisagree = 0;
+
+  double lodMilliseconds = 1e9, fullMilliseconds = 1e9;
+  for (int run = 0; run < 3; run++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < instances; i++) {
+      model.draw(&shader, world, frame, transforms[i]);
+      if (run > 0) {
+	continue;
+      }
+
+      DrawStats stats = model.getDrawStats();
+      GLuint lod = 0;
+      for (GLuint level = 0; level < MESH_MAX_LODS; level++) {
+	lodTriangles[level] += stats.lodTriangles[level];
+	if (stats.lodTriangles[level] > 0) {
+	  lod = level;
+	}
+      }
+      lodInstances[lod]++;
+      lodTotal += stats.triangles;
+
+      if (lod != expectedLod(mesh.lods, distances[i], pixelsPerUnit)) {
+	mismatches++;
+      }
+      if (lod != expectedLod(mesh.lods, distances[i], degreesPixelsPerUnit)) {
+	degreesDisagree++;
+      }
+    }
+    glFinish();
+    lodMilliseconds = std::min(lodMilliseconds,
+			       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < instances; i++) {
+      model.draw(&shader, transforms[i]);
+      if (run == 0) {
+	fullTotal += model.getDrawStats().triangles;
+      }
+    }
+    glFinish();
+    fullMilliseconds = std::min(fullMilliseconds,
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  shader.unuse();
+
+  std::printf("%d instances of %zu triangles, %dx%d, %.1f pixels per unit\n", instances,
+	      (size_t)mesh.lods[0].indexCount / 3, SCREEN_WIDTH, SCREEN_HEIGHT, pixelsPerUnit);
+  std::printf("LOD  error      instances  triangles\n");
+  for (size_t level = 0; level < mesh.lods.size(); level++) {
+    std::printf("%3zu  %-9.5f  %9zu  %9zu\n", level, mesh.lods[level].error, lodInstances[level], lodTriangles[level]);
+  }
+  std::printf("LOD draw:  %9zu triangles  %8.2f ms\n", lodTotal, lodMilliseconds);
+  std::printf("full draw: %9zu triangles  %8.2f ms\n", fullTotal, fullMilliseconds);
+  std::printf("%d instances would have drawn at another LOD with zoom taken as degrees\n", degreesDisagree);
+
+  check(mismatches == 0, std::to_string(mismatches) + " instances drew at another LOD than the projection asks for");
+  check(lodInstances[0] > 0 && lodInstances[mesh.lods.size() - 1] > 0, "the near instances draw at full detail, the far ones at the coarsest LOD");
+  check(lodTotal < fullTotal, "the LOD draw issues fewer triangles");
+  check(degreesDisagree > 0, "the frame's projection changes the picks");
+
+  // Behind the camera the patch is culled, in front of it it draws
+  Frustum frustum(frame.viewProjection);
+  shader.use();
+  model.draw(&shader, world, frame, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 10.0f)) * transforms[0], &frustum);
+  check(model.getDrawStats().culledMeshes == 1 && model.getDrawStats().drawCalls == 0, "a patch behind the camera is culled");
+  model.draw(&shader, world, frame, transforms[0], &frustum);
+  check(model.getDrawStats().culledMeshes == 0 && model.getDrawStats().drawCalls == 1, "a patch in view draws");
+  shader.unuse();
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteFramebuffers(1, &framebuffer);
+  std::remove(cachePath.c_str());
+  std::remove(path.c_str());
+  loader.releaseUploadRing();
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,145 @@
+// test_shader_cache - the program binary cache across runs: a hit, a
+// binary the driver rejects, and the rewrite after it.
+//
+// Usage: test_shader_cache
+//
+// Writes a small shader pair to a directory of its own and builds it with
+// Shader several times, the way later runs of the game would:
+//   first build        compiles and writes the cache
+//   second build       loads the binary, no compile
+//   damaged binary     the driver refuses it, the program compiles from
+//                      source and the cache is written again
+//   edited source      the key no longer matches, compiles and rewrites
+// Every build has to draw the colour it is given, and the cache
+// statistics have to count each case.
+
+// STD
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdio>
+
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+const std::string DIRECTORY = "test_shader_cache.tmp";
+const std::string VERTEX_PATH = DIRECTORY + "/tint.vert";
+const std::string FRAGMENT_PATH = DIRECTORY + "/tint.frag";
+
+// A triangle over the whole target, no vertex buffer needed
+const char* VERTEX_SHADER =
+  "#version 330 core\n"
+  "void main() {\n"
+  "  vec2 position = vec2((gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID >> 1) * 4.0 - 1.0);\n"
+  "  gl_Position = vec4(position, 0.0, 1.0);\n"
+  "}\n";
+
+std::string fragmentShader(const std::string& scale) {
+  return "#version 330 core\n"
+    "out vec4 color;\n"
+    "uniform vec4 tint;\n"
+    "void main() {\n"
+    "  color = tint * " + scale + ";\n"
+    "}\n";
+}
+
+// Draws with the shader and reads the one pixel back
+glm::vec4 drawnColor(Shader& shader, const glm::vec4& tint) {
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  shader.use();
+  shader.setVec4(UNIFORM("tint"), tint);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  shader.unuse();
+
+  unsigned char pixel[4];
+  glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  return glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) / 255.0f;
+}
+
+bool closeTo(const glm::vec4& a, const glm::vec4& b) {
+  return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec4(1.5f / 255.0f)));
+}
+
+// Builds the program like a fresh run and checks what the cache did
+void build(const std::string& name, const glm::vec4& expected, size_t hits, size_t misses, size_t rejected) {
+  ShaderCacheStats before = Shader::getCacheStats();
+  Shader shader(VERTEX_PATH.c_str(), FRAGMENT_PATH.c_str());
+  ShaderCacheStats after = Shader::getCacheStats();
+
+  std::printf("%-16s %zu hit, %zu miss, %zu rejected, compile %.2f ms\n", name.c_str(), after.hits - before.hits,
+	      after.misses - before.misses, after.rejected - before.rejected, shader.getCompileMilliseconds());
+  check(shader.isReady(), name + ": the program is ready");
+  check(after.hits - before.hits == hits && after.misses - before.misses == misses &&
+	after.rejected - before.rejected == rejected, name + ": the cache counted the build right");
+  check(closeTo(drawnColor(shader, glm::vec4(0.8f, 0.4f, 0.2f, 1.0f)), expected), name + ": the program draws right");
+}
+
+int main() {
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  if (!shaderCacheSupported()) {
+    std::cout << "The context has no program binary formats, nothing to cache" << std::endl;
+    destroyHeadlessContext();
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  GLuint framebuffer, color, vertexArray;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &color);
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 4, 4);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glViewport(0, 0, 4, 4);
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+
+  std::filesystem::remove_all(DIRECTORY);
+  std::filesystem::create_directory(DIRECTORY);
+  writeFile(VERTEX_PATH, VERTEX_SHADER);
+  writeFile(FRAGMENT_PATH, fragmentShader("1.0"));
+  std::string cachePath = shaderCachePath(VERTEX_PATH, FRAGMENT_PATH, "");
+
+  build("first build", glm::vec4(0.8f, 0.4f, 0.2f, 1.0f), 0, 1, 0);
+  std::vector<unsigned char> written = readFile(cachePath);
+  check(written.size() > sizeof(ShaderCacheHeader), "the first build writes the cache");
+
+  build("second build", glm::vec4(0.8f, 0.4f, 0.2f, 1.0f), 1, 0, 0);
+  check(readFile(cachePath) == written, "a hit leaves the cache as it is");
+
+  // The key still matches, only the driver can tell
+  std::vector<unsigned char> damaged = written;
+  const ShaderCacheHeader* header = (const ShaderCacheHeader*)damaged.data();
+  for (size_t i = header->binaryOffset; i < damaged.size(); i += 7) {
+    damaged[i] ^= 0x5a;
+  }
+  writeFile(cachePath, damaged);
+  build("damaged binary", glm::vec4(0.8f, 0.4f, 0.2f, 1.0f), 0, 1, 1);
+  std::vector<unsigned char> rewritten = readFile(cachePath);
+  check(rewritten.size() > sizeof(ShaderCacheHeader) && rewritten != damaged, "the rejected cache is rewritten");
+  build("after rewrite", glm::vec4(0.8f, 0.4f, 0.2f, 1.0f), 1, 0, 0);
+
+  writeFile(FRAGMENT_PATH, fragmentShader("0.5"));
+  build("edited source", glm::vec4(0.4f, 0.2f, 0.1f, 0.5f), 0, 1, 0);
+  build("edited, again", glm::vec4(0.4f, 0.2f, 0.1f, 0.5f), 1, 0, 0);
+
+  Shader::logCacheStats();
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  glBindVertexArray(0);
+  glDeleteVertexArrays(1, &vertexArray);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &color);
+  glDeleteFramebuffers(1, &framebuffer);
+  std::filesystem::remove_all(DIRECTORY);
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,199 @@
+// test_shader_permutations - #include expansion and the lighting shader
+// variants.
+//
+// Usage: test_shader_permutations
+//
+// loadShaderSource() on files written for the test:
+//   included twice      pasted in once
+//   relative paths      resolved against the including file
+//   cycles              end on their own
+//   in comments         #include lines in // and /* */ comments are left
+//   missing file        fails the load
+// ShaderPermutations over a copy of Shaders/lightShader, so the binary
+// cache can't hide a failed compile: features with the same key share a
+// variant, point lights above SHADER_MAX_POINT_LIGHTS included, and every
+// combination of features links.
+// Shader::compileAsync on a fresh pair: use() binds the fallback while the
+// compile is pending and the program once processCompiles() finished it,
+// a program that fails to link stays on the fallback, and only the
+// driver's time counts as compile time.
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+
+#include "ShaderSource.h"
+#include "ShaderPermutations.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+const std::string DIRECTORY = "test_shader_permutations.tmp";
+
+// Times the text is in the code
+size_t occurrences(const std::string& code, const std::string& text) {
+  size_t count = 0;
+  for (size_t position = code.find(text); position != std::string::npos; position = code.find(text, position + 1)) {
+    count++;
+  }
+  return count;
+}
+
+void checkIncludes() {
+  std::filesystem::create_directories(DIRECTORY + "/include/nested");
+  writeFile(DIRECTORY + "/include/main.glsl",
+	    "#version 330 core\n"
+	    "#include \"common.glsl\"\n"
+	    "  #include \"nested/a.glsl\"\n"
+	    "#include \"common.glsl\"\n"
+	    "// #include \"missing.glsl\"\n"
+	    "/* A block comment\n"
+	    "#include \"missing.glsl\"\n"
+	    "*/\n"
+	    "void main() {}\n");
+  writeFile(DIRECTORY + "/include/common.glsl", "float common_marker;\n");
+  writeFile(DIRECTORY + "/include/nested/a.glsl", "#include \"b.glsl\"\nfloat a_marker;\n");
+  writeFile(DIRECTORY + "/include/nested/b.glsl", "#include \"a.glsl\"\n#include \"../common.glsl\"\nfloat b_marker;");
+  writeFile(DIRECTORY + "/include/broken.glsl", "#version 330 core\n#include \"missing.glsl\"\n");
+
+  std::string code;
+  check(loadShaderSource(DIRECTORY + "/include/main.glsl", code), "the includes load");
+  check(occurrences(code, "common_marker") == 1, "a file included twice is pasted in once");
+  check(occurrences(code, "a_marker") == 1 && occurrences(code, "b_marker") == 1, "a cycle of includes ends");
+  check(code.find("b_marker") < code.find("a_marker"), "an include is pasted where its line was");
+  check(occurrences(code, "#include") == 2, "includes in comments are left as they are");
+  check(code.find("b_marker;\nfloat a_marker") != std::string::npos, "a file without a last newline gets one");
+  check(code.compare(0, 18, "#version 330 core\n") == 0, "the #version line stays first");
+
+  check(!loadShaderSource(DIRECTORY + "/include/broken.glsl", code), "a missing include fails the load");
+  check(!loadShaderSource(DIRECTORY + "/include/none.glsl", code), "a missing file fails the load");
+}
+
+// The light shader and what it includes, without the program binaries
+// cached next to them
+void copyLightShader() {
+  for (const char* directory : { "Shaders", "shaders" }) {
+    std::filesystem::create_directories(DIRECTORY + "/" + directory);
+    for (const auto& entry : std::filesystem::directory_iterator(std::string(GAME_SOURCE_DIR "/") + directory)) {
+      if (entry.is_regular_file() && entry.path().extension() != ".pcache") {
+	std::filesystem::copy_file(entry.path(), DIRECTORY + "/" + directory + "/" + entry.path().filename().string());
+      }
+    }
+  }
+}
+
+void checkPermutations() {
+  ShaderFeatures none = { false, 0, false, false, false, false };
+  ShaderFeatures all = { true, SHADER_MAX_POINT_LIGHTS, true, true, true, true };
+  check(none.key() == 0, "no features is key 0");
+  check(all.key() == 0x1ff, "every feature sets its own bit");
+  ShaderFeatures many = none;
+  many.pointLights = 16;
+  ShaderFeatures more = none;
+  more.pointLights = 20;
+  ShaderFeatures most = none;
+  most.pointLights = SHADER_MAX_POINT_LIGHTS;
+  check(many.key() == most.key() && more.key() == most.key(), "point lights above the most share its key");
+  check(more.defines() == most.defines(), "point lights above the most build the most");
+
+  copyLightShader();
+  ShaderPermutations permutations(DIRECTORY + "/Shaders/lightShader.vert", DIRECTORY + "/Shaders/lightShader.frag");
+  Shader* first = &permutations.get(most);
+  check(&permutations.get(many) == first && &permutations.get(more) == first, "the same key gets the same variant");
+  check(&permutations.get(none) != first, "another key gets another variant");
+  ShaderPermutationStats stats = permutations.getStats();
+  check(stats.variants == 2 && stats.requests == 4, "4 requests build 2 variants");
+
+  // Every combination of the switches, with point light counts at the edges
+  std::vector<Shader*> variants;
+  for (uint32_t switches = 0; switches < 32; switches++) {
+    for (uint32_t pointLights : { 0u, 1u, 4u, (uint32_t)SHADER_MAX_POINT_LIGHTS }) {
+      ShaderFeatures features = { (switches & 1) != 0, pointLights, (switches & 2) != 0,
+				  (switches & 4) != 0, (switches & 8) != 0, (switches & 16) != 0 };
+      variants.push_back(&permutations.get(features));
+    }
+  }
+  for (int wait = 0; wait < 1000 && Shader::pendingCompiles() > 0; wait++) {
+    Shader::processCompiles();
+  }
+  check(Shader::pendingCompiles() == 0, "the variants finish compiling");
+
+  size_t linked = 0;
+  for (Shader* variant : variants) {
+    linked += variant->isReady() ? 1 : 0;
+  }
+  check(linked == variants.size(), std::to_string(variants.size() - linked) + " variants failed to link");
+  stats = permutations.getStats();
+  check(stats.variants == 128 && stats.pending == 0, "128 variants, none pending");
+}
+
+GLuint currentProgram() {
+  GLint program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+  return (GLuint)program;
+}
+
+void checkAsync() {
+  std::filesystem::create_directories(DIRECTORY + "/async");
+  writeFile(DIRECTORY + "/async/flat.vert",
+	    "#version 330 core\n"
+	    "layout (location = 0) in vec3 position;\n"
+	    "void main() { gl_Position = vec4(position, 1.0); }\n");
+  writeFile(DIRECTORY + "/async/flat.frag",
+	    "#version 330 core\n"
+	    "out vec4 color;\n"
+	    "void main() { color = vec4(1.0); }\n");
+  writeFile(DIRECTORY + "/async/broken.frag",
+	    "#version 330 core\n"
+	    "out vec4 color;\n"
+	    "void main() { color = undeclared; }\n");
+
+  Shader shader = Shader::compileAsync((DIRECTORY + "/async/flat.vert").c_str(), (DIRECTORY + "/async/flat.frag").c_str());
+  Shader broken = Shader::compileAsync((DIRECTORY + "/async/flat.vert").c_str(), (DIRECTORY + "/async/broken.frag").c_str());
+  Shader copy = shader;
+  check(!shader.isReady() && Shader::pendingCompiles() == 2, "the compiles are queued");
+  GLuint fallback = shader.getProgram();
+  check(fallback != 0 && broken.getProgram() == fallback, "pending shaders share the fallback");
+  shader.use();
+  check(currentProgram() == fallback, "use() binds the fallback while pending");
+
+  // Frames far longer than the compile, which must not count
+  double waited = 0.0;
+  for (int wait = 0; wait < 100 && Shader::pendingCompiles() > 0; wait++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    waited += 100.0;
+    Shader::processCompiles();
+  }
+  check(Shader::pendingCompiles() == 0, "the compiles finish");
+
+  check(shader.isReady() && copy.isReady(), "the program is ready, copies too");
+  check(shader.getProgram() != fallback && copy.getProgram() == shader.getProgram(), "the program replaces the fallback");
+  shader.use();
+  check(currentProgram() == shader.getProgram(), "use() binds the program once ready");
+  check(shader.getCompileMilliseconds() < waited, "the frames waited are not compile time");
+
+  check(!broken.isReady(), "a failed link is not ready");
+  broken.use();
+  check(currentProgram() == fallback, "a failed link stays on the fallback");
+  broken.unuse();
+}
+
+int main() {
+  std::filesystem::remove_all(DIRECTORY);
+  checkIncludes();
+
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+  checkPermutations();
+  checkAsync();
+  check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+  std::filesystem::remove_all(DIRECTORY);
+  destroyHeadlessContext();
+
+  return checksResult();
+}
@@ -0,0 +1,142 @@
+// test_shader_uniforms - Shader's uniform table and its redundant upload
+// filter.
+//
+// Usage: test_shader_uniforms
+//
+// Builds a small program and sets its uniforms through the typed setters:
+//   same value twice    the second set is skipped, the program keeps it
+//   changed value       issued, and glGetUniform reads the new value back
+//   arrays              found by their name without [0]
+//   wrong size          issued, GL rejects it and keeps the old value,
+//                       which the table keeps too
+//   copies              a copy of the Shader shares the last values
+//   unknown names       ignored, nothing issued
+// Every case has to show in getUniformStats().
+
+// STD
+#include <iostream>
+#include <string>
+#include <functional>
+#include <filesystem>
+
+#include "Shader.h"
+#include "HeadlessContext.h"
+#include "TestSupport.h"
+
+const std::string DIRECTORY = "test_shader_uniforms.tmp";
+const std::string VERTEX_PATH = DIRECTORY + "/uniforms.vert";
+const std::string FRAGMENT_PATH = DIRECTORY + "/uniforms.frag";
+
+const char* VERTEX_SHADER =
+  "#version 330 core\n"
+  "layout (location = 0) in vec3 position;\n"
+  "uniform mat4 model;\n"
+  "uniform vec3 offsets[4];\n"
+  "void main() {\n"
+  "  gl_Position = model * vec4(position + offsets[gl_VertexID & 3], 1.0);\n"
+  "}\n";
+
+const char* FRAGMENT_SHADER =
+  "#version 330 core\n"
+  "out vec4 color;\n"
+  "uniform float scale;\n"
+  "uniform int mode;\n"
+  "void main() {\n"
+  "  color = vec4(scale, float(mode), 0.0, 1.0);\n"
+  "}\n";
+
+// Sets through the shader and returns the stats it added
+UniformStats statsOf(const std::function<void()>& set) {
+  Shader::resetUniformStats();
+  set();
+  return Shader::getUniformStats();
+}
+
+float readFloat(GLuint program, const char* name) {
+  GLfloat value[4] = { 0.0f };
+  glGetUniformfv(program, glGetUniformLocation(program, name), value);
+  return value[0];
+}
+
+int main() {
+  if (!createHeadlessContext()) {
+    return HEADLESS_CONTEXT_SKIP;
+  }
+
+  std::filesystem::remove_all(DIRECTORY);
+  std::filesystem::create_directory(DIRECTORY);
+  writeFile(VERTEX_PATH, VERTEX_SHADER);
+  writeFile(FRAGMENT_PATH, FRAGMENT_SHADER);
+
+  Shader shader(VERTEX_PATH.c_str(), FRAGMENT_PATH.c_str());
+  check(shader.isReady(), "the program links");
+  GLuint program = shader.getProgram();
+  shader.use();
+
+  // Same value twice
+  UniformStats stats = statsOf([&]() {
+      shader.setFloat(UNIFORM("scale"), 0.25f);
+      shader.setFloat(UNIFORM("scale"), 0.25f);
+    });
+  check(stats.issued == 1 && stats.skipped == 1, "setting the same value twice issues it once");
+  check(readFloat(program, "scale") == 0.25f, "the program has the value");
+
+  // Changed value
+  stats = statsOf([&]() { shader.setFloat(UNIFORM("scale"), 0.75f); });
+  check(stats.issued == 1 && stats.skipped == 0, "a changed value is issued");
+  check(readFloat(program, "scale") == 0.75f, "the changed value reads back");
+
+  glm::mat4 model(1.0f);
+  model[3] = glm::vec4(1.0f, 2.0f, 3.0f, 1.0f);
+  stats = statsOf([&]() {
+      shader.setMat4(UNIFORM("model"), model);
+      shader.setMat4(UNIFORM("model"), model);
+      model[3].x = 4.0f;
+      shader.setMat4(UNIFORM("model"), model);
+    });
+  check(stats.issued == 2 && stats.skipped == 1, "matrices are compared whole");
+  GLfloat modelValue[16];
+  glGetUniformfv(program, glGetUniformLocation(program, "model"), modelValue);
+  check(modelValue[12] == 4.0f && modelValue[13] == 2.0f, "the changed matrix reads back");
+
+  // Arrays go by their name without [0], and set their first element
+  check(shader.getUniformLocation(UNIFORM("offsets")) != -1, "an array is found without [0]");
+  check(shader.getUniformLocation(UNIFORM("offsets[0]")) == -1, "an array is not found with [0]");
+  stats = statsOf([&]() {
+      shader.setVec3(UNIFORM("offsets"), glm::vec3(0.5f, 0.0f, 0.0f));
+      shader.setVec3(UNIFORM("offsets"), glm::vec3(0.5f, 0.0f, 0.0f));
+    });
+  check(stats.issued == 1 && stats.skipped == 1, "an array's first element is filtered like a value");
+  check(readFloat(program, "offsets[0]") == 0.5f, "the array's first element reads back");
+
+  // A value of the wrong size: GL refuses it and the old value stays
+  stats = statsOf([&]() { shader.setVec2(UNIFORM("scale"), glm::vec2(3.0f)); });
+  GLenum error = glGetError();
+  check(stats.issued == 1, "a value of the wrong size is still issued");
+  check(error == GL_INVALID_OPERATION, "GL rejects the wrong size");
+  check(readFloat(program, "scale") == 0.75f, "the program keeps the old value");
+  stats = statsOf([&]() { shader.setFloat(UNIFORM("scale"), 0.75f); });
+  check(stats.skipped == 1, "the table keeps the old value too");
+
+  // Copies share the last values
+  Shader copy = shader;
+  stats = statsOf([&]() {
+      copy.setFloat(UNIFORM("scale"), 0.75f);
+      copy.setInt(UNIFORM("mode"), 2);
+      shader.setInt(UNIFORM("mode"), 2);
+    });
+  check(stats.issued == 1 && stats.skipped == 2, "copies of a Shader share the last values");
+
+  // Uniforms the program doesn't have
+  stats = statsOf([&]() { shader.setFloat(UNIFORM("missing"), 1.0f); });
+  check(stats.issued == 0 && stats.skipped == 0, "an unknown uniform is ignored");
+  check(shader.getUniformLocation(UNIFORM("missing")) == -1, "an unknown uniform has no location");
+
+  shader.unuse();
+  check(glGetError() == GL_NO_ERROR, "no other GL errors");
+
+  std::filesystem::remove_all(DIRECTORY);
+  destroyHeadlessContext();
+
+  return checksResult();
+}
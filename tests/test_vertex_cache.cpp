@@ -0,0 +1,125 @@
+// test_vertex_cache - ACMR and ATVR of synthetic dense meshes before and
+// after the index passes Model::processMesh runs.
+//
+// Usage: test_vertex_cache
+//
+// Each mesh goes through optimizeVertexCache, optimizeOverdraw and
+// optimizeVertexFetch like an imported one. The passes may only reorder,
+// so the triangles have to stay the same, and the cache has to do better
+// than in the input order. The numbers are printed per mesh.
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstdio>
+
+#include "MeshOptimizer.h"
+#include "TestSupport.h"
+
+struct TestMesh {
+  std::string name;
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+};
+
+// Rows of quads, in row order like most exporters write them
+TestMesh grid(int size) {
+  TestMesh mesh = { "grid " + std::to_string(size) + "x" + std::to_string(size), {}, {} };
+  for (int y = 0; y <= size; y++) {
+    for (int x = 0; x <= size; x++) {
+      Vertex vertex = {};
+      vertex.position = glm::vec3((float)x, 0.0f, (float)y);
+      vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+      vertex.texCoords = glm::vec2((float)x / size, (float)y / size);
+      mesh.vertices.push_back(vertex);
+    }
+  }
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      GLuint a = y * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+      mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+    }
+  }
+  return mesh;
+}
+
+// A UV sphere whose triangles come in random order, the worst case
+TestMesh shuffledSphere(int rings, int segments) {
+  TestMesh mesh = { "shuffled sphere", {}, {} };
+  for (int ring = 0; ring <= rings; ring++) {
+    float theta = (float)ring / rings * 3.14159265f;
+    for (int segment = 0; segment <= segments; segment++) {
+      float phi = (float)segment / segments * 6.2831853f;
+      Vertex vertex = {};
+      vertex.position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+      vertex.normal = vertex.position;
+      vertex.texCoords = glm::vec2((float)segment / segments, (float)ring / rings);
+      mesh.vertices.push_back(vertex);
+    }
+  }
+
+  std::vector<std::array<GLuint, 3>> triangles;
+  for (int ring = 0; ring < rings; ring++) {
+    for (int segment = 0; segment < segments; segment++) {
+      GLuint a = ring * (segments + 1) + segment, b = a + 1, c = a + segments + 1, d = c + 1;
+      triangles.push_back({ a, b, c });
+      triangles.push_back({ b, d, c });
+    }
+  }
+  std::mt19937 random(7);
+  std::shuffle(triangles.begin(), triangles.end(), random);
+  for (auto& triangle : triangles) {
+    mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+  }
+  return mesh;
+}
+
+// The triangles as sorted position triples, independent of the order of
+// the triangles, of their corners and of the vertices
+std::vector<std::array<float, 9>> triangleSet(const TestMesh& mesh) {
+  std::vector<std::array<float, 9>> triangles;
+  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+    std::array<std::array<float, 3>, 3> corners;
+    for (int corner = 0; corner < 3; corner++) {
+      const glm::vec3& position = mesh.vertices[mesh.indices[i + corner]].position;
+      corners[corner] = { position.x, position.y, position.z };
+    }
+    std::sort(corners.begin(), corners.end());
+    triangles.push_back({ corners[0][0], corners[0][1], corners[0][2],
+			  corners[1][0], corners[1][1], corners[1][2],
+			  corners[2][0], corners[2][1], corners[2][2] });
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+void testMesh(TestMesh mesh, float maxAcmr) {
+  std::vector<std::array<float, 9>> before = triangleSet(mesh);
+  VertexCacheStats imported = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+  optimizeVertexCache(mesh.indices, mesh.vertices.size());
+  optimizeOverdraw(mesh.indices, mesh.vertices);
+  optimizeVertexFetch(mesh.vertices, mesh.indices);
+  VertexCacheStats optimized = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+  std::printf("%-16s %7zu triangles  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n", mesh.name.c_str(),
+	      mesh.indices.size() / 3, imported.acmr, optimized.acmr, imported.atvr, optimized.atvr);
+
+  check(triangleSet(mesh) == before, mesh.name + ": the passes keep the triangles");
+  check(optimized.acmr < imported.acmr && optimized.atvr < imported.atvr, mesh.name + ": the cache does better");
+  check(optimized.acmr <= maxAcmr, mesh.name + ": ACMR " + std::to_string(optimized.acmr) +
+	" above " + std::to_string(maxAcmr));
+}
+
+int main() {
+  testMesh(grid(64), 0.75f);
+  testMesh(grid(512), 0.75f);
+  testMesh(shuffledSphere(128, 256), 0.75f);
+
+  return checksResult();
+}
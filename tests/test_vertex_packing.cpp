@@ -0,0 +1,133 @@
+// test_vertex_packing - PACKED16 vertices against the float reference.
+//
+// Usage: test_vertex_packing
+//
+// Random vertices in random boxes, plus the normals octahedral encoding
+// finds hardest (axes, the fold diagonals, the -z pole), are packed with
+// packVertex and unpacked with unpackVertex, which does the vertex
+// shader's maths. Each attribute has to stay within its quantization
+// bound:
+//   position   half a unorm16 step of the box size, plus float rounding
+//   normal     NORMAL_MAX_DEGREES
+//   texCoords  half a half float step, i.e. 2^-11 relative
+
+// STD
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "VertexLayout.h"
+#include "TestSupport.h"
+
+// The snorm16 octahedral grid is about 0.0073 degrees off at its worst
+// cells, near the fold diagonals
+#define NORMAL_MAX_DEGREES 0.01f
+
+struct Errors {
+  float position; // Of the bound, 1 is at the bound
+  float normal;   // Degrees
+  float texCoords; // Of the bound
+};
+
+Errors roundTrip(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords,
+		 const glm::vec3& boxMin, const glm::vec3& boxSize) {
+  PackedVertex packed = packVertex(position, normal, texCoords, boxMin, boxSize);
+  glm::vec3 unpackedPosition, unpackedNormal;
+  glm::vec2 unpackedTexCoords;
+  unpackVertex(packed, boxMin, boxSize, unpackedPosition, unpackedNormal, unpackedTexCoords);
+
+  Errors errors = { 0.0f, 0.0f, 0.0f };
+  for (int axis = 0; axis < 3; axis++) {
+    // A flat axis dequantizes to the box minimum exactly
+    float bound = boxSize[axis] * 0.5f / 65535.0f +
+      4.0f * 1.2e-7f * (std::abs(boxMin[axis]) + boxSize[axis]) + 1e-30f;
+    errors.position = std::max(errors.position, std::abs(unpackedPosition[axis] - position[axis]) / bound);
+  }
+
+  // In double and from the cross product, acos of a float dot can't
+  // resolve angles this small
+  glm::dvec3 reference = glm::normalize(glm::dvec3(normal));
+  glm::dvec3 unpacked = glm::normalize(glm::dvec3(unpackedNormal));
+  double angle = std::atan2(glm::length(glm::cross(reference, unpacked)), glm::dot(reference, unpacked));
+  errors.normal = (float)(angle * 180.0 / 3.14159265358979);
+
+  for (int axis = 0; axis < 2; axis++) {
+    float bound = std::abs(texCoords[axis]) * std::ldexp(1.0f, -11) + std::ldexp(1.0f, -25);
+    errors.texCoords = std::max(errors.texCoords, std::abs(unpackedTexCoords[axis] - texCoords[axis]) / bound);
+  }
+  return errors;
+}
+
+void report(const std::string& name, const std::vector<Errors>& errors) {
+  Errors worst = { 0.0f, 0.0f, 0.0f };
+  for (const Errors& error : errors) {
+    worst.position = std::max(worst.position, error.position);
+    worst.normal = std::max(worst.normal, error.normal);
+    worst.texCoords = std::max(worst.texCoords, error.texCoords);
+  }
+
+  std::printf("%-16s %7zu vertices  position %.3f of bound  normal %.4f degrees  UV %.3f of bound\n",
+	      name.c_str(), errors.size(), worst.position, worst.normal, worst.texCoords);
+  check(worst.position <= 1.0f, name + ": position error past half a step");
+  check(worst.normal <= NORMAL_MAX_DEGREES, name + ": normal " + std::to_string(worst.normal) + " degrees off");
+  check(worst.texCoords <= 1.0f, name + ": UV error past half a step");
+}
+
+int main() {
+  std::mt19937 random(13);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+  // Random boxes from millimetres to kilometres, some far from the origin
+  std::vector<Errors> randomErrors;
+  for (int box = 0; box < 200; box++) {
+    glm::vec3 boxSize(std::pow(10.0f, unit(random) * 6.0f - 3.0f), std::pow(10.0f, unit(random) * 6.0f - 3.0f),
+		      std::pow(10.0f, unit(random) * 6.0f - 3.0f));
+    glm::vec3 boxMin = glm::vec3(gaussian(random), gaussian(random), gaussian(random)) * 100.0f;
+
+    for (int i = 0; i < 500; i++) {
+      glm::vec3 position = boxMin + glm::vec3(unit(random), unit(random), unit(random)) * boxSize;
+      glm::vec3 normal(gaussian(random), gaussian(random), gaussian(random));
+      // Tiled UVs run past 1
+      glm::vec2 texCoords(unit(random) * 8.0f - 2.0f, unit(random));
+      randomErrors.push_back(roundTrip(position, normal, texCoords, boxMin, boxSize));
+    }
+  }
+  report("random", randomErrors);
+
+  // Box corners, a flat box axis and UVs on the edges
+  std::vector<Errors> edgeErrors;
+  glm::vec3 boxMin(-1.0f, 2.0f, 0.0f);
+  glm::vec3 boxSize(2.0f, 0.0f, 5.0f);
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec3 position = boxMin + glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * boxSize;
+    glm::vec2 texCoords((float)(corner & 1), (float)((corner >> 1) & 1));
+    edgeErrors.push_back(roundTrip(position, glm::vec3(0.0f, 1.0f, 0.0f), texCoords, boxMin, boxSize));
+  }
+  report("box edges", edgeErrors);
+
+  // Axes, the diagonals the lower hemisphere folds over, and around -z
+  std::vector<Errors> normalErrors;
+  for (int axis = 0; axis < 3; axis++) {
+    for (float sign : { -1.0f, 1.0f }) {
+      glm::vec3 normal(0.0f);
+      normal[axis] = sign;
+      normalErrors.push_back(roundTrip(glm::vec3(0.0f), normal, glm::vec2(0.0f), glm::vec3(0.0f), glm::vec3(1.0f)));
+    }
+  }
+  for (int i = 0; i < 4096; i++) {
+    float angle = i * 6.2831853f / 4096.0f;
+    for (float z : { -0.9999f, -0.5f, -0.001f, 0.0f, 0.001f }) {
+      float radius = std::sqrt(1.0f - z * z);
+      glm::vec3 normal(radius * std::cos(angle), radius * std::sin(angle), z);
+      normalErrors.push_back(roundTrip(glm::vec3(0.0f), normal, glm::vec2(0.0f), glm::vec3(0.0f), glm::vec3(1.0f)));
+    }
+  }
+  report("hard normals", normalErrors);
+
+  return checksResult();
+}